@@ -0,0 +1,29 @@
+#ifndef BACKGROUNDJOB_H
+#define BACKGROUNDJOB_H
+
+#include <QObject>
+#include <QRunnable>
+#include <functional>
+
+/**
+ * BackgroundJob - A QRunnable with signals that deletes itself on the
+ * owner's thread
+ *
+ * The pool does not delete it. run() ends with deleteLater(), so the job
+ * is destroyed on the thread that created it, after its queued result
+ * signals have been delivered; owners connect with Qt::QueuedConnection
+ * and may still compare sender() against the job they are waiting for.
+ */
+class BackgroundJob : public QObject, public QRunnable {
+  Q_OBJECT
+
+public:
+  BackgroundJob();
+
+  // Runs work(0) .. work(threads - 1) in parallel and waits for them. A
+  // private pool: the caller is usually a job on the global one, and the
+  // workers must not queue behind it
+  static void runParallel(int threads, const std::function<void(int)> &work);
+};
+
+#endif // BACKGROUNDJOB_H
@@ -0,0 +1,80 @@
+#ifndef BLOCKDATA_H
+#define BLOCKDATA_H
+
+#include <QColor>
+#include <QString>
+#include <QTextBlock>
+#include <QTextBlockUserData>
+#include <QVector>
+
+class DecorationLayer;
+
+// One colored span of a minimap row, in character columns.
+// A zero alpha color means "default foreground" so theme switches
+// do not invalidate the cached summary.
+struct MinimapRun {
+  quint16 start;
+  quint16 length;
+  QRgb color;
+};
+
+// Kinds of decorations managed by DecorationLayer
+enum class DecorationKind : quint8 {
+  LineBackground,
+  SearchHit,
+  Diagnostic,
+  FoldPlaceholder
+};
+const int kDecorationKindCount = 4;
+
+// A decorated range inside one block, in characters. A negative length
+// covers the rest of the block.
+struct BlockDecoration {
+  DecorationKind kind;
+  int start;
+  int length;
+  QColor color;
+  QString tooltip;
+};
+
+/**
+ * BlockData - Per-block caches attached through QTextBlockUserData
+ *
+ * The document owns the user data and moves it with the block, so edits
+ * elsewhere never shift or invalidate these caches.
+ */
+class BlockData : public QTextBlockUserData {
+public:
+  // Minimap color summary
+  QVector<MinimapRun> minimapRuns;
+  bool minimapValid = false;
+
+  // Leading whitespace in columns; blank lines borrow from neighbours
+  int indentColumns = 0;
+  bool indentBlank = false;
+  bool indentValid = false;
+
+  // Decorations anchored to this block (see DecorationLayer), and the
+  // layer that lists the block, told when the block is deleted
+  QVector<BlockDecoration> decorations;
+  DecorationLayer *decorationLayer = nullptr;
+
+  ~BlockData() override; // Defined in decorationlayer.cpp
+
+  // Returns the block's data, attaching a fresh instance if needed
+  static BlockData *of(QTextBlock block) {
+    BlockData *data = static_cast<BlockData *>(block.userData());
+    if (!data) {
+      data = new BlockData;
+      block.setUserData(data);
+    }
+    return data;
+  }
+
+  // Returns the block's data or nullptr, never allocates
+  static BlockData *peek(const QTextBlock &block) {
+    return static_cast<BlockData *>(block.userData());
+  }
+};
+
+#endif // BLOCKDATA_H
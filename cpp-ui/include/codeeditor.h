@@ -9,7 +9,9 @@
 #include <QPainter>
 #include <QPlainTextEdit>
 #include <QPointF>
+#include <QRegularExpression>
 #include <QRectF>
+#include <QStaticText>
 #include <QString>
 #include <QTextBlock>
 #include <QTimer>
@@ -21,11 +23,15 @@ class CodeEditor;
 class CodeFolding;
 class LineNumberArea;
 class FoldingArea;
+class Minimap;
+class DecorationLayer;
+class LargeFileController;
 class Theme;
 class QPaintEvent;
 class QResizeEvent;
 class QWheelEvent;
 class QMouseEvent;
+class QEvent;
 class QKeyEvent;
 
 // Diagnostic information for syntax checking
@@ -51,6 +57,10 @@ public:
   void setTheme(Theme *theme);
   Theme *theme() const { return theme_; }
 
+  // Recomputes every cached indent level; call after changing the tab
+  // stop distance (font changes are picked up by the editor itself)
+  void refreshIndentGuides();
+
   // Line number area
   void lineNumberAreaPaintEvent(QPaintEvent *event);
   int lineNumberAreaWidth();
@@ -75,6 +85,13 @@ public:
                          const QString &tooltip = QString());
   void clearLineDecorations();
 
+  // Search hit highlighting
+  void highlightSearchMatches(const QRegularExpression &pattern);
+  void clearSearchHighlights();
+
+  // Unified decoration layer (diagnostics, search hits, lines, folds)
+  DecorationLayer *decorations() { return decorations_; }
+
   // Public accessors for areas
   QTextBlock getFirstVisibleBlock() const;
   QRectF getBlockBoundingGeometry(const QTextBlock &block) const;
@@ -85,8 +102,16 @@ public:
   void setFilePath(const QString &path) { filePath_ = path; }
   QString filePath() const { return filePath_; }
 
-  // Minimap support (future)
+  // Minimap support
   void enableMinimap(bool enable);
+  bool isMinimapEnabled() const { return minimapEnabled_; }
+
+  // Large-file mode: the document holds a window of a larger buffer
+  void setLargeFileController(LargeFileController *controller);
+  LargeFileController *largeFileController() const { return largeFile_; }
+  bool isLargeFileMode() const { return largeFile_ != nullptr; }
+  void setLineNumberOffset(int offset);
+  int lineNumberOffset() const { return lineNumberOffset_; }
 
 signals:
   void foldToggled(int line, bool folded);
@@ -99,6 +124,8 @@ protected:
   void mousePressEvent(QMouseEvent *event) override;
   void paintEvent(QPaintEvent *event) override;
   void wheelEvent(QWheelEvent *event) override;
+  void changeEvent(QEvent *event) override;
+  bool viewportEvent(QEvent *event) override;
 
 private slots:
   void updateLineNumberAreaWidth(int newBlockCount);
@@ -106,18 +133,49 @@ private slots:
   void updateLineNumberArea(const QRect &rect, int dy);
   void updateFoldingArea(const QRect &rect, int dy);
   void onTextChanged();
+  void onContentsChange(int position, int charsRemoved, int charsAdded);
+  void updateFoldPlaceholders();
   void triggerAutoCheck();
   void updateDiagnosticHighlights();
 
 private:
   void updateSidebarGeometry();
   bool isPointInFoldMarkerArea(const QPoint &pos, int line);
-  void paintDiagnosticUnderlines(QPainter &painter);
-  void paintFoldedRegionPlaceholders(QPainter &painter);
+  void paintCurrentLine(QPainter &painter, const QRect &rect);
+  void paintDiagnosticUnderlines(QPainter &painter, const QRect &rect);
+  void paintFoldedRegionPlaceholders(QPainter &painter, const QRect &rect);
+  void updateBlockRect(int blockNumber);
+
+  // Indent guides (levels cached per block in BlockData)
+  void updateBlockIndent(QTextBlock block);
+  int blockIndent(const QTextBlock &block);
+  int effectiveIndent(const QTextBlock &block);
+  void updateActiveScope();
+  void paintIndentGuides(QPainter &painter, const QRect &rect);
+
+  void highlightSearchBlock(const QTextBlock &block);
+
+  // Gutter caches (rebuilt on font/theme change only)
+  void updateGutterCache();
+  void drawLineNumber(QPainter &painter, int number, int right, int top,
+                      bool active);
 
   // Sidebar widgets
   LineNumberArea *lineNumberArea_;
 
+  // Line number gutter cache
+  QStaticText digitGlyphs_[10];
+  int digitAdvance_;
+  int lineHeight_;
+  int cachedDigits_;
+  int cachedLineNumberWidth_;
+  QColor gutterBackground_;
+  QColor gutterForeground_;
+  QColor gutterActiveForeground_;
+  QColor currentLineColor_;
+  int currentBlockNumber_;
+  int lineNumberOffset_;
+
   // Code folding
   CodeFolding *codeFolding_;
   bool codeFoldingEnabled_;
@@ -125,19 +183,35 @@ private:
   // Theme
   Theme *theme_;
 
+  // Indent guides
+  int indentWidth_;
+  QColor guideColor_;
+  QColor activeGuideColor_;
+  int activeGuideColumn_;
+  int activeScopeFirst_;
+  int activeScopeLast_;
+  int indentRevision_;  // Document revision the indent cache reflects
+  QTimer *scopeTimer_;  // Coalesces scope scans after edits
+
   // Auto syntax checking
   bool autoCheckEnabled_;
   QTimer *autoCheckTimer_;
   QVector<Diagnostic> diagnostics_;
 
-  // Line decorations (for errors, warnings, etc.)
-  QMap<int, QPair<QColor, QString>> lineDecorations_;
+  // Diagnostics, search hits, line decorations and fold placeholders
+  DecorationLayer *decorations_;
+  // Pattern of the search hits shown; edited blocks are matched again
+  QRegularExpression searchPattern_;
 
   // File info
   QString filePath_;
 
   // Minimap
+  Minimap *minimap_;
   bool minimapEnabled_;
+
+  // Large-file window (owned by the editor as a QObject child)
+  LargeFileController *largeFile_;
 };
 
 #endif // CODEEDITOR_H
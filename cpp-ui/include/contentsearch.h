@@ -0,0 +1,113 @@
+#ifndef CONTENTSEARCH_H
+#define CONTENTSEARCH_H
+
+#include "backgroundjob.h"
+#include "fuzzymatcher.h"
+#include <QByteArray>
+#include <QObject>
+#include <QRegularExpression>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include <atomic>
+
+class QIODevice;
+
+/**
+ * LiteralSearcher - Case-insensitive (ASCII) substring search
+ *
+ * Scans with memchr for the needle's rarest byte, in both cases for
+ * letters, and verifies the needle around each hit; libc's memchr is
+ * vectorized, so most of the haystack is skipped many bytes at a time.
+ */
+class LiteralSearcher {
+public:
+  explicit LiteralSearcher(const QByteArray &needle);
+
+  int length() const { return lower_.size(); }
+
+  // First occurrence in [begin, end), or nullptr
+  const char *find(const char *begin, const char *end) const;
+
+private:
+  QByteArray lower_;
+  int rareIndex_;  // Offset of the byte memchr looks for
+  char rareLower_;
+  char rareUpper_; // Same as rareLower_ for non-letters
+};
+
+/**
+ * BufferSnapshot - Text of an open editor, taken on the UI thread
+ *
+ * A copy the search can read from any thread while the editor goes on
+ * changing. Tabs that keep their text compressed hand that over as is;
+ * it is inflated by the worker that searches it.
+ */
+struct BufferSnapshot {
+  QString filePath;
+  QString text;
+  QByteArray compressedUtf8; // qCompress()ed text, used if set
+};
+
+/**
+ * ContentSearchJob - Searches file contents
+ *
+ * Files are handed out to a pool of workers one at a time. Each is
+ * memory-mapped (gzip files are inflated and searched a chunk of whole
+ * lines at a time), skipped if it looks binary, and searched for the
+ * query as a literal, or as a regular expression when written as
+ * /expression/. Both ignore case; literals with non-ASCII characters are
+ * matched as an escaped regular expression, which folds all of Unicode. The first hit on each line is reported, in batches as
+ * they are found, until maxHits.
+ *
+ * Constructed with buffer snapshots instead, it searches those texts the
+ * same way, so unsaved edits are found where they are.
+ */
+class ContentSearchJob : public BackgroundJob {
+  Q_OBJECT
+
+public:
+  ContentSearchJob(const QString &pattern, const QString &rootPath,
+                   const QStringList &files, int maxHits);
+  ContentSearchJob(const QString &pattern, const QString &rootPath,
+                   const QVector<BufferSnapshot> &buffers, int maxHits);
+  void run() override;
+  void cancel() { cancelled_ = true; }
+
+  // "/expression/" queries; their validity can be checked up front
+  static bool isRegex(const QString &pattern);
+  static QRegularExpression regexFor(const QString &pattern);
+
+signals:
+  // Rows carry the file, line and column of each hit
+  void hitsFound(const QVector<FuzzyMatch> &hits);
+  // Not emitted when cancelled; truncated if maxHits was reached
+  void finished(int hitCount, bool truncated);
+
+private:
+  class Worker;
+
+  void searchFile(Worker &worker, const QString &filePath);
+  void searchGzip(Worker &worker, const QString &filePath, QIODevice *file);
+  void searchBuffer(Worker &worker, const BufferSnapshot &buffer);
+  // data starts at line firstLine of the file
+  void searchText(Worker &worker, const QString &filePath, const char *data,
+                  qint64 size, int firstLine);
+  bool addHit(Worker &worker, FuzzyMatch hit);
+  void flush(Worker &worker, bool force);
+
+  QString pattern_;
+  QString rootPath_;
+  QStringList files_;
+  QVector<BufferSnapshot> buffers_;
+  int maxHits_;
+  bool regex_;
+  LiteralSearcher literal_;
+
+  std::atomic<bool> cancelled_;
+  std::atomic<int> nextFile_;
+  std::atomic<int> hitCount_;
+  std::atomic<bool> truncated_;
+};
+
+#endif // CONTENTSEARCH_H
@@ -0,0 +1,61 @@
+#ifndef DECORATIONLAYER_H
+#define DECORATIONLAYER_H
+
+#include "blockdata.h"
+#include <QColor>
+#include <QRect>
+#include <QRectF>
+#include <QSet>
+#include <QString>
+#include <QTextBlock>
+#include <QVector>
+
+// Forward declaration
+class CodeEditor;
+class QPainter;
+
+/**
+ * DecorationLayer - Block-anchored decorations painted with viewport culling
+ *
+ * Replaces QTextEdit::ExtraSelections for diagnostics, search hits, line
+ * decorations and fold placeholders. Ranges live in each block's BlockData,
+ * so they move with edits for free, and painting only visits the blocks
+ * that intersect the exposed rect.
+ */
+class DecorationLayer {
+public:
+  explicit DecorationLayer(CodeEditor *editor);
+  ~DecorationLayer();
+
+  // Lines and columns are 0-based; length < 0 means "to end of line"
+  void add(DecorationKind kind, int line, int column, int length,
+           const QColor &color, const QString &tooltip = QString());
+  void clear(DecorationKind kind);
+  void clearLine(DecorationKind kind, int line);
+  bool isEmpty(DecorationKind kind) const;
+
+  // First tooltip of any decoration covering the position
+  QString tooltipAt(int line, int column) const;
+
+  // Painting (called from CodeEditor::paintEvent)
+  void paintBackgrounds(QPainter &painter, const QRect &rect);
+  void paintUnderlines(QPainter &painter, const QRect &rect);
+  void paintPlaceholders(QPainter &painter, const QRect &rect);
+
+private:
+  friend class BlockData;
+  void forget(BlockData *data);
+
+  template <typename Fn> void forEachVisible(const QRect &rect, Fn fn);
+  QVector<QRectF> rangeRects(const QTextBlock &block, qreal top, int start,
+                             int length) const;
+  void drawWave(QPainter &painter, const QRectF &rect, const QColor &color);
+
+  CodeEditor *editor_;
+
+  // Data of the blocks that carry a decoration of each kind; a deleted
+  // block takes itself off, so entries never dangle
+  QSet<BlockData *> blocks_[kDecorationKindCount];
+};
+
+#endif // DECORATIONLAYER_H
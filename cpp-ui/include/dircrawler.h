@@ -0,0 +1,103 @@
+#ifndef DIRCRAWLER_H
+#define DIRCRAWLER_H
+
+#include "workspaceindex.h"
+#include <QByteArray>
+#include <QHash>
+#include <QSet>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include <memory>
+
+/**
+ * IgnoreRules - Compiled .gitignore/.ignore patterns of one directory
+ *
+ * Each directory with ignore files gets a node chained to its parent's,
+ * so a lookup walks from the innermost rules outwards and the first
+ * matching pattern decides. Within a node the last pattern wins, as in
+ * git; nodes without negated patterns skip the ordered scan and check
+ * hashed literal names and suffixes first.
+ */
+class IgnoreRules {
+public:
+  // The rules of absoluteDir on top of parent; returns parent itself if
+  // the directory has no (non-empty) ignore files
+  static std::shared_ptr<const IgnoreRules>
+  load(const std::shared_ptr<const IgnoreRules> &parent,
+       const QByteArray &absoluteDir, const QByteArray &relativeDir,
+       bool hasGitignore = true, bool hasIgnore = true);
+
+  // One file of patterns (.git/info/exclude) applying from relativeDir
+  static std::shared_ptr<const IgnoreRules>
+  fromFile(const std::shared_ptr<const IgnoreRules> &parent,
+           const QByteArray &filePath, const QByteArray &relativeDir);
+
+  // relativePath is relative to the crawl root and ends in name
+  bool isIgnored(const QByteArray &relativePath, const QByteArray &name,
+                 bool isDir) const;
+
+  // gitignore glob: '*' and '?' stop at '/', '**' crosses directories
+  static bool globMatch(const char *pattern, const char *patternEnd,
+                        const char *text, const char *textEnd);
+
+private:
+  struct Pattern {
+    QByteArray glob;
+    bool negated = false;
+    bool dirOnly = false;
+    bool anchored = false; // Matched against the path, not the name
+  };
+
+  static std::shared_ptr<const IgnoreRules>
+  compile(const std::shared_ptr<const IgnoreRules> &parent,
+          const QByteArray &relativeDir, const QVector<QByteArray> &filePaths);
+
+  bool addLine(QByteArray line);
+  // 1 ignored, 0 re-included, -1 no pattern of this node matches
+  int matchLocal(const QByteArray &relativePath, const QByteArray &name,
+                 bool isDir) const;
+  bool matches(const Pattern &pattern, const QByteArray &relativePath,
+               const QByteArray &name, bool isDir) const;
+
+  std::shared_ptr<const IgnoreRules> parent_;
+  QByteArray base_; // Relative directory with trailing '/', "" for root
+  QVector<Pattern> patterns_;
+
+  // Unordered fast path, used when no pattern is negated
+  bool ordered_ = false;
+  QSet<QByteArray> names_;
+  QSet<QByteArray> dirNames_;
+  QVector<QByteArray> suffixes_;
+  QVector<Pattern> globs_;
+};
+
+/**
+ * DirCrawler - Parallel walk of a directory tree
+ *
+ * Directories are listed by a pool of workers, each taking work from the
+ * back of its own queue and stealing from the front of the others' when
+ * it runs dry. Entries are read with getdents64 on Linux (readdir
+ * elsewhere on Unix) using the d_type the kernel reports, so files are
+ * never stat()ed unless the filesystem leaves the type unknown.
+ *
+ * Hidden entries are skipped, and .gitignore, .ignore and
+ * .git/info/exclude are honoured.
+ */
+class DirCrawler {
+public:
+  explicit DirCrawler(const QString &rootPath);
+
+  // Lists each of dirs (relative to the root; "" is the root) and every
+  // subdirectory not in known. A directory whose mtime still matches
+  // known is skipped unless force is set.
+  WorkspaceScan crawl(const QStringList &dirs,
+                      const QHash<QString, qint64> &known, bool force);
+
+  static int threadCount();
+
+private:
+  QByteArray root_;
+};
+
+#endif // DIRCRAWLER_H
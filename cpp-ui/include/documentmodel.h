@@ -0,0 +1,68 @@
+#ifndef DOCUMENTMODEL_H
+#define DOCUMENTMODEL_H
+
+#include "rustbridge.h"
+#include <QObject>
+#include <QString>
+#include <memory>
+#include <vector>
+
+class QTextDocument;
+
+/**
+ * DocumentModel - Parse results owned by one document
+ *
+ * Holds the AST and everything derived from it (highlight ranges,
+ * outline, foldable regions, preview HTML) for the document it is
+ * attached to. Results are tagged with the document revision they were
+ * computed from, so switching tabs reuses them without any parsing; only
+ * an edit makes the next refresh() reparse. Derived data is computed
+ * lazily on first access.
+ */
+class DocumentModel : public QObject {
+  Q_OBJECT
+
+public:
+  // Returns the document's model, attaching a new one if needed
+  static DocumentModel *of(QTextDocument *document);
+
+  // Reparse if the document changed since the last parse. Returns true
+  // if a new AST was built.
+  bool refresh(CyberMD::Parser &parser);
+  bool isCurrent() const;
+
+  CAST *ast() const { return ast_ ? ast_->get() : nullptr; }
+  const QString &previewHtml();
+  const std::vector<CyberMD::HighlightRange> &
+  highlights(CyberMD::Highlighter &highlighter);
+  const std::vector<CyberMD::OutlineItem> &outline();
+  const std::vector<CyberMD::FoldableRegion> &foldableRegions();
+
+  // Highlight formats from the current parse were handed to the editor.
+  // They are layout formats, so the revision still matches the parse.
+  void markHighlightsApplied();
+  bool highlightsApplied() const;
+
+  // Colors changed; formats must be reapplied even though ranges are valid
+  void invalidateFormats() { appliedRevision_ = -1; }
+
+private:
+  explicit DocumentModel(QTextDocument *document);
+  void analyze();
+
+  QTextDocument *document_;
+  int revision_;
+  int appliedRevision_;
+  std::unique_ptr<CyberMD::AST> ast_;
+
+  // Lazily derived from ast_
+  bool htmlValid_;
+  bool highlightsValid_;
+  bool analysisValid_;
+  QString html_;
+  std::vector<CyberMD::HighlightRange> highlights_;
+  std::vector<CyberMD::OutlineItem> outline_;
+  std::vector<CyberMD::FoldableRegion> foldableRegions_;
+};
+
+#endif // DOCUMENTMODEL_H
@@ -0,0 +1,84 @@
+#ifndef EDITJOURNAL_H
+#define EDITJOURNAL_H
+
+#include <QByteArray>
+#include <QFile>
+#include <QLockFile>
+#include <QObject>
+#include <QString>
+#include <QStringList>
+#include <memory>
+
+class QTextDocument;
+class QTimer;
+
+/**
+ * EditJournal - Append-only crash recovery log for one buffer
+ *
+ * Records every contentsChange delta (position, removed, inserted text)
+ * relative to the last saved file, so autosave cost scales with the edit
+ * rather than with the document. Records are buffered and appended on a
+ * short timer; once the journal outgrows the document it is compacted
+ * into a single snapshot record.
+ *
+ * A journal left behind by a crashed session is replayed on the next
+ * launch against the saved file it was based on.
+ */
+class EditJournal : public QObject {
+  Q_OBJECT
+
+public:
+  // Parented to the document so it dies with it
+  explicit EditJournal(QTextDocument *document);
+  ~EditJournal();
+
+  // The document now matches filePath on disk; restart the journal
+  void rebase(const QString &filePath);
+
+  // Record the whole document (after recovery or a racing save)
+  void writeSnapshot();
+
+  // Remove the journal; the buffer was saved or discarded
+  void discard();
+
+  // Remove the journal and record nothing until the next rebase(); the
+  // document no longer maps to a file (a large file's window)
+  void suspend();
+
+  // Journals whose owning process is gone
+  static QStringList orphanedJournals();
+
+  // Rebuild a buffer from a journal; filePath is empty for untitled buffers
+  static bool replay(const QString &journalPath, QString *filePath,
+                     QString *text, QString *error = nullptr);
+
+  static QString journalDirectory();
+
+private slots:
+  void onContentsChange(int position, int charsRemoved, int charsAdded);
+  void flush();
+
+private:
+  enum RecordKind : quint8 { EditRecord = 1, SnapshotRecord = 2 };
+
+  bool ensureOpen();
+  bool appendPending();
+  void removeJournalFile();
+  QByteArray header() const;
+  QByteArray snapshotRecord() const;
+  void compact();
+
+  QTextDocument *document_;
+  QString filePath_;
+  QString journalPath_;
+  QFile file_;
+  std::unique_ptr<QLockFile> lock_;
+  QByteArray pending_;
+  QTimer *flushTimer_;
+  int lastRevision_;
+  qint64 journalBytes_;
+  bool modified_;
+  bool suspended_;
+};
+
+#endif // EDITJOURNAL_H
@@ -0,0 +1,101 @@
+#ifndef FILELOADER_H
+#define FILELOADER_H
+
+#include "backgroundjob.h"
+#include <QByteArray>
+#include <QMetaType>
+#include <QObject>
+#include <QString>
+
+// Line terminator convention detected while decoding
+enum class LineEnding { LF, CRLF, CR, Mixed };
+
+// The on-disk version a buffer was last synchronized with. The tail
+// bytes let a later read tell an append apart from a rewrite.
+struct DiskState {
+  qint64 size = -1;
+  qint64 modified = 0;
+  QByteArray tail;
+
+  // Bytes of the file end kept in tail
+  static constexpr int kTailBytes = 4096;
+
+  static DiskState read(const QString &filePath);
+  bool isValid() const { return size >= 0; }
+};
+
+// Decoded file contents. Text always uses '\n' line terminators; the
+// original convention and BOM are kept so saving can restore them.
+struct LoadedText {
+  QString text;
+  LineEnding lineEnding = LineEnding::LF;
+  bool hasBom = false;
+  bool validUtf8 = true;
+  DiskState disk;
+
+  // gzip file: the text was streamed through chunkLoaded() and is empty
+  bool compressed = false;
+};
+
+Q_DECLARE_METATYPE(LoadedText)
+
+/**
+ * FileLoader - Loads and decodes text files on the thread pool
+ *
+ * Each file is mapped, validated and decoded from UTF-8 to UTF-16 in one
+ * pass that also strips the BOM and normalizes line endings. Results are
+ * delivered on the loader's thread, in completion order.
+ *
+ * gzip files (detected by their magic bytes) are inflated in chunks and
+ * the text is delivered piecewise through chunkLoaded() as it decodes,
+ * followed by fileLoaded() with just the metadata.
+ */
+class FileLoader : public QObject {
+  Q_OBJECT
+
+public:
+  explicit FileLoader(QObject *parent = nullptr);
+
+  void load(const QString &filePath);
+
+  // Largest file loaded whole: QString's allocation is capped at INT_MAX
+  // bytes, and UTF-16 may need one code unit per UTF-8 byte. Larger
+  // files open through a LargeFileBuffer
+  static constexpr qint64 kMaxTextBytes = 0x7FFFFFFF / 2;
+
+  // Single-pass UTF-8 decoder (SSE2 fast path for ASCII runs); inputs
+  // over kMaxTextBytes are refused with validUtf8 false and no text
+  static LoadedText decodeUtf8(const char *data, qint64 size);
+
+  // Length of the part of data that decodes on its own: without a
+  // trailing truncated UTF-8 sequence or a CR that may start a CRLF
+  static int completePrefix(const char *data, int size);
+
+signals:
+  void chunkLoaded(const QString &filePath, const QString &text, bool first);
+  void fileLoaded(const QString &filePath, const LoadedText &text);
+  void loadFailed(const QString &filePath, const QString &error);
+};
+
+/**
+ * FileLoadJob - One file load
+ */
+class FileLoadJob : public BackgroundJob {
+  Q_OBJECT
+
+public:
+  explicit FileLoadJob(const QString &filePath);
+  void run() override;
+
+signals:
+  void chunkDecoded(const QString &filePath, const QString &text, bool first);
+  void finished(const QString &filePath, const LoadedText &text,
+                const QString &error);
+
+private:
+  void inflateText(QIODevice *device, LoadedText &text);
+
+  QString filePath_;
+};
+
+#endif // FILELOADER_H
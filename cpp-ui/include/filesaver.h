@@ -0,0 +1,104 @@
+#ifndef FILESAVER_H
+#define FILESAVER_H
+
+#include "backgroundjob.h"
+#include "fileloader.h"
+#include <QHash>
+#include <QObject>
+#include <QSet>
+#include <QString>
+
+class QWidget;
+
+/**
+ * FileSaver - Atomic background saves of text snapshots
+ *
+ * The caller hands over an immutable snapshot (QString is implicitly
+ * shared, so this is free) and keeps editing. Encoding and writing happen
+ * on the thread pool through QSaveFile, which writes a temporary file,
+ * syncs it and renames it over the target, so a crash never leaves a
+ * truncated file behind.
+ *
+ * Saves to different files run in parallel. Saves to the same file are
+ * serialized, and only the newest queued snapshot is written next.
+ * saveNow() writes on the calling thread for callers that must know the
+ * outcome before going on; writes are numbered, so an older background
+ * snapshot that finishes after it is dropped instead of renamed over it.
+ */
+class FileSaver : public QObject {
+  Q_OBJECT
+
+public:
+  explicit FileSaver(QObject *parent = nullptr);
+
+  // revision is passed back unchanged, typically QTextDocument::revision()
+  void save(const QString &filePath, const QString &text,
+            LineEnding lineEnding = LineEnding::LF, bool hasBom = false,
+            int revision = 0);
+  bool isSaving(const QString &filePath) const;
+
+  // Blocking save, for closing a buffer or moving it to a new path
+  bool saveNow(const QString &filePath, const QString &text,
+               LineEnding lineEnding, bool hasBom, QString *errorString);
+
+  // '\n' text to bytes in the given convention; Mixed cannot be encoded
+  static QByteArray encode(const QString &text, LineEnding lineEnding,
+                           bool hasBom);
+
+  // The editor only keeps '\n', so a file with mixed endings cannot be
+  // written back as it was: asks which convention to convert it to.
+  // Returns false if the user cancelled the save.
+  static bool resolveLineEnding(QWidget *parent, const QString &fileName,
+                                LineEnding *lineEnding);
+
+signals:
+  void saved(const QString &filePath, int revision);
+  void saveFailed(const QString &filePath, int revision, const QString &error);
+
+private slots:
+  void onJobFinished(const QString &filePath, int revision,
+                     const QString &error);
+
+private:
+  struct Request {
+    QString text;
+    LineEnding lineEnding;
+    bool hasBom;
+    int revision;
+  };
+
+  void start(const QString &filePath, const Request &request);
+
+  QSet<QString> inFlight_;
+  QHash<QString, Request> queued_;
+};
+
+/**
+ * FileSaveJob - One snapshot write
+ */
+class FileSaveJob : public BackgroundJob {
+  Q_OBJECT
+
+public:
+  FileSaveJob(const QString &filePath, const QString &text,
+              LineEnding lineEnding, bool hasBom, int revision,
+              quint64 sequence);
+  void run() override;
+
+  // Writes unless a later-numbered write of the file already landed
+  static bool write(const QString &filePath, quint64 sequence,
+                    const QByteArray &bytes, QString *errorString);
+
+signals:
+  void finished(const QString &filePath, int revision, const QString &error);
+
+private:
+  QString filePath_;
+  QString text_;
+  LineEnding lineEnding_;
+  bool hasBom_;
+  int revision_;
+  quint64 sequence_;
+};
+
+#endif // FILESAVER_H
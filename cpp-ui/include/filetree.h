@@ -65,6 +65,9 @@ public:
   bool isDirectory() const { return fileInfo_.isDir(); }
   FileType fileType() const { return fileType_; }
 
+  // Classification by name only; the file is not read
+  static FileType typeOf(const QFileInfo &info);
+
 private:
   void determineFileType();
 
@@ -0,0 +1,126 @@
+#ifndef FILEWATCHER_H
+#define FILEWATCHER_H
+
+#include "backgroundjob.h"
+#include "fileloader.h"
+#include <QHash>
+#include <QMetaType>
+#include <QObject>
+#include <QSet>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+class QFile;
+class QFileSystemWatcher;
+class QTextDocument;
+class QTimer;
+
+// Lines [oldStart, oldStart + oldCount) of the buffer become lines
+struct LineHunk {
+  int oldStart = 0;
+  int oldCount = 0;
+  QStringList lines;
+};
+
+// What changed on disk, relative to the buffer snapshot it was diffed
+// against. Growing files only carry the appended text.
+struct ReloadResult {
+  bool appended = false;
+  QString appendedText;
+  QVector<LineHunk> hunks;
+  LineEnding lineEnding = LineEnding::LF;
+  bool hasBom = false;
+  DiskState disk;
+  int revision = 0;
+};
+
+Q_DECLARE_METATYPE(ReloadResult)
+
+/**
+ * FileWatcher - Notices external changes to open files
+ *
+ * Watches files (and their directories, so replaced or rotated files are
+ * picked up again) and reports changes that don't match the version the
+ * buffer was last synchronized with, which filters out our own saves.
+ *
+ * reload() re-reads a file on the thread pool and diffs it line by line
+ * against a buffer snapshot. apply() then replaces only the changed line
+ * ranges in one edit block, so the cursor, folds and highlighting of
+ * untouched lines survive and the reload is a single undo step. A file
+ * that only grew is read from the old end onwards.
+ */
+class FileWatcher : public QObject {
+  Q_OBJECT
+
+public:
+  explicit FileWatcher(QObject *parent = nullptr);
+
+  // Start watching, or record that the buffer now matches state
+  void watch(const QString &filePath, const DiskState &state);
+  void unwatch(const QString &filePath);
+
+  // Accept the current disk version without reloading
+  void acknowledge(const QString &filePath);
+
+  // The disk version the buffer was last synchronized with; invalid if
+  // the file is not watched
+  DiskState state(const QString &filePath) const {
+    return known_.value(filePath);
+  }
+
+  // Diff the disk version against bufferText; revision is passed back.
+  // With incremental, a file that only grew is read from its old end.
+  void reload(const QString &filePath, const QString &bufferText,
+              int revision, bool incremental = true);
+
+  static QVector<LineHunk> diffLines(const QStringList &oldLines,
+                                     const QStringList &newLines);
+  static void apply(QTextDocument *document, const ReloadResult &result);
+
+signals:
+  void fileChanged(const QString &filePath);
+  void fileRemoved(const QString &filePath);
+  void reloadReady(const QString &filePath, const ReloadResult &result);
+  void reloadFailed(const QString &filePath, const QString &error);
+
+private slots:
+  void onFileChanged(const QString &path);
+  void onDirectoryChanged(const QString &path);
+  void checkPending();
+
+private:
+  QFileSystemWatcher *watcher_;
+  QHash<QString, DiskState> known_;
+  QSet<QString> pending_;
+  QSet<QString> removed_;
+  QSet<QString> inFlight_;
+  QSet<QString> stale_; // Changed again while a reload was running
+  QTimer *settleTimer_;
+};
+
+/**
+ * FileReloadJob - One re-read and diff
+ */
+class FileReloadJob : public BackgroundJob {
+  Q_OBJECT
+
+public:
+  FileReloadJob(const QString &filePath, const DiskState &known,
+                const QString &bufferText, int revision);
+  void run() override;
+
+signals:
+  void finished(const QString &filePath, const ReloadResult &result,
+                const QString &error);
+
+private:
+  bool readAppended(QFile &file, ReloadResult &result);
+
+  QString filePath_;
+  DiskState known_;
+  QString bufferText_;
+  int revision_;
+};
+
+#endif // FILEWATCHER_H
@@ -1,43 +1,75 @@
 #ifndef FUZZYFINDER_H
 #define FUZZYFINDER_H
 
+#include "contentsearch.h"
+#include "fuzzymatcher.h"
+#include <QAbstractListModel>
+#include <QColor>
 #include <QDialog>
 #include <QDir>
 #include <QFileInfo>
 #include <QKeyEvent>
 #include <QLabel>
 #include <QLineEdit>
-#include <QListWidget>
+#include <QListView>
+#include <QPointer>
 #include <QStringList>
+#include <QStyledItemDelegate>
 #include <QTimer>
 #include <QVBoxLayout>
 #include <QWidget>
 
+class TrigramIndex;
 class Theme;
+class WorkspaceIndex;
 
-// Match result with score and positions
-struct FuzzyMatch {
-  QString text;
-  QString filePath;
-  int score;
-  QVector<int> matchPositions; // Positions of matched characters
+// Result rows, shown through a QListView; streamed hits are appended,
+// and the view only lays out and paints the rows on screen
+class FuzzyResultModel : public QAbstractListModel {
+  Q_OBJECT
+
+public:
+  enum Role {
+    FilePathRole = Qt::UserRole,
+    PositionsRole,
+    LineNumberRole,
+    ColumnRole
+  };
+
+  explicit FuzzyResultModel(QObject *parent = nullptr);
+
+  int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+  QVariant data(const QModelIndex &index,
+                int role = Qt::DisplayRole) const override;
 
-  bool operator<(const FuzzyMatch &other) const {
-    return score > other.score; // Higher score first
-  }
+  const FuzzyMatch &match(int row) const { return matches_.at(row); }
+
+  // Replaces all rows
+  void setMatches(const QVector<FuzzyMatch> &matches);
+  // Adds rows at the end, keeping the selection and scroll position
+  void appendMatches(const QVector<FuzzyMatch> &matches);
+  void clear();
+
+private:
+  QVector<FuzzyMatch> matches_;
 };
 
-// Custom list widget item with highlighted matches
-class FuzzyListItem : public QListWidgetItem {
+// Paints a row's text with its matched characters in the match color
+class FuzzyResultDelegate : public QStyledItemDelegate {
 public:
-  FuzzyListItem(const FuzzyMatch &match, QListWidget *parent = nullptr);
+  explicit FuzzyResultDelegate(QObject *parent = nullptr);
 
-  QString filePath() const { return filePath_; }
-  int score() const { return score_; }
+  // Palette colors are used until a theme is set
+  void setColors(const QColor &text, const QColor &selectedText,
+                 const QColor &match);
+
+  void paint(QPainter *painter, const QStyleOptionViewItem &option,
+             const QModelIndex &index) const override;
 
 private:
-  QString filePath_;
-  int score_;
+  QColor text_;
+  QColor selectedText_;
+  QColor match_;
 };
 
 // Custom line edit that handles special keys
@@ -66,7 +98,8 @@ public:
     FileMode,    // Search for files
     ContentMode, // Search within file contents (grep-like)
     CommandMode, // Search for commands/actions
-    BufferMode   // Search open buffers/tabs
+    BufferMode,       // Search open buffers/tabs
+    BufferContentMode // Search within open buffers, unsaved edits included
   };
 
   explicit FuzzyFinder(QWidget *parent = nullptr);
@@ -75,12 +108,14 @@ public:
   void setMode(Mode mode);
   void setRootPath(const QString &path);
   void setOpenFiles(const QStringList &files);
+  void setOpenBuffers(const QVector<BufferSnapshot> &buffers);
   void setTheme(Theme *theme);
 
   // Show with specific mode
   void showFileSearch(const QString &rootPath);
   void showContentSearch(const QString &rootPath);
   void showBufferSearch(const QStringList &openFiles);
+  void showBufferContentSearch(const QVector<BufferSnapshot> &buffers);
   void showCommandSearch();
 
 signals:
@@ -88,6 +123,9 @@ signals:
   void contentSelected(const QString &filePath, int lineNumber);
   void commandSelected(const QString &command);
   void bufferSelected(const QString &filePath);
+  // Column in UTF-16 code units, as QTextCursor counts them
+  void bufferContentSelected(const QString &filePath, int lineNumber,
+                             int column);
 
 protected:
   void showEvent(QShowEvent *event) override;
@@ -95,11 +133,15 @@ protected:
 
 private slots:
   void onTextChanged(const QString &text);
-  void onItemActivated(QListWidgetItem *item);
+  void onItemActivated(const QModelIndex &index);
   void onMoveUp();
   void onMoveDown();
   void onSelectCurrent();
   void performSearch();
+  void onIndexUpdated();
+  void onFileSearchFinished(const FileSearchResult &result);
+  void onContentHits(const QVector<FuzzyMatch> &hits);
+  void onContentSearchFinished(int hitCount, bool truncated);
 
 private:
   void setupUI();
@@ -116,28 +158,40 @@ private:
   void searchContent(const QString &pattern);
   void searchBuffers(const QString &pattern);
   void searchCommands(const QString &pattern);
-
-  // File scanning
-  void scanDirectory(const QString &path, QStringList &files, int maxDepth = 5);
-  void indexFiles();
+  void rememberMatches(const FileSearchResult &result);
 
   // Result display
   void displayResults(const QVector<FuzzyMatch> &matches);
-  QString highlightMatches(const QString &text, const QVector<int> &positions);
 
   FuzzyLineEdit *searchInput_;
-  QListWidget *resultsList_;
+  QListView *resultsList_;
+  FuzzyResultModel *resultsModel_;
+  FuzzyResultDelegate *resultsDelegate_;
   QLabel *statusLabel_;
   QLabel *modeLabel_;
 
   Mode currentMode_;
   QString rootPath_;
   QStringList openFiles_;
-  QStringList indexedFiles_;
+  QVector<BufferSnapshot> openBuffers_;
+  WorkspaceIndex *index_; // Shared with other windows; not owned
+  TrigramIndex *trigrams_; // Owned by index_
   Theme *theme_;
 
   QTimer *searchTimer_;
   QString lastPattern_;
+  QPointer<FileSearchJob> fileSearch_;
+  QPointer<ContentSearchJob> contentSearch_;
+
+  // Matches of recent file queries, each extending the one before, so a
+  // longer query only rescans its prefix's matches and backspacing reuses
+  // them. Valid for one index revision.
+  struct NarrowedQuery {
+    QString pattern;
+    QVector<int> candidates;
+  };
+  QVector<NarrowedQuery> narrowing_;
+  quint64 narrowingRevision_;
 
   // Commands for command mode
   QMap<QString, QString> commands_;
@@ -0,0 +1,141 @@
+#ifndef FUZZYMATCHER_H
+#define FUZZYMATCHER_H
+
+#include "backgroundjob.h"
+#include "workspaceindex.h"
+#include <QByteArray>
+#include <QMetaType>
+#include <QObject>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include <atomic>
+#include <vector>
+
+// Match result with score and positions
+struct FuzzyMatch {
+  QString text;
+  QString filePath;
+  int score = 0;
+  QVector<int> matchPositions; // Positions of matched characters
+  int lineNumber = 0;          // Content hits: 1-based line
+  int column = 0;              // Content hits: 0-based column in the line
+
+  bool operator<(const FuzzyMatch &other) const {
+    return score > other.score; // Higher score first
+  }
+};
+
+Q_DECLARE_METATYPE(FuzzyMatch)
+
+// Result of a FileSearchJob
+struct FileSearchResult {
+  QString pattern;
+  QVector<FuzzyMatch> matches; // Best first, at most the job's limit
+  int matched = 0;             // Candidates that matched at all
+  QVector<int> candidates;     // Indexes of all of them, ascending
+};
+
+Q_DECLARE_METATYPE(FileSearchResult)
+
+/**
+ * FuzzyMatcher - Scores candidates against one fuzzy query
+ *
+ * Candidates are given as UTF-8 bytes together with a copy whose ASCII
+ * letters are lowered (see toLowerAscii()), so both can be prepared once
+ * and scored on every keystroke without allocating. A 64-bit mask of the
+ * characters a candidate contains rejects most non-matches with a single
+ * AND before any scoring.
+ *
+ * Scoring follows fzf: matches earn a bonus after boundaries ('/', '_',
+ * camelCase humps) and in runs, and gaps cost. score() places the query
+ * in one cheap pass (leftmost match, shrunk from the right); alignScore()
+ * finds the best placement with a dynamic program over the window the
+ * query can occupy, and is meant for the few candidates that pass it.
+ *
+ * Case folding covers ASCII only; other characters must match exactly.
+ */
+class FuzzyMatcher {
+public:
+  explicit FuzzyMatcher(const QString &pattern);
+
+  bool isEmpty() const { return pattern_.isEmpty(); }
+  quint64 mask() const { return mask_; }
+
+  // False if the candidate lacks a character of the query
+  bool mayMatch(quint64 candidateMask) const {
+    return (candidateMask & mask_) == mask_;
+  }
+
+  // 0 if text does not contain the query as a subsequence; positions, if
+  // given, receive the matched byte offsets
+  int score(const char *text, const char *lower, int length,
+            QVector<int> *positions = nullptr) const;
+  // As score(), for the best placement rather than the first one
+  int alignScore(const char *text, const char *lower, int length,
+                 QVector<int> *positions = nullptr) const;
+
+  static QByteArray toLowerAscii(const QByteArray &utf8);
+  static quint64 charMask(const char *lower, int length);
+
+  // Byte offsets into utf8 as indexes into QString::fromUtf8(utf8)
+  static QVector<int> toStringPositions(const QByteArray &utf8,
+                                        const QVector<int> &bytePositions);
+
+private:
+  QByteArray pattern_;
+  QByteArray lower_;
+  quint64 mask_;
+};
+
+/**
+ * FileSearchJob - Ranks indexed files against a query
+ *
+ * Relative paths are scored in full. The keys are split into one shard
+ * per core, each ranking with the single-pass score and keeping a
+ * bounded heap of its best candidates; the merged heaps are rescored
+ * with the full alignment and cut to the limit. Match positions and
+ * display strings are built only for the rows that are returned.
+ * cancel() stops the shards within a few thousand candidates.
+ *
+ * Given the matches of a query the new one extends, only those are
+ * scanned: a candidate that did not contain the shorter query as a
+ * subsequence cannot contain the longer one.
+ */
+class FileSearchJob : public BackgroundJob {
+  Q_OBJECT
+
+public:
+  FileSearchJob(const QString &pattern, const QStringList &files,
+                const QVector<FileKey> &keys, int limit);
+  // Only scans the given indexes of keys
+  FileSearchJob(const QString &pattern, const QStringList &files,
+                const QVector<FileKey> &keys, int limit,
+                const QVector<int> &candidates);
+  void run() override;
+  void cancel() { cancelled_ = true; }
+
+signals:
+  // Not emitted when cancelled
+  void finished(const FileSearchResult &result);
+
+private:
+  struct Candidate {
+    int score;
+    int index;
+  };
+
+  void scoreShard(const FuzzyMatcher &matcher, int begin, int end, int kept,
+                  std::vector<Candidate> &best,
+                  QVector<int> &matched) const;
+
+  QString pattern_;
+  QStringList files_;
+  QVector<FileKey> keys_;
+  int limit_;
+  QVector<int> candidates_;
+  bool narrowed_;
+  std::atomic<bool> cancelled_;
+};
+
+#endif // FUZZYMATCHER_H
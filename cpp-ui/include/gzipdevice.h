@@ -0,0 +1,52 @@
+#ifndef GZIPDEVICE_H
+#define GZIPDEVICE_H
+
+#include <QByteArray>
+#include <QIODevice>
+#include <memory>
+
+/**
+ * GzipDevice - Read-only streaming gzip decompression over another device
+ *
+ * Inflates the source in small chunks as it is read, so compressed logs
+ * and exports can be read line by line (e.g. through QTextStream) without
+ * a temporary copy or the whole file in memory. Concatenated gzip
+ * members, as produced by appending to a .gz file, are read in sequence.
+ *
+ * The source must be open for reading; it is not owned.
+ */
+class GzipDevice : public QIODevice {
+  Q_OBJECT
+
+public:
+  explicit GzipDevice(QIODevice *source, QObject *parent = nullptr);
+  ~GzipDevice() override;
+
+  // Checks the gzip magic bytes without consuming them
+  static bool isGzip(QIODevice *device);
+  static bool isGzip(const QString &filePath);
+
+  bool open(OpenMode mode) override;
+  void close() override;
+  bool isSequential() const override { return true; }
+  bool atEnd() const override;
+
+  // The data was not gzip, or a member was truncated or corrupt
+  // (errorString() says why)
+  bool hasError() const { return failed_; }
+
+protected:
+  qint64 readData(char *data, qint64 maxSize) override;
+  qint64 writeData(const char *data, qint64 size) override;
+
+private:
+  struct Stream;
+
+  QIODevice *source_;
+  std::unique_ptr<Stream> stream_;
+  QByteArray input_;
+  bool finished_;
+  bool failed_;
+};
+
+#endif // GZIPDEVICE_H
@@ -0,0 +1,143 @@
+#ifndef HEXVIEW_H
+#define HEXVIEW_H
+
+#include "backgroundjob.h"
+#include <QAbstractScrollArea>
+#include <QByteArray>
+#include <QObject>
+#include <QPointer>
+#include <QString>
+#include <atomic>
+#include <memory>
+
+class MappedFile;
+class Theme;
+
+class HexSearchJob;
+
+/**
+ * HexView - Read-only hex/ASCII view of a memory-mapped file
+ *
+ * Nothing is copied out of the mapping: each paint formats only the rows
+ * in the viewport, so opening a multi-gigabyte image is instant and the
+ * view's memory does not grow with the file. The scrollbar counts rows
+ * (scaled down for files with more rows than it can hold).
+ *
+ * Ctrl+G jumps to an offset, Ctrl+F searches for a byte pattern and F3
+ * repeats the search. Searches run on the thread pool against the same
+ * mapping; starting a new one cancels the previous one.
+ */
+class HexView : public QAbstractScrollArea {
+  Q_OBJECT
+
+public:
+  explicit HexView(QWidget *parent = nullptr);
+  ~HexView();
+
+  bool open(const QString &filePath);
+  // Releases the mapping
+  void close();
+  QString filePath() const { return filePath_; }
+  qint64 size() const;
+  qint64 cursorOffset() const { return cursor_; }
+
+  void setTheme(Theme *theme);
+
+  // Scrolls to offset and selects the byte there
+  void goToOffset(qint64 offset);
+
+  // Searches forward from the byte after the cursor, wrapping around
+  void find(const QByteArray &pattern);
+  void findNext();
+  bool isSearching() const { return search_ != nullptr; }
+
+  // Hex byte pairs ("de ad be ef", "0xDEADBEEF"), otherwise the text's
+  // UTF-8 bytes; quotes force text
+  static QByteArray parsePattern(const QString &text);
+
+  // Binary or archive by name, or NUL bytes near the start
+  static bool isBinaryFile(const QString &filePath);
+
+signals:
+  void cursorMoved(qint64 offset);
+  // offset is -1 if the pattern does not occur
+  void searchFinished(qint64 offset);
+
+protected:
+  bool event(QEvent *event) override;
+  void paintEvent(QPaintEvent *event) override;
+  void resizeEvent(QResizeEvent *event) override;
+  void keyPressEvent(QKeyEvent *event) override;
+  void mousePressEvent(QMouseEvent *event) override;
+  void changeEvent(QEvent *event) override;
+
+private slots:
+  void onSearchFinished(qint64 offset);
+
+private:
+  static constexpr int kBytesPerRow = 16;
+
+  qint64 rowCount() const;
+  qint64 firstVisibleRow() const;
+  int visibleRows() const;
+  void updateMetrics();
+  void updateScrollBar();
+  void ensureVisible(qint64 offset);
+  void setCursorOffset(qint64 offset, qint64 selectionLength = 1);
+  qint64 offsetAt(const QPoint &pos) const;
+  void startSearch(qint64 from);
+  void cancelSearch();
+  void promptGoTo();
+  void promptFind();
+
+  std::shared_ptr<MappedFile> mapping_;
+  QString filePath_;
+  Theme *theme_;
+
+  qint64 cursor_;
+  qint64 selectionLength_;
+  QByteArray pattern_;
+  QPointer<HexSearchJob> search_;
+
+  // Rows per scrollbar step; 1 unless the file has more than INT_MAX rows
+  qint64 rowScale_;
+
+  // Layout in pixels, from the font
+  int charWidth_;
+  int lineHeight_;
+  int ascent_;
+  int offsetDigits_;
+};
+
+/**
+ * HexSearchJob - Finds a byte pattern in a mapping
+ *
+ * The mapping is scanned in chunks so cancel() takes effect quickly.
+ */
+class HexSearchJob : public BackgroundJob {
+  Q_OBJECT
+
+public:
+  HexSearchJob(std::shared_ptr<MappedFile> mapping, const QByteArray &pattern,
+               qint64 from);
+  void run() override;
+  void cancel() { cancelled_ = true; }
+
+  // First occurrence of needle in [data + from, data + to), or -1
+  static qint64 search(const char *data, qint64 from, qint64 to,
+                       const QByteArray &needle);
+
+signals:
+  // Not emitted when cancelled
+  void finished(qint64 offset);
+
+private:
+  qint64 searchRange(qint64 from, qint64 to) const;
+
+  std::shared_ptr<MappedFile> mapping_;
+  QByteArray pattern_;
+  qint64 from_;
+  std::atomic<bool> cancelled_;
+};
+
+#endif // HEXVIEW_H
@@ -0,0 +1,159 @@
+#ifndef LARGEFILE_H
+#define LARGEFILE_H
+
+#include <QByteArray>
+#include <QFile>
+#include <QObject>
+#include <QString>
+#include <QVector>
+#include <atomic>
+#include <memory>
+
+class CodeEditor;
+class QScrollBar;
+
+/**
+ * MappedFile - Read-only memory mapping shared with background workers
+ *
+ * Held through std::shared_ptr so an indexing job can outlive the buffer
+ * that started it; the mapping is released when the last user lets go.
+ */
+class MappedFile : public QObject {
+  Q_OBJECT
+
+public:
+  explicit MappedFile(const QString &path);
+  ~MappedFile();
+
+  // Opened, and mapped unless empty
+  bool isValid() const { return file_.isOpen() && (data_ || size_ == 0); }
+  const char *data() const { return reinterpret_cast<const char *>(data_); }
+  qint64 size() const { return size_; }
+
+  std::atomic<bool> cancelled;
+
+signals:
+  // Emitted on the owner's thread with the line starts of one chunk
+  void chunkIndexed(const QVector<qint64> &lineStarts, bool finished);
+
+private:
+  QFile file_;
+  uchar *data_;
+  qint64 size_;
+};
+
+/**
+ * LargeFileBuffer - Piece table over a memory-mapped file
+ *
+ * The original file is never copied: pieces point either into the mapping
+ * or into an append-only add buffer. Line start offsets are indexed on the
+ * thread pool and delivered in chunks, so the first screen is available
+ * long before the whole file has been scanned.
+ */
+class LargeFileBuffer : public QObject {
+  Q_OBJECT
+
+public:
+  explicit LargeFileBuffer(QObject *parent = nullptr);
+  ~LargeFileBuffer();
+
+  // Files opened through a buffer rather than loaded whole: over the
+  // configured threshold, or too large for a QString
+  static bool isLargeFile(const QString &filePath);
+
+  bool open(const QString &filePath);
+  QString filePath() const { return filePath_; }
+
+  qint64 size() const { return size_; }
+  int lineCount() const { return lineStarts_.size(); }
+  bool isIndexed() const { return indexed_; }
+  bool isModified() const { return modified_; }
+
+  // Line-based access (0-based lines, text without line terminators)
+  QString lines(int first, int count) const;
+  void replaceLines(int first, int count, const QString &text);
+
+  bool save(const QString &filePath, QString *errorString = nullptr);
+
+signals:
+  void indexProgress(int lineCount);
+  void indexingFinished();
+
+private slots:
+  void onChunkIndexed(const QVector<qint64> &lineStarts, bool finished);
+
+private:
+  enum Source { Original, Added };
+  struct Piece {
+    Source source;
+    qint64 offset;
+    qint64 length;
+  };
+
+  QByteArray read(qint64 position, qint64 length) const;
+  void replace(qint64 position, qint64 removed, const QByteArray &bytes);
+  qint64 lineEnd(int line) const;
+  void startIndexing();
+
+  std::shared_ptr<MappedFile> mapping_;
+  QByteArray added_;
+  QVector<Piece> pieces_;
+  QVector<qint64> lineStarts_;
+  QString filePath_;
+  qint64 size_;
+  bool indexed_;
+  bool modified_;
+  bool crlf_;
+};
+
+/**
+ * LargeFileController - Materializes a window of a LargeFileBuffer
+ *
+ * Only windowLines() lines live in the editor's QTextDocument. An external
+ * scrollbar spans the whole file; when the view nears the window edge the
+ * window's edits are written back to the piece table and a new window is
+ * loaded around the view.
+ */
+class LargeFileController : public QObject {
+  Q_OBJECT
+
+public:
+  LargeFileController(CodeEditor *editor, LargeFileBuffer *buffer);
+
+  LargeFileBuffer *buffer() const { return buffer_; }
+  QScrollBar *scrollBar() const { return scrollBar_; }
+  int windowFirstLine() const { return windowFirst_; }
+
+  // Write pending window edits back and save the buffer
+  bool save(const QString &filePath, QString *errorString = nullptr);
+
+  // Returns the editor to normal mode, empty, for reuse with another
+  // file; the caller deletes the controller afterwards
+  void detach();
+
+  static int windowLines() { return 4000; }
+
+private slots:
+  void onIndexProgress(int lineCount);
+  void onIndexingFinished();
+  void onScrollBarMoved(int value);
+  void onEditorScrolled(int value);
+  void onContentsChange(int position, int charsRemoved, int charsAdded);
+
+private:
+  void loadWindow(int firstLine, int topLine);
+  void flushWindow();
+  void updateScrollRange();
+
+  CodeEditor *editor_;
+  LargeFileBuffer *buffer_;
+  QScrollBar *scrollBar_;
+  int wrapMode_; // QPlainTextEdit::LineWrapMode before the reduced mode
+  bool folding_;
+  int windowFirst_;
+  int windowCount_;
+  bool windowDirty_;
+  bool loading_;
+};
+
+#endif // LARGEFILE_H
@@ -1,6 +1,9 @@
 #ifndef MAINWINDOW_H
 #define MAINWINDOW_H
 
+#include "fileloader.h"
+#include "filesaver.h"
+#include "filewatcher.h"
 #include "rustbridge.h"
 #include "settings.h"
 #include "theme.h"
@@ -31,6 +34,9 @@ class VimMode;
 class FileTree;
 class FeaturePanel;
 class FuzzyFinder;
+class EditJournal;
+class TailFollower;
+class HexView;
 
 class MainWindow : public QMainWindow {
   Q_OBJECT
@@ -83,6 +89,8 @@ private slots:
   void toggleFileTree(bool enabled);
   void toggleFeaturePanel(bool enabled);
   void toggleMinimap(bool enabled);
+  void toggleFollowMode(bool enabled);
+  void setFollowFilter();
   void toggleWordWrap(bool enabled);
   void toggleLineNumbers(bool enabled);
   void toggleWhitespace(bool enabled);
@@ -108,15 +116,29 @@ private slots:
   void showFuzzyContentSearch();
   void showFuzzyCommandSearch();
   void showFuzzyBufferSearch();
+  void showFuzzyBufferContentSearch();
   void onFuzzyFileSelected(const QString &filePath);
   void onFuzzyContentSelected(const QString &filePath, int lineNumber);
   void onFuzzyCommandSelected(const QString &command);
+  void onFuzzyBufferContentSelected(const QString &filePath, int lineNumber,
+                                    int column);
 
   // Tab/File management
   void onTabChanged(int index);
   void onTabModified(int index, bool modified);
   void onFileSelected(const QString &filePath);
   void onEditorChanged(CodeEditor *editor);
+  void onFileLoaded(const QString &filePath, const LoadedText &text);
+  void onFileChunkLoaded(const QString &filePath, const QString &text,
+                         bool first);
+  void onHexCursorMoved(qint64 offset);
+  void onHexSearchFinished(qint64 offset);
+  void onFileLoadFailed(const QString &filePath, const QString &error);
+  void onFileSaved(const QString &filePath, int revision);
+  void onFileSaveFailed(const QString &filePath, int revision,
+                        const QString &error);
+  void onFileChangedOnDisk(const QString &filePath);
+  void onReloadReady(const QString &filePath, const ReloadResult &result);
 
   // VIM mode
   void onVimModeChanged(int mode);
@@ -140,6 +162,17 @@ private slots:
   void onFeatureToggled();
 
 private:
+  // The tab's editor when tabs are in use, else the single editor
+  CodeEditor *activeEditor();
+  QString activeFilePath() const;
+
+  // Folder covered by fuzzy file and content searches: the file tree's,
+  // else the current file's
+  QString searchRoot() const;
+
+  // Put the single editor's cursor at the start of a 1-based line
+  void goToLine(int line);
+
   void setupUI();
   void setupCentralWidget();
   void setupMenuBar();
@@ -164,6 +197,10 @@ private:
   void saveSettings();
   void applyEditorSettings();
 
+  // Session of the single editor: its file, cursor and folds
+  SessionTab captureSession() const;
+  void applySession(const SessionTab &session);
+
   // File operations helpers
   void updateRecentFilesMenu();
   void openFileByPath(const QString &filePath);
@@ -171,16 +208,32 @@ private:
 
   // Highlighting
   void updateHighlighting();
-  void applyHighlighting(const std::vector<CyberMD::HighlightRange> &ranges);
+  void reapplyHighlighting();
+  void applyHighlighting(CodeEditor *editor,
+                         const std::vector<CyberMD::HighlightRange> &ranges);
   QColor getColorForToken(uint32_t tokenType);
 
   // Syntax highlighter
   void applySyntaxHighlighter(const QString &filePath);
   void applyRustHighlighter();
 
+  // Title, highlighter and file type label for the file now in editor_
+  void showFileInfo(const QString &filePath);
+
   // Outline
   void updateOutline();
 
+  // Crash recovery
+  void recoverJournals();
+
+  // Binary files
+  void showHexView(const QString &filePath);
+  void hideHexView();
+
+  // Large files: a piece table, with only a window of lines in editor_
+  void openLargeFile(const QString &filePath);
+  void closeLargeFile();
+
   // Preview
   void updatePreview();
   void syncPreviewScroll();
@@ -208,6 +261,9 @@ private:
   bool isPreviewMode_;
   bool isSplitView_;
 
+  // Binary files are shown here instead of in editor_
+  HexView *hexView_ = nullptr;
+
   // Sidebar
   FileTree *fileTree_;
   FeaturePanel *featurePanel_;
@@ -247,9 +303,32 @@ private:
   // Settings
   Settings settings_;
 
+  // Background file loading
+  FileLoader *fileLoader_;
+  QString pendingFile_;
+
+  // Put back once the file restored from the last session has loaded
+  SessionTab pendingSession_;
+
+  // Line to jump to once a file picked from a content search has loaded
+  QString jumpFile_;
+  int jumpLine_ = 0;
+
+  // Background saving
+  FileSaver *fileSaver_;
+  LineEnding currentLineEnding_;
+  bool currentHasBom_;
+
+  // External changes to currentFile_
+  FileWatcher *fileWatcher_;
+
+  // Crash recovery journal for editor_
+  EditJournal *journal_;
+
   // Current file
   QString currentFile_;
   bool isModified_;
+  bool currentCompressed_ = false; // Streamed from gzip, read-only
 
   // Syntax highlighting
   BaseSyntaxHighlighter *syntaxHighlighter_;
@@ -271,6 +350,10 @@ private:
   bool isClosing_;
   bool splitViewEnabled_ = false;
   bool minimapEnabled_ = false;
+
+  // Live tail of currentFile_ in editor_
+  TailFollower *follower_ = nullptr;
+  QAction *followAction_ = nullptr;
   bool lineNumbersVisible_ = true;
   bool showWhitespace_ = false;
 };
@@ -0,0 +1,68 @@
+#ifndef MINIMAP_H
+#define MINIMAP_H
+
+#include <QColor>
+#include <QImage>
+#include <QTextBlock>
+#include <QWidget>
+
+// Forward declaration
+class CodeEditor;
+class BlockData;
+class QPaintEvent;
+class QMouseEvent;
+class QResizeEvent;
+
+/**
+ * Minimap - Document overview rendered one pixel row per block
+ *
+ * Each block keeps a color summary (runs of token colors) in its
+ * BlockData. The widget blits those summaries into a cached QImage that
+ * covers the visible window; text is never laid out or painted, and only
+ * rows of changed blocks are re-rendered.
+ */
+class Minimap : public QWidget {
+  Q_OBJECT
+
+public:
+  explicit Minimap(CodeEditor *editor);
+
+  QSize sizeHint() const override;
+  static int preferredWidth() { return 100; }
+
+  // Re-read colors from the editor's theme
+  void updateColors();
+
+public slots:
+  void onContentsChange(int position, int charsRemoved, int charsAdded);
+  void onEditorScrolled();
+
+protected:
+  void paintEvent(QPaintEvent *event) override;
+  void mousePressEvent(QMouseEvent *event) override;
+  void mouseMoveEvent(QMouseEvent *event) override;
+  void resizeEvent(QResizeEvent *event) override;
+
+private:
+  int computeFirstRow() const;
+  void renderWindow();
+  void renderRows(int fromRow, int toRow);
+  void renderRow(int y, const QTextBlock &block);
+  void buildSummary(const QTextBlock &block, BlockData *data);
+  void scrollEditorTo(int y);
+
+  CodeEditor *codeEditor_;
+
+  // Rendered window: row y shows block firstRow_ + y
+  QImage image_;
+  int firstRow_;
+  int lastBlockCount_;
+  bool imageValid_;
+
+  // Cached colors
+  QRgb background_;
+  QRgb foreground_;
+  QColor sliderColor_;
+};
+
+#endif // MINIMAP_H
@@ -6,6 +6,7 @@
 #include <QLineEdit>
 #include <QPlainTextEdit>
 #include <QPushButton>
+#include <QRegularExpression>
 
 class SearchDialog : public QDialog {
   Q_OBJECT
@@ -19,6 +20,9 @@ public:
   void findNext();
   void findPrevious();
 
+protected:
+  void hideEvent(QHideEvent *event) override;
+
 private slots:
   void replace();
   void replaceAll();
@@ -26,6 +30,7 @@ private slots:
 private:
   void setupUI();
   bool find(bool forward = true);
+  void updateSearchHighlights();
 
   QPlainTextEdit *editor_;
   QLineEdit *findLineEdit_;
@@ -39,6 +44,7 @@ private:
   QCheckBox *regexCheck_;
 
   bool replaceMode_;
+  QRegularExpression highlightedPattern_;
 };
 
 #endif // SEARCHDIALOG_H
@@ -5,6 +5,16 @@
 #include <QString>
 #include <QFont>
 #include <QStringList>
+#include <QList>
+#include <QVector>
+
+// One restorable tab of a saved session
+struct SessionTab {
+    QString filePath;
+    int cursorPosition = 0;
+    int firstVisibleLine = 0;
+    QList<int> foldedLines;
+};
 
 class Settings {
 public:
@@ -30,6 +40,18 @@ public:
     int tabSize() const;
     void setTabSize(int size);
 
+    // Files at least this large open in large-file mode (0 disables it)
+    int largeFileThresholdMB() const;
+    void setLargeFileThresholdMB(int megabytes);
+
+    // Idle tabs are reclaimed after this many minutes (0 disables it)
+    int tabReclaimMinutes() const;
+    void setTabReclaimMinutes(int minutes);
+
+    // Followed log files keep at most this many lines
+    int tailMaxLines() const;
+    void setTailMaxLines(int lines);
+
     // Recent files
     QStringList recentFiles() const;
     void addRecentFile(const QString& filePath);
@@ -42,6 +64,11 @@ public:
     QByteArray windowState() const;
     void setWindowState(const QByteArray& state);
 
+    // Session (open tabs, active tab, cursors, folds)
+    QVector<SessionTab> sessionTabs() const;
+    int sessionActiveTab() const;
+    void setSession(const QVector<SessionTab>& tabs, int activeTab);
+
 private:
     QSettings settings_;
 
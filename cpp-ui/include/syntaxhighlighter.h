@@ -7,6 +7,7 @@
 #include <QSyntaxHighlighter>
 #include <QTextCharFormat>
 #include <QTextDocument>
+#include <QTextLayout>
 #include <QTimer>
 #include <QVector>
 
@@ -67,11 +68,18 @@ class MarkdownHighlighter : public BaseSyntaxHighlighter {
 public:
   explicit MarkdownHighlighter(QTextDocument *parent = nullptr);
 
+  // Formats from a full parse, indexed by block number, layered under the
+  // rule formats. They only hold at the revision they were computed for;
+  // an edited block keeps the rule formats alone until the next parse.
+  void setParsedFormats(
+      const QVector<QVector<QTextLayout::FormatRange>> &blocks, int revision);
+
 protected:
   void highlightBlock(const QString &text) override;
   void setupRules() override;
 
 private:
+  void applyParsedFormats(const QString &text);
   void highlightHeadings(const QString &text);
   void highlightCodeBlocks(const QString &text);
   void highlightInlineCode(const QString &text);
@@ -112,6 +120,9 @@ private:
   QTextCharFormat tableFormat_;
 
   QString currentCodeBlockLanguage_;
+
+  QVector<QVector<QTextLayout::FormatRange>> parsedFormats_;
+  int parsedRevision_;
 };
 
 // ==================== C++ HIGHLIGHTER ====================
@@ -327,6 +338,32 @@ private:
   QTextCharFormat dateFormat_;
 };
 
+// ==================== LOG HIGHLIGHTER ====================
+// Colors whole lines by severity. Each line is classified on its own, so
+// appending to a followed log only highlights the new blocks.
+class LogHighlighter : public BaseSyntaxHighlighter {
+  Q_OBJECT
+
+public:
+  explicit LogHighlighter(QTextDocument *parent = nullptr);
+
+protected:
+  void highlightBlock(const QString &text) override;
+  void setupFormats() override;
+  void setupRules() override;
+
+private:
+  QRegularExpression errorPattern_;
+  QRegularExpression warningPattern_;
+  QRegularExpression infoPattern_;
+  QRegularExpression debugPattern_;
+  QRegularExpression timestampPattern_;
+  QTextCharFormat errorFormat_;
+  QTextCharFormat warningFormat_;
+  QTextCharFormat infoFormat_;
+  QTextCharFormat debugFormat_;
+};
+
 // ==================== HIGHLIGHTER FACTORY ====================
 class HighlighterFactory {
 public:
@@ -344,7 +381,8 @@ public:
     Html,
     Css,
     Toml,
-    Xml
+    Xml,
+    Log
   };
 
   static BaseSyntaxHighlighter *createHighlighter(Language lang,
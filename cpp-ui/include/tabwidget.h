@@ -7,10 +7,20 @@
 #include <QString>
 #include <QFileInfo>
 #include <QTextDocument>
+#include <QElapsedTimer>
+#include "contentsearch.h"
+#include "fileloader.h"
+#include "filewatcher.h"
+#include "settings.h"
 
 class CodeEditor;
 class Theme;
 class BaseSyntaxHighlighter;
+class FileLoader;
+class FileSaver;
+class EditJournal;
+class TailFollower;
+class QTimer;
 
 // Custom TabBar with close buttons and styling
 class EditorTabBar : public QTabBar {
@@ -35,9 +45,38 @@ struct TabInfo {
     QString fileName;
     bool isModified;
     bool isUntitled;
+    bool isLargeFile;
+    bool isLoading;
+    LineEnding lineEnding;
+    bool hasBom;
     BaseSyntaxHighlighter *highlighter;
+    EditJournal *journal;
+
+    // Session restore: placeholders have no editor until first activated
+    bool isPlaceholder;
+    bool restorePending;
+    SessionTab session;
+
+    // Memory reclamation: compressed text of a clean placeholder, or a
+    // modified tab whose layout and highlighting were dropped
+    QByteArray compressedText;
+    bool isReclaimed;
+    qint64 lastActive;
+
+    // Live tail of a growing file; the editor is a read-only view meanwhile
+    TailFollower *follower;
+
+    // Streamed from a gzip file; read-only since saving would not compress
+    bool isCompressed;
+
+    // Shown in a HexView instead of an editor
+    bool isBinary;
     
-    TabInfo() : isModified(false), isUntitled(true), highlighter(nullptr) {}
+    TabInfo() : isModified(false), isUntitled(true), isLargeFile(false),
+                isLoading(false), lineEnding(LineEnding::LF), hasBom(false),
+                highlighter(nullptr), journal(nullptr), isPlaceholder(false),
+                restorePending(false), isReclaimed(false), lastActive(0),
+                follower(nullptr), isCompressed(false), isBinary(false) {}
 };
 
 // Main tab widget for managing multiple editor tabs
@@ -56,6 +95,20 @@ public:
     bool saveAllTabs();
     bool closeTab(int index);
     bool closeAllTabs();
+
+    // Tab holding text recovered from an edit journal (marked modified)
+    int openRecovered(const QString &filePath, const QString &text);
+
+    // Follow mode for log files; fails for modified or untitled tabs
+    bool setFollowing(int index, bool follow);
+    TailFollower *followerAt(int index) const;
+
+    // Session restore with lazily materialized tabs
+    void restoreSession(const QVector<SessionTab> &tabs, int activeTab);
+    QVector<SessionTab> sessionState(int *activeTab) const;
+    
+    // Text of every open file as it stands, for searching off the UI thread
+    QVector<BufferSnapshot> bufferSnapshots() const;
     
     // Current editor access
     CodeEditor* currentEditor() const;
@@ -88,15 +141,39 @@ private slots:
     void onTabCloseRequested(int index);
     void onCurrentChanged(int index);
     void onTabMoved(int from, int to);
+    void onFileLoaded(const QString &filePath, const LoadedText &text);
+    void onFileChunkLoaded(const QString &filePath, const QString &text, bool first);
+    void onLoadFailed(const QString &filePath, const QString &error);
+    void onFileSaved(const QString &filePath, int revision);
+    void onSaveFailed(const QString &filePath, int revision, const QString &error);
+    void onFileChangedOnDisk(const QString &filePath);
+    void onFileRemovedOnDisk(const QString &filePath);
+    void onReloadReady(const QString &filePath, const ReloadResult &result);
+    void reclaimInactiveTabs();
 
 private:
     void setupUI();
     void updateTabIcon(int index);
     QString getLanguageFromPath(const QString &filePath);
     QIcon getFileIcon(const QString &filePath);
+    void beginLoad(int index, const QString &filePath);
+    int insertEditorTab(int position, const QString &filePath,
+                        const QString *preloaded = nullptr);
+    int insertHexTab(const QString &filePath);
+    void materializeTab(int index);
+    void removeTabInfo(int index);
+    bool saveTabNow(int index);
+    void applySessionState(int index);
+    SessionTab captureSessionTab(int index) const;
+    void reclaimTab(int index);
     BaseSyntaxHighlighter* createHighlighter(const QString &filePath, QTextDocument *doc);
 
     EditorTabBar *tabBar_;
+    FileLoader *loader_;
+    FileSaver *saver_;
+    FileWatcher *watcher_;
+    QTimer *reclaimTimer_;
+    QElapsedTimer activityClock_;
     QMap<int, TabInfo> tabInfoMap_;
     Theme *theme_;
     int untitledCounter_;
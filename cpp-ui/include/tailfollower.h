@@ -0,0 +1,110 @@
+#ifndef TAILFOLLOWER_H
+#define TAILFOLLOWER_H
+
+#include "backgroundjob.h"
+#include <QMetaType>
+#include <QObject>
+#include <QPointer>
+#include <QRegularExpression>
+#include <QString>
+
+class CodeEditor;
+class QFile;
+class QFileSystemWatcher;
+class QTextBlock;
+class QTimer;
+
+// Whole lines read past the followed offset
+struct TailChunk {
+  QString text;
+  qint64 offset = 0;  // Where the next read starts
+  quint64 fileId = 0; // Identity of the file that was read
+  bool restarted = false;
+  QString error;
+};
+
+Q_DECLARE_METATYPE(TailChunk)
+
+/**
+ * TailFollower - "tail -F" for an editor showing a growing file
+ *
+ * Only bytes past the last read offset are read, on the thread pool, and
+ * only whole lines. A file that was replaced (rotation) or shrank
+ * (truncation) is read again from the start. New lines are appended in
+ * batches as one edit, and the oldest lines are dropped so the buffer
+ * acts as a ring of at most maxLines lines.
+ *
+ * The editor is read-only and keeps no undo history while following.
+ * An optional filter hides lines that don't match; it is evaluated only
+ * for new lines, except when the filter itself changes.
+ */
+class TailFollower : public QObject {
+  Q_OBJECT
+
+public:
+  // Reads on from loadedSize, the size of the file the editor's text was
+  // loaded from, so lines written since the load are not lost. A negative
+  // size starts at the file's current end.
+  TailFollower(CodeEditor *editor, const QString &filePath, int maxLines,
+               qint64 loadedSize = -1);
+  ~TailFollower();
+
+  QString filePath() const { return filePath_; }
+
+  // Returns false if pattern is not a valid regular expression
+  bool setFilter(const QString &pattern);
+  QString filter() const { return filter_.pattern(); }
+
+signals:
+  // The file was rotated or truncated and is followed from its start
+  void restarted();
+  // A batch of lines was appended
+  void appended();
+
+private slots:
+  void onChanged();
+  void onReadFinished(const TailChunk &chunk);
+  void flush();
+
+private:
+  void startRead();
+  int trimToLimit();
+  void applyFilter(const QTextBlock &from);
+
+  QPointer<CodeEditor> editor_; // Cleared first if the editor is deleted
+  QString filePath_;
+  int maxLines_;
+  QFileSystemWatcher *watcher_;
+  QTimer *batchTimer_;
+  qint64 offset_;
+  quint64 fileId_;
+  bool reading_;
+  bool readAgain_;
+  QString pending_;
+  QRegularExpression filter_;
+  bool wasReadOnly_;
+};
+
+/**
+ * TailReadJob - One read past the offset
+ */
+class TailReadJob : public BackgroundJob {
+  Q_OBJECT
+
+public:
+  TailReadJob(const QString &filePath, qint64 offset, quint64 fileId);
+  void run() override;
+
+  // Stable identity of an open file (inode where available)
+  static quint64 fileIdentity(const QFile &file);
+
+signals:
+  void finished(const TailChunk &chunk);
+
+private:
+  QString filePath_;
+  qint64 offset_;
+  quint64 fileId_;
+};
+
+#endif // TAILFOLLOWER_H
@@ -0,0 +1,106 @@
+#ifndef TRIGRAMINDEX_H
+#define TRIGRAMINDEX_H
+
+#include "backgroundjob.h"
+#include <QObject>
+#include <QString>
+#include <QStringList>
+#include <memory>
+
+class QTimer;
+class WorkspaceIndex;
+
+struct TrigramData;
+
+/**
+ * TrigramIndex - Posting lists of the byte trigrams in a workspace's files
+ *
+ * A literal can only occur in a file that contains every trigram of it
+ * (ASCII case folded), so intersecting the lists of the query's trigrams
+ * leaves a handful of files for the real search to verify.
+ *
+ * Built on the thread pool from the WorkspaceIndex file list and kept in
+ * step with it: changed or new files (by mtime and size) are reindexed,
+ * removed ones are dropped. The posting lists live in a file next to the
+ * workspace index cache, sorted by trigram and mapped rather than loaded,
+ * so only the lists a query touches are read. Files indexed since it was
+ * written go to a small in-memory delta, saved on its own after each
+ * pass; the file is rewritten with the delta merged in once that grows
+ * large or many documents have died. Files too large to index, and those
+ * not indexed yet, are always candidates.
+ */
+class TrigramIndex : public QObject {
+  Q_OBJECT
+
+public:
+  // The trigram index of a workspace, created on first use
+  static TrigramIndex *forIndex(WorkspaceIndex *index);
+
+  ~TrigramIndex();
+
+  // Files that may contain needle; false if the index cannot narrow the
+  // search (no ASCII trigram in the needle, or the first pass not done).
+  // Files a running pass has not checked against the disk yet are always
+  // candidates, as their postings may be stale.
+  bool candidates(const QString &needle, QStringList &files) const;
+
+  // Checks every file against the disk now rather than on the next
+  // workspace change; edits inside files do not touch their directory
+  void refresh();
+
+signals:
+  void updated();
+
+private slots:
+  void onIndexUpdated();
+  void startUpdate();
+  void onUpdateFinished();
+
+private:
+  explicit TrigramIndex(WorkspaceIndex *index);
+
+  QString cachePath() const;
+
+  WorkspaceIndex *index_;
+  std::shared_ptr<TrigramData> data_;
+  QTimer *updateTimer_;
+  bool updating_;
+  bool cacheRead_;
+};
+
+/**
+ * TrigramUpdateJob - Brings a TrigramIndex in line with a file list
+ *
+ * Files are read by a pool of workers, which add each file's trigrams to
+ * the shared delta under a write lock, so queries keep working (treating
+ * unfinished files as candidates) while it runs.
+ */
+class TrigramUpdateJob : public BackgroundJob {
+  Q_OBJECT
+
+public:
+  TrigramUpdateJob(std::shared_ptr<TrigramData> data, const QString &rootPath,
+                   const QStringList &files, const QString &cachePath,
+                   bool readCache);
+  void run() override;
+
+signals:
+  void finished();
+
+private:
+  void indexFiles(const QStringList &files);
+  QString deltaPath() const;
+  bool readCache();
+  // Rewrites the mapped file with the delta merged in and dead documents
+  // dropped
+  bool mergeBase();
+  bool writeDelta();
+
+  std::shared_ptr<TrigramData> data_;
+  QString rootPath_;
+  QStringList files_;
+  QString cachePath_;
+  bool readCache_;
+};
+
+#endif // TRIGRAMINDEX_H
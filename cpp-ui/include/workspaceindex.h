@@ -0,0 +1,148 @@
+#ifndef WORKSPACEINDEX_H
+#define WORKSPACEINDEX_H
+
+#include "backgroundjob.h"
+#include <QByteArray>
+#include <QHash>
+#include <QMetaType>
+#include <QObject>
+#include <QSet>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+class QFileSystemWatcher;
+class QTimer;
+
+// Direct contents of one indexed directory
+struct IndexedDir {
+  qint64 modified = 0; // Directory mtime when it was listed
+  QStringList files;   // File names
+  QStringList subdirs; // Names of subdirectories that are indexed too
+};
+
+// Keyed by path relative to the root; the root itself is ""
+typedef QHash<QString, IndexedDir> IndexedDirMap;
+
+// Search key of one indexed file, built once per index revision
+struct FileKey {
+  QByteArray path;    // Relative to the root, UTF-8
+  QByteArray lower;   // path with ASCII letters lowered; same byte offsets
+  quint64 mask = 0;   // FuzzyMatcher::charMask() of lower
+  int nameOffset = 0; // Where the file name starts in path
+};
+
+// Result of a WorkspaceScanJob
+struct WorkspaceScan {
+  IndexedDirMap listed;  // Directories that were (re)listed
+  QStringList removed;   // Directories that no longer exist
+  bool replaceAll = false;
+};
+
+Q_DECLARE_METATYPE(WorkspaceScan)
+
+/**
+ * WorkspaceIndex - File list of a workspace, shared by every window
+ *
+ * Built once per root on the thread pool and persisted to a cache file,
+ * so the next launch starts from the cached list and only relists
+ * directories whose mtime changed. While the application runs, watched
+ * directories (inotify on Linux) are relisted as they change, without
+ * walking the rest of the tree.
+ *
+ * All state lives on the GUI thread; jobs get copies and hand back
+ * WorkspaceScan results.
+ */
+class WorkspaceIndex : public QObject {
+  Q_OBJECT
+
+public:
+  // The shared index for root, created on first use
+  static WorkspaceIndex *forRoot(const QString &rootPath);
+
+  ~WorkspaceIndex();
+
+  QString rootPath() const { return rootPath_; }
+
+  // Absolute paths; cheap to copy, rebuilt only after changes
+  QStringList files() const;
+  // Fuzzy search keys, in the same order as files()
+  QVector<FileKey> keys() const;
+  int fileCount() const { return fileCount_; }
+
+  // Bumped whenever the file list changes
+  quint64 revision() const { return revision_; }
+
+  // The list reflects the disk (not just the cache)
+  bool isReady() const { return ready_; }
+
+signals:
+  void updated();
+
+private slots:
+  void onDirectoryChanged(const QString &path);
+  void rescanDirty();
+  void onScanned(const WorkspaceScan &scan, bool final);
+  void save();
+
+private:
+  explicit WorkspaceIndex(const QString &rootPath, QObject *parent);
+
+  void startScan(const QStringList &dirs, bool force, bool loadCache);
+  void removeSubtree(const QString &relativeDir);
+  QString absolutePath(const QString &relativeDir) const;
+  void rebuildLists() const;
+  QString cachePath() const;
+
+  QString rootPath_;
+  IndexedDirMap dirs_;
+  QFileSystemWatcher *watcher_;
+  QTimer *rescanTimer_;
+  QTimer *saveTimer_;
+  QSet<QString> dirty_;
+  bool scanning_;
+  bool ready_;
+  bool unsaved_;
+  quint64 revision_;
+  int fileCount_;
+
+  mutable QStringList files_;
+  mutable QVector<FileKey> keys_;
+  mutable quint64 filesRevision_;
+};
+
+/**
+ * WorkspaceScanJob - Lists directories under a root
+ *
+ * Each of dirs is relisted unless its mtime still matches known (or
+ * force is set). Subdirectories missing from known are walked in full,
+ * in parallel, by a DirCrawler. With a cache path, the cached index is
+ * read and reported first.
+ */
+class WorkspaceScanJob : public BackgroundJob {
+  Q_OBJECT
+
+public:
+  WorkspaceScanJob(const QString &rootPath, const QStringList &dirs,
+                   const QHash<QString, qint64> &known, bool force,
+                   const QString &cachePath = QString());
+  void run() override;
+
+  static bool readCache(const QString &cachePath, const QString &rootPath,
+                        IndexedDirMap &dirs);
+  static bool writeCache(const QString &cachePath, const QString &rootPath,
+                         const IndexedDirMap &dirs);
+
+signals:
+  // final is false for the cached index reported before validation
+  void finished(const WorkspaceScan &scan, bool final);
+
+private:
+  QString rootPath_;
+  QStringList dirs_;
+  QHash<QString, qint64> known_;
+  bool force_;
+  QString cachePath_;
+};
+
+#endif // WORKSPACEINDEX_H
@@ -0,0 +1,19 @@
+#include "backgroundjob.h"
+#include <QThreadPool>
+
+BackgroundJob::BackgroundJob() { setAutoDelete(false); }
+
+void BackgroundJob::runParallel(int threads,
+                                const std::function<void(int)> &work) {
+  if (threads <= 1) {
+    work(0);
+    return;
+  }
+
+  QThreadPool pool;
+  pool.setMaxThreadCount(threads);
+  for (int i = 0; i < threads; ++i) {
+    pool.start([&work, i]() { work(i); });
+  }
+  pool.waitForDone();
+}
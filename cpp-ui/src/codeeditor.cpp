@@ -1,21 +1,37 @@
 // /home/my9broxpki/GitProjects/CyberMD/cpp-ui/src: [codeeditor.cpp]
 
 #include "codeeditor.h"
+#include "blockdata.h"
 #include "codefolding.h"
+#include "decorationlayer.h"
 #include "foldingarea.h"
+#include "largefile.h"
 #include "linenumberarea.h"
+#include "minimap.h"
 #include "theme.h"
+#include <QEvent>
+#include <QHelpEvent>
 #include <QKeyEvent>
 #include <QMouseEvent>
 #include <QPainter>
+#include <QScrollBar>
 #include <QTextBlock>
 #include <QTextCursor>
 #include <QTimer>
+#include <QToolTip>
 
 CodeEditor::CodeEditor(QWidget *parent)
-    : QPlainTextEdit(parent), codeFolding_(nullptr), codeFoldingEnabled_(false),
-      theme_(nullptr) {
+    : QPlainTextEdit(parent), digitAdvance_(0), lineHeight_(0),
+      cachedDigits_(0), cachedLineNumberWidth_(0), currentBlockNumber_(-1),
+      lineNumberOffset_(0), codeFolding_(nullptr), codeFoldingEnabled_(false), theme_(nullptr),
+      indentWidth_(4), guideColor_(60, 60, 60),
+      activeGuideColor_(110, 110, 110), activeGuideColumn_(-1),
+      activeScopeFirst_(-1), activeScopeLast_(-1), indentRevision_(-1),
+      scopeTimer_(new QTimer(this)), decorations_(nullptr),
+      minimap_(nullptr), minimapEnabled_(false), largeFile_(nullptr) {
   lineNumberArea_ = new LineNumberArea(this);
+  decorations_ = new DecorationLayer(this);
+  updateGutterCache();
 
   connect(this, &CodeEditor::blockCountChanged, this,
           &CodeEditor::updateLineNumberAreaWidth);
@@ -24,35 +40,92 @@ CodeEditor::CodeEditor(QWidget *parent)
   connect(this, &CodeEditor::cursorPositionChanged, this,
           &CodeEditor::highlightCurrentLine);
   connect(this, &CodeEditor::textChanged, this, &CodeEditor::onTextChanged);
+  connect(document(), &QTextDocument::contentsChange, this,
+          &CodeEditor::onContentsChange);
+  indentRevision_ = document()->revision();
+
+  // One scope scan per pass of the event loop, however many changes
+  // arrived in it
+  scopeTimer_->setSingleShot(true);
+  scopeTimer_->setInterval(0);
+  connect(scopeTimer_, &QTimer::timeout, this, &CodeEditor::updateActiveScope);
 
   updateLineNumberAreaWidth(0);
   highlightCurrentLine();
 
   // Initialize code folding
   codeFolding_ = new CodeFolding(this, this);
-  codeFoldingEnabled_ = true;
+  connect(codeFolding_, &CodeFolding::foldingChanged, this,
+          &CodeEditor::updateFoldPlaceholders);
+  enableCodeFolding(true);
 }
 
 void CodeEditor::setTheme(Theme *theme) {
   theme_ = theme;
+  updateGutterCache();
+  lineNumberArea_->update();
+  if (minimap_) {
+    minimap_->updateColors();
+  }
+
+  // Decorations store their colors; re-derive them from the new theme
+  if (!diagnostics_.isEmpty()) {
+    setDiagnostics(diagnostics_);
+  }
+  updateFoldPlaceholders();
   viewport()->update();
 }
 
+// Rebuild the digit glyphs and gutter colors. Only needed when the font or
+// theme changes, so painting never lays out text or queries the theme.
+void CodeEditor::updateGutterCache() {
+  QFontMetrics metrics(font());
+  digitAdvance_ = 0;
+  for (int d = 0; d < 10; ++d) {
+    digitGlyphs_[d].setText(QString(QChar('0' + d)));
+    digitGlyphs_[d].setTextFormat(Qt::PlainText);
+    digitGlyphs_[d].prepare(QTransform(), font());
+    digitAdvance_ =
+        qMax(digitAdvance_, metrics.horizontalAdvance(QChar('0' + d)));
+  }
+  lineHeight_ = metrics.height();
+
+  gutterBackground_ =
+      theme_ ? theme_->lineNumberBackground() : QColor(40, 40, 40);
+  gutterForeground_ =
+      theme_ ? theme_->lineNumberForeground() : QColor(128, 128, 128);
+  gutterActiveForeground_ =
+      theme_ ? theme_->lineNumberActiveForeground() : QColor(200, 200, 200);
+  guideColor_ = theme_ ? theme_->indentGuideColor() : QColor(60, 60, 60);
+  activeGuideColor_ = guideColor_.lighter(180);
+  currentLineColor_ = theme_ ? theme_->editorCurrentLine()
+                             : QColor(Qt::darkGray).lighter(120);
+
+  // Force the width to be recomputed with the new metrics
+  cachedDigits_ = 0;
+}
+
 int CodeEditor::lineNumberAreaWidth() {
   int digits = 1;
-  int max = qMax(1, blockCount());
+  int max = qMax(1, blockCount() + lineNumberOffset_);
   while (max >= 10) {
     max /= 10;
     ++digits;
   }
 
-  int space = 3 + fontMetrics().horizontalAdvance(QLatin1Char('9')) * digits;
+  if (digits == cachedDigits_) {
+    return cachedLineNumberWidth_;
+  }
+
+  int space = 3 + digitAdvance_ * digits;
 
   // Add space for fold markers if enabled
   if (codeFoldingEnabled_) {
     space += foldingAreaWidth();
   }
 
+  cachedDigits_ = digits;
+  cachedLineNumberWidth_ = space;
   return space;
 }
 
@@ -61,7 +134,11 @@ int CodeEditor::foldingAreaWidth() {
 }
 
 void CodeEditor::updateLineNumberAreaWidth(int /* newBlockCount */) {
-  setViewportMargins(lineNumberAreaWidth(), 0, 0, 0);
+  int rightMargin = minimapEnabled_ ? Minimap::preferredWidth() : 0;
+  if (largeFile_) {
+    rightMargin += largeFile_->scrollBar()->sizeHint().width();
+  }
+  setViewportMargins(lineNumberAreaWidth(), 0, rightMargin, 0);
 }
 
 void CodeEditor::updateLineNumberArea(const QRect &rect, int dy) {
@@ -78,34 +155,110 @@ void CodeEditor::updateLineNumberArea(const QRect &rect, int dy) {
 void CodeEditor::resizeEvent(QResizeEvent *e) {
   QPlainTextEdit::resizeEvent(e);
 
+  updateSidebarGeometry();
+}
+
+void CodeEditor::updateSidebarGeometry() {
   QRect cr = contentsRect();
   lineNumberArea_->setGeometry(
       QRect(cr.left(), cr.top(), lineNumberAreaWidth(), cr.height()));
+
+  if (minimap_) {
+    QRect vr = viewport()->geometry();
+    minimap_->setGeometry(QRect(vr.right() + 1, vr.top(),
+                                Minimap::preferredWidth(), vr.height()));
+  }
+
+  if (largeFile_) {
+    QRect vr = viewport()->geometry();
+    int left = vr.right() + 1;
+    if (minimapEnabled_) {
+      left += Minimap::preferredWidth();
+    }
+    largeFile_->scrollBar()->setGeometry(
+        QRect(left, vr.top(), cr.right() + 1 - left, vr.height()));
+  }
 }
 
-void CodeEditor::highlightCurrentLine() {
-  QList<QTextEdit::ExtraSelection> extraSelections;
+void CodeEditor::setLargeFileController(LargeFileController *controller) {
+  largeFile_ = controller;
+  updateLineNumberAreaWidth(0);
+  updateSidebarGeometry();
+}
 
-  if (!isReadOnly()) {
-    QTextEdit::ExtraSelection selection;
+void CodeEditor::setLineNumberOffset(int offset) {
+  if (offset == lineNumberOffset_) {
+    return;
+  }
+  lineNumberOffset_ = offset;
+  cachedDigits_ = 0;
+  updateLineNumberAreaWidth(0);
+  updateSidebarGeometry();
+  lineNumberArea_->update();
+}
+
+void CodeEditor::enableMinimap(bool enable) {
+  if (enable == minimapEnabled_) {
+    return;
+  }
+  minimapEnabled_ = enable;
+
+  if (enable && !minimap_) {
+    minimap_ = new Minimap(this);
+  }
+  if (minimap_) {
+    minimap_->setVisible(enable);
+  }
 
-    QColor lineColor = theme_ ? theme_->editorCurrentLine()
-                              : QColor(Qt::darkGray).lighter(120);
+  updateLineNumberAreaWidth(0);
+  updateSidebarGeometry();
+}
+
+void CodeEditor::highlightCurrentLine() {
+  // Repaint only the gutter and text rows whose active state changed. The
+  // current line background is painted directly in paintEvent instead of
+  // rebuilding ExtraSelections on every cursor move.
+  int blockNumber = textCursor().blockNumber();
+  if (blockNumber != currentBlockNumber_) {
+    int previous = currentBlockNumber_;
+    currentBlockNumber_ = blockNumber;
+    updateBlockRect(previous);
+    updateBlockRect(blockNumber);
+    updateActiveScope();
+  }
+}
 
-    selection.format.setBackground(lineColor);
-    selection.format.setProperty(QTextFormat::FullWidthSelection, true);
-    selection.cursor = textCursor();
-    selection.cursor.clearSelection();
-    extraSelections.append(selection);
+void CodeEditor::updateBlockRect(int blockNumber) {
+  QTextBlock block = document()->findBlockByNumber(blockNumber);
+  if (!block.isValid() || !block.isVisible()) {
+    return;
   }
 
-  setExtraSelections(extraSelections);
+  QRectF rect = blockBoundingGeometry(block).translated(contentOffset());
+  if (!rect.intersects(viewport()->rect())) {
+    return;
+  }
+  QRect row(0, qRound(rect.top()), viewport()->width(), qRound(rect.height()));
+  viewport()->update(row);
+  lineNumberArea_->update(0, row.y(), lineNumberArea_->width(), row.height());
+}
+
+void CodeEditor::drawLineNumber(QPainter &painter, int number, int right,
+                                int top, bool active) {
+  painter.setPen(active ? gutterActiveForeground_ : gutterForeground_);
+
+  // Emit digits right-to-left from the cached glyphs; no string is built
+  int x = right;
+  do {
+    x -= digitAdvance_;
+    painter.drawStaticText(x, top, digitGlyphs_[number % 10]);
+    number /= 10;
+  } while (number > 0);
 }
 
 void CodeEditor::lineNumberAreaPaintEvent(QPaintEvent *event) {
   QPainter painter(lineNumberArea_);
-  QColor bgColor = theme_ ? theme_->lineNumberBackground() : QColor(40, 40, 40);
-  painter.fillRect(event->rect(), bgColor);
+  painter.fillRect(event->rect(), gutterBackground_);
 
   QTextBlock block = firstVisibleBlock();
   int blockNumber = block.blockNumber();
@@ -114,22 +267,19 @@ void CodeEditor::lineNumberAreaPaintEvent(QPaintEvent *event) {
   int bottom = top + qRound(blockBoundingRect(block).height());
 
   int foldMarkerWidth = codeFoldingEnabled_ ? foldingAreaWidth() : 0;
+  int numberRight = lineNumberArea_->width() - foldMarkerWidth - 3;
 
   while (block.isValid() && top <= event->rect().bottom()) {
     if (block.isVisible() && bottom >= event->rect().top()) {
       // Draw line number
-      QString number = QString::number(blockNumber + 1);
-      QColor fgColor =
-          theme_ ? theme_->lineNumberForeground() : QColor(128, 128, 128);
-      painter.setPen(fgColor);
-      painter.drawText(0, top, lineNumberArea_->width() - foldMarkerWidth - 3,
-                       fontMetrics().height(), Qt::AlignRight, number);
+      drawLineNumber(painter, lineNumberOffset_ + blockNumber + 1,
+                     numberRight, top, blockNumber == currentBlockNumber_);
 
       // Draw fold marker if this line is foldable
       if (codeFoldingEnabled_ && codeFolding_ &&
           codeFolding_->isFoldable(blockNumber)) {
         int markerX = lineNumberArea_->width() - foldMarkerWidth;
-        int markerY = top + (fontMetrics().height() / 2);
+        int markerY = top + (lineHeight_ / 2);
 
         // Draw fold icon (triangle or +/-)
         QPolygon triangle;
@@ -138,15 +288,14 @@ void CodeEditor::lineNumberAreaPaintEvent(QPaintEvent *event) {
           triangle << QPoint(markerX + 4, markerY - 4)
                    << QPoint(markerX + 4, markerY + 4)
                    << QPoint(markerX + 10, markerY);
-          painter.setBrush(fgColor);
         } else {
           // Unfolded: draw down-pointing triangle ▼
           triangle << QPoint(markerX + 3, markerY - 2)
                    << QPoint(markerX + 11, markerY - 2)
                    << QPoint(markerX + 7, markerY + 4);
-          painter.setBrush(fgColor);
         }
 
+        painter.setBrush(gutterForeground_);
         painter.setPen(Qt::NoPen);
         painter.drawPolygon(triangle);
       }
@@ -328,6 +477,7 @@ void CodeEditor::keyPressEvent(QKeyEvent *event) {
 
 void CodeEditor::enableCodeFolding(bool enable) {
   codeFoldingEnabled_ = enable;
+  cachedDigits_ = 0; // Gutter width depends on the fold marker column
   updateLineNumberAreaWidth(0);
   viewport()->update();
 }
@@ -395,6 +545,8 @@ CodeEditor::~CodeEditor() {
     delete codeFolding_;
     codeFolding_ = nullptr;
   }
+  delete decorations_;
+  decorations_ = nullptr;
 }
 
 // Slot: Update folding area (connected via signal)
@@ -439,23 +591,367 @@ void CodeEditor::wheelEvent(QWheelEvent *event) {
   QPlainTextEdit::wheelEvent(event);
 }
 
+// Override: font changes (zoom, settings) invalidate the gutter glyphs
+void CodeEditor::changeEvent(QEvent *event) {
+  QPlainTextEdit::changeEvent(event);
+  if (event->type() == QEvent::FontChange) {
+    updateGutterCache();
+    updateLineNumberAreaWidth(0);
+    lineNumberArea_->update();
+    refreshIndentGuides();
+  }
+}
+
 // Override: paintEvent for custom rendering
 void CodeEditor::paintEvent(QPaintEvent *event) {
-  // Call base class paint first
-  QPlainTextEdit::paintEvent(event);
+  {
+    // Backgrounds go under the text, so paint them before the base class
+    QPainter background(viewport());
+    paintCurrentLine(background, event->rect());
+    decorations_->paintBackgrounds(background, event->rect());
+  }
 
-  // Add any custom painting here (e.g., indent guides, minimap, etc.)
-  // Example: Draw indent guides
+  QPlainTextEdit::paintEvent(event);
 
   QPainter painter(viewport());
-  QColor guideColor = theme_ ? theme_->indentGuideColor() : QColor(60, 60, 60);
-  painter.setPen(guideColor);
+  paintIndentGuides(painter, event->rect());
+  paintDiagnosticUnderlines(painter, event->rect());
+  paintFoldedRegionPlaceholders(painter, event->rect());
+}
+
+void CodeEditor::paintCurrentLine(QPainter &painter, const QRect &rect) {
+  if (isReadOnly()) {
+    return;
+  }
+
+  QTextBlock block = textCursor().block();
+  if (!block.isVisible()) {
+    return;
+  }
+  QRectF line = blockBoundingGeometry(block).translated(contentOffset());
+  line.setLeft(0);
+  line.setWidth(viewport()->width());
+  if (line.intersects(rect)) {
+    painter.fillRect(line, currentLineColor_);
+  }
+}
+
+void CodeEditor::paintDiagnosticUnderlines(QPainter &painter,
+                                           const QRect &rect) {
+  if (!decorations_->isEmpty(DecorationKind::Diagnostic)) {
+    decorations_->paintUnderlines(painter, rect);
+  }
+}
+
+void CodeEditor::paintFoldedRegionPlaceholders(QPainter &painter,
+                                               const QRect &rect) {
+  if (!decorations_->isEmpty(DecorationKind::FoldPlaceholder)) {
+    decorations_->paintPlaceholders(painter, rect);
+  }
+}
+
+// ============================================
+// Decorations
+// ============================================
+
+// Diagnostic lines are 1-based as reported by the checkers.
+void CodeEditor::setDiagnostics(const QVector<Diagnostic> &diagnostics) {
+  diagnostics_ = diagnostics;
+  decorations_->clear(DecorationKind::Diagnostic);
+
+  for (const Diagnostic &diagnostic : diagnostics_) {
+    QString severity = diagnostic.severity.toLower();
+    QColor color;
+    if (severity == "error") {
+      color = theme_ ? theme_->errorColor() : QColor("#f48771");
+    } else if (severity == "warning") {
+      color = theme_ ? theme_->warningColor() : QColor("#cca700");
+    } else if (severity == "info") {
+      color = theme_ ? theme_->infoColor() : QColor("#75beff");
+    } else {
+      color = theme_ ? theme_->hintColor() : QColor("#a0a0a0");
+    }
+
+    int length = diagnostic.length > 0 ? diagnostic.length : -1;
+    int column = qMax(0, diagnostic.column - 1);
+    QString tooltip = diagnostic.source.isEmpty()
+                          ? diagnostic.message
+                          : QString("%1: %2").arg(diagnostic.source,
+                                                  diagnostic.message);
+    decorations_->add(DecorationKind::Diagnostic, diagnostic.line - 1, column,
+                      length, color, tooltip);
+  }
+
+  viewport()->update();
+  emit diagnosticsChanged();
+}
+
+void CodeEditor::setLineDecoration(int line, const QColor &color,
+                                   const QString &tooltip) {
+  decorations_->clearLine(DecorationKind::LineBackground, line);
+  decorations_->add(DecorationKind::LineBackground, line, 0, -1, color,
+                    tooltip);
+  updateBlockRect(line);
+}
+
+void CodeEditor::clearLineDecorations() {
+  decorations_->clear(DecorationKind::LineBackground);
+  viewport()->update();
+}
+
+// Matches are collected once per pattern and then kept current for the
+// edited blocks only; painting touches just the hits inside the viewport.
+void CodeEditor::highlightSearchMatches(const QRegularExpression &pattern) {
+  decorations_->clear(DecorationKind::SearchHit);
+  searchPattern_ = pattern.isValid() ? pattern : QRegularExpression();
+
+  if (!searchPattern_.pattern().isEmpty()) {
+    for (QTextBlock block = document()->begin(); block.isValid();
+         block = block.next()) {
+      highlightSearchBlock(block);
+    }
+  }
+
+  viewport()->update();
+}
+
+void CodeEditor::clearSearchHighlights() {
+  decorations_->clear(DecorationKind::SearchHit);
+  searchPattern_ = QRegularExpression();
+  viewport()->update();
+}
+
+void CodeEditor::highlightSearchBlock(const QTextBlock &block) {
+  QColor color =
+      theme_ ? theme_->searchMatchBackground() : QColor(255, 200, 0, 80);
+  QRegularExpressionMatchIterator it = searchPattern_.globalMatch(block.text());
+  while (it.hasNext()) {
+    QRegularExpressionMatch match = it.next();
+    if (match.capturedLength() > 0) {
+      decorations_->add(DecorationKind::SearchHit, block.blockNumber(),
+                        match.capturedStart(), match.capturedLength(), color);
+    }
+  }
+}
+
+void CodeEditor::updateFoldPlaceholders() {
+  decorations_->clear(DecorationKind::FoldPlaceholder);
+
+  if (codeFolding_) {
+    QColor color = theme_ ? theme_->foldingMarker() : QColor(128, 128, 128);
+    const auto &regions = codeFolding_->regions();
+    for (auto it = regions.constBegin(); it != regions.constEnd(); ++it) {
+      if (codeFolding_->isFolded(it.key())) {
+        int hidden = it->endLine - it->startLine;
+        decorations_->add(DecorationKind::FoldPlaceholder, it.key(), 0, -1,
+                          color, QString("%1 hidden lines").arg(hidden));
+      }
+    }
+  }
+
+  viewport()->update();
+}
+
+// Tooltips for decorated ranges (diagnostic messages, line notes)
+bool CodeEditor::viewportEvent(QEvent *event) {
+  if (event->type() == QEvent::ToolTip) {
+    QHelpEvent *help = static_cast<QHelpEvent *>(event);
+    QTextCursor cursor = cursorForPosition(help->pos());
+    QString tooltip =
+        decorations_->tooltipAt(cursor.blockNumber(), cursor.positionInBlock());
+    if (!tooltip.isEmpty()) {
+      QToolTip::showText(help->globalPos(), tooltip, viewport());
+    } else {
+      QToolTip::hideText();
+      event->ignore();
+    }
+    return true;
+  }
+  return QPlainTextEdit::viewportEvent(event);
+}
+
+// ============================================
+// Indent Guides
+// ============================================
+
+// Keep the cached indent of every touched block current. Only the leading
+// whitespace is scanned, and only for blocks inside the change.
+void CodeEditor::onContentsChange(int position, int charsRemoved,
+                                  int charsAdded) {
+  // The highlighter reports every block it formats; those changes keep
+  // the length and the revision, and leave every indent as it was.
+  // setPlainText() reports the whole document, so every block is cached
+  // before it can be painted
+  int revision = document()->revision();
+  if (revision == indentRevision_ && charsRemoved == charsAdded) {
+    return;
+  }
+  indentRevision_ = revision;
+
+  QTextBlock block = document()->findBlock(position);
+  QTextBlock last = document()->findBlock(position + charsAdded);
+  if (!last.isValid()) {
+    last = document()->lastBlock();
+  }
+
+  const bool searching = !searchPattern_.pattern().isEmpty();
+  for (; block.isValid(); block = block.next()) {
+    updateBlockIndent(block);
+    if (searching) {
+      decorations_->clearLine(DecorationKind::SearchHit, block.blockNumber());
+      highlightSearchBlock(block);
+    }
+    if (block == last) {
+      break;
+    }
+  }
+
+  scopeTimer_->start();
+}
+
+void CodeEditor::updateBlockIndent(QTextBlock block) {
+  BlockData *data = BlockData::of(block);
+  const QString text = block.text();
+  int tabColumns = qMax(1, qRound(tabStopDistance() /
+                                  fontMetrics().horizontalAdvance(' ')));
+
+  int columns = 0;
+  int i = 0;
+  for (; i < text.length(); ++i) {
+    QChar c = text.at(i);
+    if (c == QLatin1Char(' ')) {
+      ++columns;
+    } else if (c == QLatin1Char('\t')) {
+      columns = (columns / tabColumns + 1) * tabColumns;
+    } else {
+      break;
+    }
+  }
+
+  data->indentColumns = columns;
+  data->indentBlank = (i == text.length());
+  data->indentValid = true;
+}
+
+// Painting never scans text: a block without a cached indent (only
+// possible before its contentsChange arrives) draws no guides
+int CodeEditor::blockIndent(const QTextBlock &block) {
+  BlockData *data = BlockData::peek(block);
+  if (!data || !data->indentValid) {
+    return 0;
+  }
+  return data->indentBlank ? -1 : data->indentColumns;
+}
+
+void CodeEditor::refreshIndentGuides() {
+  for (QTextBlock block = document()->begin(); block.isValid();
+       block = block.next()) {
+    updateBlockIndent(block);
+  }
+  scopeTimer_->start();
+  viewport()->update();
+}
+
+// Blank lines continue the guides of the surrounding code: use the smaller
+// indent of the nearest non-blank neighbours (looked up from the cache).
+int CodeEditor::effectiveIndent(const QTextBlock &block) {
+  int indent = blockIndent(block);
+  if (indent >= 0) {
+    return indent;
+  }
+
+  const int maxLookup = 64;
+  int before = 0;
+  QTextBlock prev = block.previous();
+  for (int n = 0; prev.isValid() && n < maxLookup;
+       ++n, prev = prev.previous()) {
+    int value = blockIndent(prev);
+    if (value >= 0) {
+      before = value;
+      break;
+    }
+  }
+
+  int after = 0;
+  QTextBlock next = block.next();
+  for (int n = 0; next.isValid() && n < maxLookup; ++n, next = next.next()) {
+    int value = blockIndent(next);
+    if (value >= 0) {
+      after = value;
+      break;
+    }
+  }
+
+  return qMin(before, after);
+}
+
+// The active guide is the innermost one enclosing the cursor line; its
+// scope runs while neighbouring lines stay indented past that guide.
+void CodeEditor::updateActiveScope() {
+  const int maxScan = 2000;
+  QTextBlock block = textCursor().block();
+  int indent = effectiveIndent(block);
+
+  // A line that opens a deeper block highlights the block it opens
+  QTextBlock next = block.next();
+  if (next.isValid() && effectiveIndent(next) > indent) {
+    indent = effectiveIndent(next);
+    block = next;
+  }
+
+  int column = indent > 0 ? ((indent - 1) / indentWidth_) * indentWidth_ : -1;
+  int first = block.blockNumber();
+  int last = first;
+
+  if (column >= 0) {
+    QTextBlock prev = block.previous();
+    for (int n = 0; prev.isValid() && n < maxScan &&
+                    effectiveIndent(prev) > column;
+         ++n, prev = prev.previous()) {
+      --first;
+    }
+    QTextBlock after = block.next();
+    for (int n = 0; after.isValid() && n < maxScan &&
+                    effectiveIndent(after) > column;
+         ++n, after = after.next()) {
+      ++last;
+    }
+  }
+
+  if (column != activeGuideColumn_ || first != activeScopeFirst_ ||
+      last != activeScopeLast_) {
+    activeGuideColumn_ = column;
+    activeScopeFirst_ = first;
+    activeScopeLast_ = last;
+    viewport()->update();
+  }
+}
+
+void CodeEditor::paintIndentGuides(QPainter &painter, const QRect &rect) {
+  qreal spaceWidth = fontMetrics().horizontalAdvance(QLatin1Char(' '));
+  qreal left = contentOffset().x() + document()->documentMargin();
 
-  // Draw vertical lines at tab stops
-  int tabWidth = fontMetrics().horizontalAdvance("    ");
   QTextBlock block = firstVisibleBlock();
-  while (block.isValid() && block.isVisible()) {
-    // Draw indent guides logic here
+  int blockNumber = block.blockNumber();
+  qreal top = blockBoundingGeometry(block).translated(contentOffset()).top();
+
+  while (block.isValid() && top <= rect.bottom()) {
+    qreal height = blockBoundingRect(block).height();
+    if (block.isVisible() && top + height >= rect.top()) {
+      int indent = effectiveIndent(block);
+      bool inScope = blockNumber >= activeScopeFirst_ &&
+                     blockNumber <= activeScopeLast_;
+
+      for (int column = 0; column < indent; column += indentWidth_) {
+        bool active = inScope && column == activeGuideColumn_;
+        painter.setPen(active ? activeGuideColor_ : guideColor_);
+        qreal x = qRound(left + column * spaceWidth) + 0.5;
+        painter.drawLine(QPointF(x, top), QPointF(x, top + height));
+      }
+    }
+
     block = block.next();
+    top += height;
+    ++blockNumber;
   }
 }
@@ -50,6 +50,8 @@ void CodeFolding::analyzeFoldRegions() {
         block = block.next();
         lineNum++;
     }
+
+    emit foldingChanged();
 }
 
 bool CodeFolding::isHeader(const QString& text, int& level) {
@@ -164,6 +166,8 @@ void CodeFolding::toggleFoldAtLine(int line) {
         foldRegion(region.startLine, region.endLine);
         foldedLines_.insert(line);
     }
+
+    emit foldingChanged();
 }
 
 void CodeFolding::foldRegion(int startLine, int endLine) {
@@ -224,6 +228,8 @@ void CodeFolding::foldAll() {
             foldedLines_.insert(startLine);
         }
     }
+
+    emit foldingChanged();
 }
 
 void CodeFolding::unfoldAll() {
@@ -231,6 +237,8 @@ void CodeFolding::unfoldAll() {
         unfoldRegion(line);
     }
     foldedLines_.clear();
+
+    emit foldingChanged();
 }
 
 void CodeFolding::updateFolding() {
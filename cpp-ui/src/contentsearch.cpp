@@ -0,0 +1,450 @@
+#include "contentsearch.h"
+#include "gzipdevice.h"
+#include <QElapsedTimer>
+#include <QFile>
+#include <QThread>
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+// Files with a NUL byte this close to the start are not searched
+const qint64 kBinaryProbeBytes = 8192;
+
+// Inflated gzip contents are searched this much at a time
+const qint64 kInflateChunk = 4 * 1024 * 1024;
+
+// Bytes searched between cancellation checks
+const qint64 kSearchChunk = 16 * 1024 * 1024;
+
+// Lines tried by a regular expression between cancellation checks
+const int kRegexCheckLines = 4096;
+
+// A worker hands over its hits at this count or this age
+const int kFlushHits = 128;
+const int kFlushIntervalMs = 50;
+
+// Display snippet around a hit, in characters
+const int kSnippetContext = 40;
+const int kSnippetLength = 160;
+
+// Letters by how common they are in text and code, most common first;
+// the literal search looks for the rarest byte of the needle
+const char kLetterFrequency[] = "etaoinsrhldcumfpgwybvkxjqz";
+
+inline char foldAscii(char c) {
+  return (c >= 'A' && c <= 'Z') ? char(c + ('a' - 'A')) : c;
+}
+
+int rarity(char c) {
+  if (c >= 'a' && c <= 'z') {
+    return int(std::strchr(kLetterFrequency, c) - kLetterFrequency);
+  }
+  if (c == ' ' || c == '\t' || c == '\n') {
+    return -1;
+  }
+  // Digits, punctuation and non-ASCII bytes are rarer than any letter
+  return int(sizeof(kLetterFrequency));
+}
+
+// UTF-16 length of the UTF-8 bytes in [begin, end)
+int utf16Length(const char *begin, const char *end) {
+  int length = 0;
+  for (const char *p = begin; p < end; ++p) {
+    uchar c = uchar(*p);
+    if ((c & 0xC0) != 0x80) {
+      length += c >= 0xF0 ? 2 : 1;
+    }
+  }
+  return length;
+}
+
+inline bool isContinuation(const char *p) {
+  return (uchar(*p) & 0xC0) == 0x80;
+}
+
+// The literal search folds ASCII case only
+bool isAscii(const QString &text) {
+  for (QChar c : text) {
+    if (c.unicode() >= 0x80) {
+      return false;
+    }
+  }
+  return true;
+}
+
+} // namespace
+
+// ==================== LiteralSearcher ====================
+
+LiteralSearcher::LiteralSearcher(const QByteArray &needle)
+    : lower_(needle), rareIndex_(0), rareLower_(0), rareUpper_(0) {
+  int best = -2;
+  for (int i = 0; i < lower_.size(); ++i) {
+    lower_[i] = foldAscii(lower_[i]);
+    int rank = rarity(lower_[i]);
+    if (rank > best) {
+      best = rank;
+      rareIndex_ = i;
+    }
+  }
+  if (!lower_.isEmpty()) {
+    rareLower_ = lower_[rareIndex_];
+    rareUpper_ = (rareLower_ >= 'a' && rareLower_ <= 'z')
+                     ? char(rareLower_ - ('a' - 'A'))
+                     : rareLower_;
+  }
+}
+
+const char *LiteralSearcher::find(const char *begin, const char *end) const {
+  const int length = lower_.size();
+  if (length == 0 || end - begin < length) {
+    return nullptr;
+  }
+
+  const char *needle = lower_.constData();
+  // The rare byte can only sit where a whole needle fits around it
+  const char *scan = begin + rareIndex_;
+  const char *scanEnd = end - (length - rareIndex_) + 1;
+  const bool twoCases = rareLower_ != rareUpper_;
+
+  // Next occurrence of each case; refreshed only once passed
+  const char *nextLower = nullptr;
+  const char *nextUpper = nullptr;
+  bool lowerDone = false;
+  bool upperDone = !twoCases;
+
+  while (scan < scanEnd) {
+    if (!lowerDone && (!nextLower || nextLower < scan)) {
+      nextLower = static_cast<const char *>(
+          std::memchr(scan, rareLower_, size_t(scanEnd - scan)));
+      lowerDone = nextLower == nullptr;
+    }
+    if (!upperDone && (!nextUpper || nextUpper < scan)) {
+      nextUpper = static_cast<const char *>(
+          std::memchr(scan, rareUpper_, size_t(scanEnd - scan)));
+      upperDone = nextUpper == nullptr;
+    }
+
+    const char *hit = nullptr;
+    if (!lowerDone) {
+      hit = nextLower;
+    }
+    if (!upperDone && (!hit || nextUpper < hit)) {
+      hit = nextUpper;
+    }
+    if (!hit) {
+      return nullptr;
+    }
+
+    const char *start = hit - rareIndex_;
+    int i = 0;
+    while (i < length && foldAscii(start[i]) == needle[i]) {
+      ++i;
+    }
+    if (i == length) {
+      return start;
+    }
+    scan = hit + 1;
+  }
+  return nullptr;
+}
+
+// ==================== ContentSearchJob ====================
+
+class ContentSearchJob::Worker {
+public:
+  QRegularExpression regex; // Own copy: matching is not shared across threads
+  QVector<FuzzyMatch> pending;
+  QElapsedTimer sinceFlush;
+};
+
+ContentSearchJob::ContentSearchJob(const QString &pattern,
+                                   const QString &rootPath,
+                                   const QStringList &files, int maxHits)
+    : pattern_(pattern), rootPath_(rootPath), files_(files),
+      maxHits_(maxHits), regex_(isRegex(pattern) || !isAscii(pattern)),
+      literal_(pattern.toUtf8()), cancelled_(false), nextFile_(0),
+      hitCount_(0), truncated_(false) {}
+
+ContentSearchJob::ContentSearchJob(const QString &pattern,
+                                   const QString &rootPath,
+                                   const QVector<BufferSnapshot> &buffers,
+                                   int maxHits)
+    : ContentSearchJob(pattern, rootPath, QStringList(), maxHits) {
+  buffers_ = buffers;
+}
+
+bool ContentSearchJob::isRegex(const QString &pattern) {
+  return pattern.length() > 2 && pattern.startsWith('/') &&
+         pattern.endsWith('/');
+}
+
+QRegularExpression ContentSearchJob::regexFor(const QString &pattern) {
+  return QRegularExpression(pattern.mid(1, pattern.length() - 2),
+                            QRegularExpression::CaseInsensitiveOption);
+}
+
+void ContentSearchJob::run() {
+  const int items = files_.size() + buffers_.size();
+  const int threads = qBound(1, QThread::idealThreadCount(), qMax(1, items));
+
+  runParallel(threads, [this, items](int) {
+    Worker worker;
+    if (regex_) {
+      // Other letters than ASCII ones need Unicode case folding, which
+      // the regular expression engine does
+      worker.regex = isRegex(pattern_)
+                         ? regexFor(pattern_)
+                         : QRegularExpression(
+                               QRegularExpression::escape(pattern_),
+                               QRegularExpression::CaseInsensitiveOption);
+    }
+    worker.sinceFlush.start();
+
+    // Files are taken one at a time, so a few huge ones do not leave the
+    // other workers idle
+    while (!cancelled_ && !truncated_) {
+      int index = nextFile_++;
+      if (index >= items) {
+        break;
+      }
+      if (index < files_.size()) {
+        searchFile(worker, files_.at(index));
+      } else {
+        searchBuffer(worker, buffers_.at(index - files_.size()));
+      }
+      flush(worker, false);
+    }
+    flush(worker, true);
+  });
+
+  if (!cancelled_) {
+    emit finished(qMin(int(hitCount_), maxHits_), truncated_);
+  }
+  deleteLater();
+}
+
+void ContentSearchJob::searchFile(Worker &worker, const QString &filePath) {
+  QFile file(filePath);
+  if (!file.open(QIODevice::ReadOnly)) {
+    return;
+  }
+
+  if (GzipDevice::isGzip(&file)) {
+    searchGzip(worker, filePath, &file);
+    return;
+  }
+
+  // Mapped where possible; the mapping goes away with the QFile
+  QByteArray buffer;
+  qint64 size = file.size();
+  if (size <= 0) {
+    return;
+  }
+  const char *data = reinterpret_cast<const char *>(file.map(0, size));
+  if (!data) {
+    buffer = file.readAll();
+    data = buffer.constData();
+    size = buffer.size();
+  }
+
+  if (std::memchr(data, 0, size_t(qMin(size, kBinaryProbeBytes)))) {
+    return;
+  }
+  searchText(worker, filePath, data, size, 1);
+}
+
+void ContentSearchJob::searchGzip(Worker &worker, const QString &filePath,
+                                  QIODevice *file) {
+  GzipDevice gzip(file);
+  if (!gzip.open(QIODevice::ReadOnly)) {
+    return;
+  }
+  QByteArray buffer = gzip.read(kBinaryProbeBytes);
+  if (buffer.contains('\0')) {
+    return;
+  }
+
+  // The partial line at the end of a chunk is carried into the next; a
+  // line longer than a chunk is searched in pieces
+  int firstLine = 1;
+  while (!cancelled_ && !truncated_) {
+    QByteArray chunk = gzip.read(kInflateChunk);
+    const bool last = chunk.isEmpty();
+    buffer += chunk;
+
+    qint64 complete = last ? buffer.size() : buffer.lastIndexOf('\n') + 1;
+    if (complete == 0 && buffer.size() >= kInflateChunk) {
+      complete = buffer.size();
+    }
+    if (complete > 0) {
+      const char *data = buffer.constData();
+      searchText(worker, filePath, data, complete, firstLine);
+      firstLine += int(std::count(data, data + complete, '\n'));
+      buffer.remove(0, int(complete));
+    }
+    if (last) {
+      return;
+    }
+  }
+}
+
+void ContentSearchJob::searchBuffer(Worker &worker,
+                                    const BufferSnapshot &buffer) {
+  // Converted here rather than on the UI thread; line and column come
+  // out in the editor's terms, since its lines are split on '\n' too
+  const QByteArray utf8 = buffer.compressedUtf8.isEmpty()
+                              ? buffer.text.toUtf8()
+                              : qUncompress(buffer.compressedUtf8);
+  if (!utf8.isEmpty()) {
+    searchText(worker, buffer.filePath, utf8.constData(), utf8.size(), 1);
+  }
+}
+
+void ContentSearchJob::searchText(Worker &worker, const QString &filePath,
+                                  const char *data, qint64 size,
+                                  int firstLine) {
+  const QString relative = filePath.startsWith(rootPath_ + '/')
+                               ? filePath.mid(rootPath_.length() + 1)
+                               : filePath;
+  const char *end = data + size;
+
+  // Builds the row for a hit at [column, column + length) of window,
+  // the decoded text around it
+  auto makeHit = [&](int lineNumber, int lineColumn, const QString &window,
+                     int column, int length) {
+    int lead = 0;
+    while (lead < column && window.at(lead).isSpace()) {
+      ++lead;
+    }
+    int snippetStart = qMax(lead, column - kSnippetContext);
+    QString snippet = window.mid(snippetStart, kSnippetLength);
+    while (!snippet.isEmpty() && snippet.at(snippet.length() - 1).isSpace()) {
+      snippet.chop(1);
+    }
+
+    FuzzyMatch hit;
+    hit.filePath = filePath;
+    hit.lineNumber = lineNumber;
+    hit.column = lineColumn;
+    QString prefix = QString("%1:%2: ").arg(relative).arg(lineNumber);
+    hit.text = prefix + snippet;
+    int first = prefix.length() + column - snippetStart;
+    for (int i = 0; i < length && first + i < hit.text.length(); ++i) {
+      hit.matchPositions.append(first + i);
+    }
+    return hit;
+  };
+
+  if (regex_) {
+    int lineNumber = firstLine - 1;
+    for (const char *lineStart = data; lineStart < end;) {
+      const char *lineEnd = static_cast<const char *>(
+          std::memchr(lineStart, '\n', size_t(end - lineStart)));
+      if (!lineEnd) {
+        lineEnd = end;
+      }
+      ++lineNumber;
+      if (lineNumber % kRegexCheckLines == 0 && (cancelled_ || truncated_)) {
+        return;
+      }
+
+      QString line = QString::fromUtf8(lineStart, int(lineEnd - lineStart));
+      if (line.endsWith('\r')) {
+        line.chop(1);
+      }
+      QRegularExpressionMatch match = worker.regex.match(line);
+      if (match.hasMatch()) {
+        int column = match.capturedStart();
+        if (!addHit(worker, makeHit(lineNumber, column, line, column,
+                                    qMax(1, match.capturedLength())))) {
+          return;
+        }
+      }
+      lineStart = lineEnd + 1;
+    }
+    return;
+  }
+
+  const int needleLength = literal_.length();
+  int lineNumber = firstLine;
+  const char *counted = data; // Newlines before this are in lineNumber
+  const char *pos = data;
+  while (pos < end) {
+    // Searched in chunks so a huge file notices cancellation
+    const char *hit = nullptr;
+    while (!hit && pos < end) {
+      if (cancelled_ || truncated_) {
+        return;
+      }
+      const char *chunkEnd = qMin(end, pos + kSearchChunk);
+      hit = literal_.find(pos, qMin(end, chunkEnd + needleLength - 1));
+      if (!hit) {
+        pos = chunkEnd;
+      }
+    }
+    if (!hit) {
+      return;
+    }
+
+    lineNumber += int(std::count(counted, hit, '\n'));
+    counted = hit;
+
+    const char *lineStart = hit;
+    while (lineStart > data && lineStart[-1] != '\n') {
+      --lineStart;
+    }
+    const char *lineEnd = static_cast<const char *>(
+        std::memchr(hit, '\n', size_t(end - hit)));
+    if (!lineEnd) {
+      lineEnd = end;
+    }
+    const char *hitEnd = hit + needleLength;
+
+    // Only the text around the hit is decoded, which matters for
+    // minified files whose "lines" run to megabytes
+    const char *windowStart = qMax(lineStart, hit - 4 * kSnippetContext);
+    while (windowStart > lineStart && isContinuation(windowStart)) {
+      --windowStart;
+    }
+    const char *windowEnd = qMin(lineEnd, hitEnd + 4 * kSnippetLength);
+    while (windowEnd < lineEnd && isContinuation(windowEnd)) {
+      ++windowEnd;
+    }
+    QString window =
+        QString::fromUtf8(windowStart, int(windowEnd - windowStart));
+
+    if (!addHit(worker, makeHit(lineNumber, utf16Length(lineStart, hit),
+                                window, utf16Length(windowStart, hit),
+                                utf16Length(hit, hitEnd)))) {
+      return;
+    }
+    // One hit per line
+    pos = lineEnd + 1;
+  }
+}
+
+bool ContentSearchJob::addHit(Worker &worker, FuzzyMatch hit) {
+  if (hitCount_.fetch_add(1) >= maxHits_) {
+    truncated_ = true;
+    return false;
+  }
+  worker.pending.append(std::move(hit));
+  if (worker.pending.size() >= kFlushHits) {
+    flush(worker, true);
+  }
+  return true;
+}
+
+void ContentSearchJob::flush(Worker &worker, bool force) {
+  if (worker.pending.isEmpty() || cancelled_) {
+    return;
+  }
+  if (!force && worker.sinceFlush.elapsed() < kFlushIntervalMs) {
+    return;
+  }
+  emit hitsFound(worker.pending);
+  worker.pending.clear();
+  worker.sinceFlush.restart();
+}
@@ -0,0 +1,240 @@
+#include "decorationlayer.h"
+#include "codeeditor.h"
+#include <QPainter>
+#include <QPainterPath>
+#include <QTextDocument>
+#include <QTextLayout>
+#include <algorithm>
+
+BlockData::~BlockData() {
+  if (decorationLayer) {
+    decorationLayer->forget(this);
+  }
+}
+
+namespace {
+
+void removeKind(BlockData *data, DecorationKind kind) {
+  data->decorations.erase(
+      std::remove_if(data->decorations.begin(), data->decorations.end(),
+                     [kind](const BlockDecoration &decoration) {
+                       return decoration.kind == kind;
+                     }),
+      data->decorations.end());
+}
+
+} // namespace
+
+DecorationLayer::DecorationLayer(CodeEditor *editor) : editor_(editor) {}
+
+DecorationLayer::~DecorationLayer() {
+  // The document, and the block data, may outlive the layer
+  for (const QSet<BlockData *> &blocks : blocks_) {
+    for (BlockData *data : blocks) {
+      data->decorationLayer = nullptr;
+    }
+  }
+}
+
+void DecorationLayer::forget(BlockData *data) {
+  for (QSet<BlockData *> &blocks : blocks_) {
+    blocks.remove(data);
+  }
+}
+
+void DecorationLayer::add(DecorationKind kind, int line, int column,
+                          int length, const QColor &color,
+                          const QString &tooltip) {
+  QTextBlock block = editor_->document()->findBlockByNumber(line);
+  if (!block.isValid()) {
+    return;
+  }
+
+  BlockData *data = BlockData::of(block);
+  data->decorationLayer = this;
+  blocks_[int(kind)].insert(data);
+
+  BlockDecoration decoration;
+  decoration.kind = kind;
+  decoration.start = qMax(0, column);
+  decoration.length = length;
+  decoration.color = color;
+  decoration.tooltip = tooltip;
+  data->decorations.append(decoration);
+}
+
+void DecorationLayer::clear(DecorationKind kind) {
+  for (BlockData *data : blocks_[int(kind)]) {
+    removeKind(data, kind);
+  }
+  blocks_[int(kind)].clear();
+}
+
+void DecorationLayer::clearLine(DecorationKind kind, int line) {
+  QTextBlock block = editor_->document()->findBlockByNumber(line);
+  BlockData *data = BlockData::peek(block);
+  if (!data) {
+    return;
+  }
+  removeKind(data, kind);
+  blocks_[int(kind)].remove(data);
+}
+
+bool DecorationLayer::isEmpty(DecorationKind kind) const {
+  return blocks_[int(kind)].isEmpty();
+}
+
+QString DecorationLayer::tooltipAt(int line, int column) const {
+  QTextBlock block = editor_->document()->findBlockByNumber(line);
+  BlockData *data = BlockData::peek(block);
+  if (!data) {
+    return QString();
+  }
+
+  for (const BlockDecoration &decoration : data->decorations) {
+    if (decoration.tooltip.isEmpty()) {
+      continue;
+    }
+    bool covers = decoration.kind == DecorationKind::LineBackground ||
+                  decoration.length < 0 ||
+                  (column >= decoration.start &&
+                   column <= decoration.start + decoration.length);
+    if (covers) {
+      return decoration.tooltip;
+    }
+  }
+  return QString();
+}
+
+// Visit only the visible blocks that intersect the exposed rect and carry
+// decorations. Cost scales with the viewport, not with the decoration count.
+template <typename Fn>
+void DecorationLayer::forEachVisible(const QRect &rect, Fn fn) {
+  QPointF offset = editor_->getContentOffset();
+  QTextBlock block = editor_->getFirstVisibleBlock();
+  qreal top = editor_->getBlockBoundingGeometry(block).translated(offset).top();
+
+  while (block.isValid() && top <= rect.bottom()) {
+    qreal height = editor_->getBlockBoundingRect(block).height();
+    if (block.isVisible() && top + height >= rect.top()) {
+      BlockData *data = BlockData::peek(block);
+      if (data && !data->decorations.isEmpty()) {
+        for (const BlockDecoration &decoration : data->decorations) {
+          fn(block, top, height, decoration);
+        }
+      }
+    }
+    block = block.next();
+    top += height;
+  }
+}
+
+QVector<QRectF> DecorationLayer::rangeRects(const QTextBlock &block,
+                                           qreal top, int start,
+                                           int length) const {
+  QVector<QRectF> rects;
+  QTextLayout *layout = block.layout();
+  if (!layout) {
+    return rects;
+  }
+
+  int end = length < 0 ? block.length() - 1 : start + length;
+  qreal left = editor_->getContentOffset().x();
+  for (int i = 0; i < layout->lineCount(); ++i) {
+    QTextLine line = layout->lineAt(i);
+    int lineStart = line.textStart();
+    int lineEnd = lineStart + line.textLength();
+    if (end < lineStart || start > lineEnd) {
+      continue;
+    }
+    qreal x1 = line.cursorToX(qMax(start, lineStart));
+    qreal x2 = line.cursorToX(qMin(end, lineEnd));
+    rects.append(QRectF(left + x1, top + line.y(), qMax(x2 - x1, 1.0),
+                        line.height()));
+  }
+  return rects;
+}
+
+void DecorationLayer::paintBackgrounds(QPainter &painter, const QRect &rect) {
+  int viewportWidth = editor_->viewport()->width();
+  forEachVisible(rect, [&](const QTextBlock &block, qreal top, qreal height,
+                           const BlockDecoration &decoration) {
+    switch (decoration.kind) {
+    case DecorationKind::LineBackground:
+      painter.fillRect(QRectF(0, top, viewportWidth, height), decoration.color);
+      break;
+    case DecorationKind::SearchHit:
+      for (const QRectF &r :
+           rangeRects(block, top, decoration.start, decoration.length)) {
+        painter.fillRect(r, decoration.color);
+      }
+      break;
+    default:
+      break;
+    }
+  });
+}
+
+void DecorationLayer::paintUnderlines(QPainter &painter, const QRect &rect) {
+  forEachVisible(rect, [&](const QTextBlock &block, qreal top, qreal,
+                           const BlockDecoration &decoration) {
+    if (decoration.kind != DecorationKind::Diagnostic) {
+      return;
+    }
+    for (const QRectF &r :
+         rangeRects(block, top, decoration.start, decoration.length)) {
+      drawWave(painter, r, decoration.color);
+    }
+  });
+}
+
+void DecorationLayer::paintPlaceholders(QPainter &painter, const QRect &rect) {
+  QFontMetrics metrics = editor_->fontMetrics();
+  const QString ellipsis = QStringLiteral("…");
+  qreal boxWidth = metrics.horizontalAdvance(ellipsis) + 8;
+
+  forEachVisible(rect, [&](const QTextBlock &block, qreal top, qreal,
+                           const BlockDecoration &decoration) {
+    if (decoration.kind != DecorationKind::FoldPlaceholder) {
+      return;
+    }
+    QTextLayout *layout = block.layout();
+    if (!layout || layout->lineCount() == 0) {
+      return;
+    }
+    QTextLine last = layout->lineAt(layout->lineCount() - 1);
+    QRectF box(editor_->getContentOffset().x() + last.naturalTextWidth() + 6,
+               top + last.y() + 2, boxWidth, last.height() - 4);
+
+    painter.save();
+    painter.setRenderHint(QPainter::Antialiasing);
+    painter.setPen(decoration.color);
+    painter.setBrush(Qt::NoBrush);
+    painter.drawRoundedRect(box, 3, 3);
+    painter.drawText(box, Qt::AlignCenter, ellipsis);
+    painter.restore();
+  });
+}
+
+void DecorationLayer::drawWave(QPainter &painter, const QRectF &rect,
+                               const QColor &color) {
+  const qreal amplitude = 1.5;
+  const qreal period = 4.0;
+  qreal y = rect.bottom() - amplitude;
+
+  QPainterPath path;
+  path.moveTo(rect.left(), y);
+  bool up = true;
+  for (qreal x = rect.left() + period / 2; x <= rect.right();
+       x += period / 2) {
+    path.lineTo(x, up ? y - amplitude : y + amplitude);
+    up = !up;
+  }
+
+  painter.save();
+  painter.setRenderHint(QPainter::Antialiasing);
+  painter.setPen(QPen(color, 1));
+  painter.setBrush(Qt::NoBrush);
+  painter.drawPath(path);
+  painter.restore();
+}
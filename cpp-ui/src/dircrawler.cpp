@@ -0,0 +1,754 @@
+#include "dircrawler.h"
+#include "backgroundjob.h"
+#include <QDir>
+#include <QFile>
+#include <QDateTime>
+#include <QFileInfo>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QThread>
+#include <QWaitCondition>
+#include <atomic>
+#include <deque>
+#include <vector>
+
+#if defined(Q_OS_UNIX)
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+#if defined(Q_OS_LINUX)
+#include <sys/syscall.h>
+#endif
+
+namespace {
+
+// Crawls are mostly waiting on the filesystem, but past this the workers
+// only contend for the same directory inodes
+const int kMaxThreads = 16;
+
+#if defined(Q_OS_LINUX)
+// Layout the getdents64 syscall fills in
+struct LinuxDirent64 {
+  quint64 d_ino;
+  qint64 d_off;
+  unsigned short d_reclen;
+  unsigned char d_type;
+  char d_name[1];
+};
+
+const int kDirentBufferSize = 32 * 1024;
+#endif
+
+QByteArray childPath(const QByteArray &relativeDir, const QByteArray &name) {
+  return relativeDir.isEmpty() ? name : relativeDir + '/' + name;
+}
+
+QByteArray parentOf(const QByteArray &relativeDir) {
+  int slash = relativeDir.lastIndexOf('/');
+  return slash < 0 ? QByteArray() : relativeDir.left(slash);
+}
+
+bool hasGlobChars(const QByteArray &text) {
+  for (char c : text) {
+    if (c == '*' || c == '?' || c == '[' || c == '\\') {
+      return true;
+    }
+  }
+  return false;
+}
+
+// ==================== DirReader ====================
+
+// One directory's entries, with the type taken from the directory entry
+// itself wherever the platform provides it
+class DirReader {
+public:
+  explicit DirReader(const QByteArray &path);
+  ~DirReader();
+
+  bool isOpen() const;
+  // Directory mtime in ms since the epoch, as QFileInfo reports it
+  qint64 modified() const;
+  // Next entry other than "." and ".."; false at the end
+  bool next(QByteArray &name, bool &isDir);
+
+private:
+  Q_DISABLE_COPY(DirReader)
+
+#if defined(Q_OS_LINUX)
+  int fd_;
+  int used_;
+  int pos_;
+  alignas(8) char buffer_[kDirentBufferSize];
+#elif defined(Q_OS_UNIX)
+  DIR *dir_;
+  QByteArray path_;
+#else
+  QFileInfoList entries_;
+  int pos_;
+  QString path_;
+#endif
+};
+
+#if defined(Q_OS_LINUX)
+
+DirReader::DirReader(const QByteArray &path) : used_(0), pos_(0) {
+  fd_ = ::openat(AT_FDCWD, path.constData(),
+                 O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+}
+
+DirReader::~DirReader() {
+  if (fd_ >= 0) {
+    ::close(fd_);
+  }
+}
+
+bool DirReader::isOpen() const { return fd_ >= 0; }
+
+qint64 DirReader::modified() const {
+  struct stat st;
+  if (::fstat(fd_, &st) != 0) {
+    return -1;
+  }
+  return qint64(st.st_mtim.tv_sec) * 1000 + st.st_mtim.tv_nsec / 1000000;
+}
+
+bool DirReader::next(QByteArray &name, bool &isDir) {
+  for (;;) {
+    if (pos_ >= used_) {
+      long n = ::syscall(SYS_getdents64, fd_, buffer_, sizeof(buffer_));
+      if (n <= 0) {
+        return false;
+      }
+      used_ = int(n);
+      pos_ = 0;
+    }
+
+    const LinuxDirent64 *entry =
+        reinterpret_cast<const LinuxDirent64 *>(buffer_ + pos_);
+    pos_ += entry->d_reclen;
+
+    const char *entryName = entry->d_name;
+    if (entryName[0] == '.' &&
+        (entryName[1] == '\0' ||
+         (entryName[1] == '.' && entryName[2] == '\0'))) {
+      continue;
+    }
+
+    unsigned char type = entry->d_type;
+    if (type == DT_UNKNOWN) {
+      // Some filesystems (older XFS, some network mounts) leave the type
+      // out; only then is the entry stat()ed
+      struct stat st;
+      if (::fstatat(fd_, entryName, &st, AT_SYMLINK_NOFOLLOW) != 0) {
+        continue;
+      }
+      type = S_ISDIR(st.st_mode) ? DT_DIR : DT_REG;
+    }
+    name = QByteArray(entryName);
+    // Symlinks are listed but never followed
+    isDir = type == DT_DIR;
+    return true;
+  }
+}
+
+#elif defined(Q_OS_UNIX)
+
+DirReader::DirReader(const QByteArray &path)
+    : dir_(::opendir(path.constData())), path_(path) {}
+
+DirReader::~DirReader() {
+  if (dir_) {
+    ::closedir(dir_);
+  }
+}
+
+bool DirReader::isOpen() const { return dir_ != nullptr; }
+
+qint64 DirReader::modified() const {
+  return QFileInfo(QFile::decodeName(path_))
+      .lastModified()
+      .toMSecsSinceEpoch();
+}
+
+bool DirReader::next(QByteArray &name, bool &isDir) {
+  while (struct dirent *entry = ::readdir(dir_)) {
+    const char *entryName = entry->d_name;
+    if (entryName[0] == '.' &&
+        (entryName[1] == '\0' ||
+         (entryName[1] == '.' && entryName[2] == '\0'))) {
+      continue;
+    }
+
+    unsigned char type = entry->d_type;
+    if (type == DT_UNKNOWN) {
+      struct stat st;
+      if (::fstatat(::dirfd(dir_), entryName, &st, AT_SYMLINK_NOFOLLOW) !=
+          0) {
+        continue;
+      }
+      type = S_ISDIR(st.st_mode) ? DT_DIR : DT_REG;
+    }
+    name = QByteArray(entryName);
+    isDir = type == DT_DIR;
+    return true;
+  }
+  return false;
+}
+
+#else
+
+DirReader::DirReader(const QByteArray &path)
+    : pos_(0), path_(QFile::decodeName(path)) {
+  QDir dir(path_);
+  if (dir.exists()) {
+    entries_ = dir.entryInfoList(QDir::Dirs | QDir::Files | QDir::Hidden |
+                                 QDir::System | QDir::NoDotAndDotDot |
+                                 QDir::NoSymLinks);
+  } else {
+    pos_ = -1;
+  }
+}
+
+DirReader::~DirReader() {}
+
+bool DirReader::isOpen() const { return pos_ >= 0; }
+
+qint64 DirReader::modified() const {
+  return QFileInfo(path_).lastModified().toMSecsSinceEpoch();
+}
+
+bool DirReader::next(QByteArray &name, bool &isDir) {
+  if (pos_ < 0 || pos_ >= entries_.size()) {
+    return false;
+  }
+  const QFileInfo &info = entries_.at(pos_++);
+  name = QFile::encodeName(info.fileName());
+  isDir = info.isDir();
+  return true;
+}
+
+#endif
+
+// ==================== Crawl ====================
+
+struct CrawlTask {
+  QByteArray dir;
+  // Rules in effect for dir's parent; resolved from the root if null
+  std::shared_ptr<const IgnoreRules> rules;
+  bool validate = false; // Skip the listing if the mtime is unchanged
+};
+
+struct WorkQueue {
+  QMutex mutex;
+  std::deque<CrawlTask> tasks;
+};
+
+class Crawl {
+public:
+  Crawl(const QByteArray &root, const QHash<QString, qint64> &known,
+        bool force, int threads);
+
+  void seed(const QStringList &dirs);
+  void work(int worker);
+  WorkspaceScan takeResult();
+
+private:
+  bool take(int worker, CrawlTask &task);
+  void push(int worker, CrawlTask task);
+  void process(int worker, const CrawlTask &task);
+  std::shared_ptr<const IgnoreRules> rulesFor(const QByteArray &relativeDir);
+  QByteArray absolutePath(const QByteArray &relativeDir) const;
+
+  QByteArray root_;
+  const QHash<QString, qint64> &known_;
+  bool force_;
+
+  std::vector<WorkQueue> queues_;
+  // Tasks queued or running; the crawl is done when it drops to zero
+  std::atomic<int> pending_;
+  // Tasks waiting in a queue; idle workers sleep while it is zero
+  std::atomic<int> queued_;
+  QMutex idleMutex_;
+  QWaitCondition idle_;
+
+  // Per worker, so listing never takes a shared lock
+  std::vector<WorkspaceScan> results_;
+
+  // .git/info/exclude, below every .gitignore
+  std::shared_ptr<const IgnoreRules> baseRules_;
+  QMutex rulesMutex_;
+  QHash<QByteArray, std::shared_ptr<const IgnoreRules>> rules_;
+};
+
+Crawl::Crawl(const QByteArray &root, const QHash<QString, qint64> &known,
+             bool force, int threads)
+    : root_(root), known_(known), force_(force), queues_(threads),
+      pending_(0), queued_(0), results_(threads) {
+  // Applies from the root, like a .gitignore there
+  baseRules_ =
+      IgnoreRules::fromFile(nullptr, root_ + "/.git/info/exclude", QByteArray());
+}
+
+void Crawl::seed(const QStringList &dirs) {
+  int worker = 0;
+  for (const QString &dir : dirs) {
+    CrawlTask task;
+    task.dir = QFile::encodeName(dir);
+    task.validate = !force_;
+    push(worker, std::move(task));
+    worker = (worker + 1) % int(queues_.size());
+  }
+}
+
+void Crawl::work(int worker) {
+  CrawlTask task;
+  while (pending_.load() > 0) {
+    if (!take(worker, task)) {
+      // Others are still listing and may push more; push() and the last
+      // task to finish wake us under idleMutex_, so no wakeup is lost
+      QMutexLocker locker(&idleMutex_);
+      while (queued_.load() == 0 && pending_.load() > 0) {
+        idle_.wait(&idleMutex_);
+      }
+      continue;
+    }
+    process(worker, task);
+    if (--pending_ == 0) {
+      QMutexLocker locker(&idleMutex_);
+      idle_.wakeAll();
+    }
+  }
+}
+
+WorkspaceScan Crawl::takeResult() {
+  WorkspaceScan scan;
+  for (WorkspaceScan &result : results_) {
+    for (auto it = result.listed.cbegin(); it != result.listed.cend(); ++it) {
+      scan.listed.insert(it.key(), it.value());
+    }
+    scan.removed += result.removed;
+  }
+  return scan;
+}
+
+bool Crawl::take(int worker, CrawlTask &task) {
+  // Own queue from the back: depth first, so the directory just listed is
+  // still warm in the dentry cache
+  {
+    WorkQueue &own = queues_[worker];
+    QMutexLocker locker(&own.mutex);
+    if (!own.tasks.empty()) {
+      task = std::move(own.tasks.back());
+      own.tasks.pop_back();
+      --queued_;
+      return true;
+    }
+  }
+
+  // Steal the oldest (shallowest, so largest) work from another worker
+  int count = int(queues_.size());
+  for (int i = 1; i < count; ++i) {
+    WorkQueue &victim = queues_[(worker + i) % count];
+    QMutexLocker locker(&victim.mutex);
+    if (!victim.tasks.empty()) {
+      task = std::move(victim.tasks.front());
+      victim.tasks.pop_front();
+      --queued_;
+      return true;
+    }
+  }
+  return false;
+}
+
+void Crawl::push(int worker, CrawlTask task) {
+  ++pending_;
+  {
+    WorkQueue &queue = queues_[worker];
+    QMutexLocker locker(&queue.mutex);
+    queue.tasks.push_back(std::move(task));
+    ++queued_;
+  }
+  QMutexLocker locker(&idleMutex_);
+  idle_.wakeOne();
+}
+
+void Crawl::process(int worker, const CrawlTask &task) {
+  WorkspaceScan &result = results_[worker];
+  QString dirKey = QFile::decodeName(task.dir);
+  QByteArray path = absolutePath(task.dir);
+
+  DirReader reader(path);
+  if (!reader.isOpen()) {
+    result.removed.append(dirKey);
+    return;
+  }
+
+  IndexedDir entry;
+  entry.modified = reader.modified();
+  if (task.validate && known_.value(dirKey, -1) == entry.modified) {
+    return;
+  }
+
+  struct Child {
+    QByteArray name;
+    bool isDir;
+  };
+  std::vector<Child> children;
+  bool hasGitignore = false;
+  bool hasIgnore = false;
+
+  QByteArray name;
+  bool isDir = false;
+  while (reader.next(name, isDir)) {
+    if (name.startsWith('.')) {
+      hasGitignore = hasGitignore || (!isDir && name == ".gitignore");
+      hasIgnore = hasIgnore || (!isDir && name == ".ignore");
+      continue;
+    }
+    children.push_back({name, isDir});
+  }
+
+  std::shared_ptr<const IgnoreRules> parentRules;
+  if (task.dir.isEmpty()) {
+    parentRules = baseRules_;
+  } else if (task.rules) {
+    parentRules = task.rules;
+  } else {
+    parentRules = rulesFor(parentOf(task.dir));
+  }
+  std::shared_ptr<const IgnoreRules> rules = IgnoreRules::load(
+      parentRules, path, task.dir, hasGitignore, hasIgnore);
+  {
+    QMutexLocker locker(&rulesMutex_);
+    rules_.insert(task.dir, rules);
+  }
+
+  for (const Child &child : children) {
+    QByteArray relative = childPath(task.dir, child.name);
+    if (rules && rules->isIgnored(relative, child.name, child.isDir)) {
+      continue;
+    }
+    if (!child.isDir) {
+      entry.files.append(QFile::decodeName(child.name));
+      continue;
+    }
+
+    entry.subdirs.append(QFile::decodeName(child.name));
+    // Subdirectories we knew about are only relisted if they changed
+    if (!known_.contains(QFile::decodeName(relative))) {
+      CrawlTask subtask;
+      subtask.dir = relative;
+      subtask.rules = rules;
+      push(worker, std::move(subtask));
+    }
+  }
+
+  result.listed.insert(dirKey, entry);
+}
+
+std::shared_ptr<const IgnoreRules>
+Crawl::rulesFor(const QByteArray &relativeDir) {
+  {
+    QMutexLocker locker(&rulesMutex_);
+    auto it = rules_.constFind(relativeDir);
+    if (it != rules_.constEnd()) {
+      return it.value();
+    }
+  }
+
+  // Validated directories arrive without their ancestors' rules; those
+  // are loaded once and shared by every task below them
+  std::shared_ptr<const IgnoreRules> parent =
+      relativeDir.isEmpty() ? baseRules_ : rulesFor(parentOf(relativeDir));
+  std::shared_ptr<const IgnoreRules> rules =
+      IgnoreRules::load(parent, absolutePath(relativeDir), relativeDir);
+
+  QMutexLocker locker(&rulesMutex_);
+  rules_.insert(relativeDir, rules);
+  return rules;
+}
+
+QByteArray Crawl::absolutePath(const QByteArray &relativeDir) const {
+  return relativeDir.isEmpty() ? root_ : root_ + '/' + relativeDir;
+}
+
+} // namespace
+
+// ==================== IgnoreRules ====================
+
+std::shared_ptr<const IgnoreRules>
+IgnoreRules::load(const std::shared_ptr<const IgnoreRules> &parent,
+                  const QByteArray &absoluteDir,
+                  const QByteArray &relativeDir, bool hasGitignore,
+                  bool hasIgnore) {
+  // .ignore comes last so its patterns override .gitignore's
+  QVector<QByteArray> files;
+  if (hasGitignore) {
+    files.append(absoluteDir + "/.gitignore");
+  }
+  if (hasIgnore) {
+    files.append(absoluteDir + "/.ignore");
+  }
+  return compile(parent, relativeDir, files);
+}
+
+std::shared_ptr<const IgnoreRules>
+IgnoreRules::fromFile(const std::shared_ptr<const IgnoreRules> &parent,
+                      const QByteArray &filePath,
+                      const QByteArray &relativeDir) {
+  return compile(parent, relativeDir, QVector<QByteArray>{filePath});
+}
+
+std::shared_ptr<const IgnoreRules>
+IgnoreRules::compile(const std::shared_ptr<const IgnoreRules> &parent,
+                     const QByteArray &relativeDir,
+                     const QVector<QByteArray> &filePaths) {
+  std::shared_ptr<IgnoreRules> rules = std::make_shared<IgnoreRules>();
+  rules->parent_ = parent;
+  rules->base_ = relativeDir.isEmpty() ? QByteArray() : relativeDir + '/';
+
+  for (const QByteArray &filePath : filePaths) {
+    QFile file(QFile::decodeName(filePath));
+    if (!file.open(QIODevice::ReadOnly)) {
+      continue;
+    }
+    for (const QByteArray &line : file.readAll().split('\n')) {
+      rules->addLine(line);
+    }
+  }
+
+  if (rules->patterns_.isEmpty()) {
+    return parent;
+  }
+
+  // Without negations the order of patterns does not matter, so the
+  // common shapes can be answered by hash lookups
+  for (const Pattern &pattern : rules->patterns_) {
+    if (pattern.negated) {
+      rules->ordered_ = true;
+      break;
+    }
+  }
+  if (!rules->ordered_) {
+    for (const Pattern &pattern : rules->patterns_) {
+      const QByteArray &glob = pattern.glob;
+      if (!pattern.anchored && !hasGlobChars(glob)) {
+        (pattern.dirOnly ? rules->dirNames_ : rules->names_).insert(glob);
+      } else if (!pattern.anchored && !pattern.dirOnly &&
+                 glob.startsWith('*') && !hasGlobChars(glob.mid(1))) {
+        rules->suffixes_.append(glob.mid(1));
+      } else {
+        rules->globs_.append(pattern);
+      }
+    }
+  }
+  return rules;
+}
+
+bool IgnoreRules::addLine(QByteArray line) {
+  if (line.endsWith('\r')) {
+    line.chop(1);
+  }
+  // Trailing spaces are dropped unless escaped
+  while (line.endsWith(' ') && !line.endsWith("\\ ")) {
+    line.chop(1);
+  }
+  if (line.isEmpty() || line.startsWith('#')) {
+    return false;
+  }
+
+  Pattern pattern;
+  if (line.startsWith('!')) {
+    pattern.negated = true;
+    line.remove(0, 1);
+  }
+  if (line.endsWith('/')) {
+    pattern.dirOnly = true;
+    line.chop(1);
+  }
+  // A slash anywhere but the end ties the pattern to this directory
+  if (line.contains('/')) {
+    pattern.anchored = true;
+    if (line.startsWith('/')) {
+      line.remove(0, 1);
+    }
+  }
+  if (line.isEmpty()) {
+    return false;
+  }
+
+  pattern.glob = line;
+  patterns_.append(pattern);
+  return true;
+}
+
+bool IgnoreRules::isIgnored(const QByteArray &relativePath,
+                            const QByteArray &name, bool isDir) const {
+  for (const IgnoreRules *rules = this; rules; rules = rules->parent_.get()) {
+    int match = rules->matchLocal(relativePath, name, isDir);
+    if (match >= 0) {
+      return match == 1;
+    }
+  }
+  return false;
+}
+
+int IgnoreRules::matchLocal(const QByteArray &relativePath,
+                            const QByteArray &name, bool isDir) const {
+  if (ordered_) {
+    for (int i = patterns_.size() - 1; i >= 0; --i) {
+      const Pattern &pattern = patterns_.at(i);
+      if (matches(pattern, relativePath, name, isDir)) {
+        return pattern.negated ? 0 : 1;
+      }
+    }
+    return -1;
+  }
+
+  if (names_.contains(name) || (isDir && dirNames_.contains(name))) {
+    return 1;
+  }
+  for (const QByteArray &suffix : suffixes_) {
+    if (name.endsWith(suffix)) {
+      return 1;
+    }
+  }
+  for (const Pattern &pattern : globs_) {
+    if (matches(pattern, relativePath, name, isDir)) {
+      return 1;
+    }
+  }
+  return -1;
+}
+
+bool IgnoreRules::matches(const Pattern &pattern,
+                          const QByteArray &relativePath,
+                          const QByteArray &name, bool isDir) const {
+  if (pattern.dirOnly && !isDir) {
+    return false;
+  }
+  const QByteArray &glob = pattern.glob;
+  if (!pattern.anchored) {
+    return globMatch(glob.constData(), glob.constData() + glob.size(),
+                     name.constData(), name.constData() + name.size());
+  }
+  // Anchored patterns see the path below the directory they came from
+  const char *text = relativePath.constData() + base_.size();
+  return globMatch(glob.constData(), glob.constData() + glob.size(), text,
+                   relativePath.constData() + relativePath.size());
+}
+
+bool IgnoreRules::globMatch(const char *pattern, const char *patternEnd,
+                            const char *text, const char *textEnd) {
+  while (pattern < patternEnd) {
+    char c = *pattern;
+
+    if (c == '*') {
+      if (pattern + 1 < patternEnd && pattern[1] == '*') {
+        // "**" matches across directories; "**/" also matches none
+        pattern += 2;
+        bool slash = pattern < patternEnd && *pattern == '/';
+        if (slash) {
+          ++pattern;
+        }
+        for (const char *t = text;; ++t) {
+          if ((!slash || t == text || t[-1] == '/') &&
+              globMatch(pattern, patternEnd, t, textEnd)) {
+            return true;
+          }
+          if (t == textEnd) {
+            return false;
+          }
+        }
+      }
+      ++pattern;
+      for (const char *t = text;; ++t) {
+        if (globMatch(pattern, patternEnd, t, textEnd)) {
+          return true;
+        }
+        if (t == textEnd || *t == '/') {
+          return false;
+        }
+      }
+    }
+
+    if (text == textEnd) {
+      return false;
+    }
+
+    if (c == '?') {
+      if (*text == '/') {
+        return false;
+      }
+    } else if (c == '[') {
+      const char *p = pattern + 1;
+      bool negate = p < patternEnd && (*p == '!' || *p == '^');
+      if (negate) {
+        ++p;
+      }
+      bool matched = false;
+      bool first = true;
+      while (p < patternEnd && (first || *p != ']')) {
+        first = false;
+        char low = *p;
+        if (low == '\\' && p + 1 < patternEnd) {
+          low = *++p;
+        }
+        char high = low;
+        if (p + 2 < patternEnd && p[1] == '-' && p[2] != ']') {
+          high = p[2];
+          p += 2;
+        }
+        if (*text >= low && *text <= high) {
+          matched = true;
+        }
+        ++p;
+      }
+      if (p >= patternEnd) {
+        // Unterminated class: match '[' literally
+        if (*text != '[') {
+          return false;
+        }
+      } else {
+        if (matched == negate || *text == '/') {
+          return false;
+        }
+        pattern = p;
+      }
+    } else {
+      if (c == '\\' && pattern + 1 < patternEnd) {
+        c = *++pattern;
+      }
+      if (c != *text) {
+        return false;
+      }
+    }
+    ++pattern;
+    ++text;
+  }
+  return text == textEnd;
+}
+
+// ==================== DirCrawler ====================
+
+DirCrawler::DirCrawler(const QString &rootPath)
+    : root_(QFile::encodeName(QDir(rootPath).absolutePath())) {}
+
+int DirCrawler::threadCount() {
+  return qBound(1, QThread::idealThreadCount(), kMaxThreads);
+}
+
+WorkspaceScan DirCrawler::crawl(const QStringList &dirs,
+                                const QHash<QString, qint64> &known,
+                                bool force) {
+  int threads = threadCount();
+  Crawl crawl(root_, known, force, threads);
+  crawl.seed(dirs);
+
+  BackgroundJob::runParallel(threads, [&crawl](int i) { crawl.work(i); });
+
+  return crawl.takeResult();
+}
@@ -0,0 +1,83 @@
+#include "documentmodel.h"
+#include <QTextDocument>
+
+DocumentModel::DocumentModel(QTextDocument *document)
+    : QObject(document), document_(document), revision_(-1),
+      appliedRevision_(-1), htmlValid_(false), highlightsValid_(false),
+      analysisValid_(false) {}
+
+DocumentModel *DocumentModel::of(QTextDocument *document) {
+  DocumentModel *model = document->findChild<DocumentModel *>(
+      QString(), Qt::FindDirectChildrenOnly);
+  if (!model) {
+    model = new DocumentModel(document);
+  }
+  return model;
+}
+
+bool DocumentModel::isCurrent() const {
+  return ast_ && revision_ == document_->revision();
+}
+
+bool DocumentModel::refresh(CyberMD::Parser &parser) {
+  if (isCurrent()) {
+    return false;
+  }
+
+  CAST *ast = parser.parse(document_->toPlainText().toStdString());
+  ast_.reset(ast ? new CyberMD::AST(ast) : nullptr);
+  revision_ = document_->revision();
+
+  htmlValid_ = false;
+  highlightsValid_ = false;
+  analysisValid_ = false;
+  html_.clear();
+  highlights_.clear();
+  outline_.clear();
+  foldableRegions_.clear();
+  return true;
+}
+
+const QString &DocumentModel::previewHtml() {
+  if (!htmlValid_ && ast_) {
+    html_ = QString::fromStdString(ast_->toHtml());
+    htmlValid_ = true;
+  }
+  return html_;
+}
+
+const std::vector<CyberMD::HighlightRange> &
+DocumentModel::highlights(CyberMD::Highlighter &highlighter) {
+  if (!highlightsValid_ && ast_) {
+    highlights_ = highlighter.highlight(ast_->get());
+    highlightsValid_ = true;
+  }
+  return highlights_;
+}
+
+void DocumentModel::analyze() {
+  if (analysisValid_ || !ast_) {
+    return;
+  }
+  CyberMD::Analyzer analyzer(ast_->get());
+  analyzer.analyze();
+  outline_ = analyzer.get_outline();
+  foldableRegions_ = analyzer.get_foldable_regions();
+  analysisValid_ = true;
+}
+
+const std::vector<CyberMD::OutlineItem> &DocumentModel::outline() {
+  analyze();
+  return outline_;
+}
+
+const std::vector<CyberMD::FoldableRegion> &DocumentModel::foldableRegions() {
+  analyze();
+  return foldableRegions_;
+}
+
+void DocumentModel::markHighlightsApplied() { appliedRevision_ = revision_; }
+
+bool DocumentModel::highlightsApplied() const {
+  return appliedRevision_ == document_->revision();
+}
@@ -0,0 +1,315 @@
+#include "editjournal.h"
+#include "fileloader.h"
+#include <QDataStream>
+#include <QDateTime>
+#include <QDebug>
+#include <QDir>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <QTextCursor>
+#include <QTextDocument>
+#include <QTimer>
+#include <QUuid>
+
+namespace {
+
+const quint32 kJournalMagic = 0x434D444A; // "CMDJ"
+const quint16 kJournalVersion = 1;
+
+// Appends are batched; a crash loses at most this much typing
+const int kFlushIntervalMs = 1000;
+
+// Compact once the journal is this large and larger than the document
+const qint64 kCompactBytes = 4 * 1024 * 1024;
+
+QDataStream &configure(QDataStream &stream) {
+  stream.setVersion(QDataStream::Qt_5_15);
+  return stream;
+}
+
+} // namespace
+
+EditJournal::EditJournal(QTextDocument *document)
+    : QObject(document), document_(document), flushTimer_(new QTimer(this)),
+      lastRevision_(document->revision()), journalBytes_(0),
+      modified_(document->isModified()), suspended_(false) {
+  flushTimer_->setSingleShot(true);
+  flushTimer_->setInterval(kFlushIntervalMs);
+  connect(flushTimer_, &QTimer::timeout, this, &EditJournal::flush);
+
+  connect(document_, &QTextDocument::contentsChange, this,
+          &EditJournal::onContentsChange);
+  // Cached because the document is already half destroyed when our
+  // destructor runs
+  connect(document_, &QTextDocument::modificationChanged, this,
+          [this](bool modified) { modified_ = modified; });
+}
+
+EditJournal::~EditJournal() {
+  // As the document's child this runs after ~QTextDocument, so nothing
+  // here may touch document_: recorded edits are appended, never compacted
+  flushTimer_->stop();
+  if (modified_) {
+    // Keep the journal: unsaved edits survive an unclean or forced exit
+    appendPending();
+    file_.close();
+  } else {
+    removeJournalFile();
+  }
+}
+
+QString EditJournal::journalDirectory() {
+  return QStandardPaths::writableLocation(
+             QStandardPaths::AppLocalDataLocation) +
+         "/journal";
+}
+
+void EditJournal::rebase(const QString &filePath) {
+  discard();
+  filePath_ = filePath;
+  suspended_ = false;
+}
+
+void EditJournal::suspend() {
+  discard();
+  suspended_ = true;
+}
+
+void EditJournal::discard() {
+  removeJournalFile();
+  lastRevision_ = document_->revision();
+}
+
+void EditJournal::removeJournalFile() {
+  flushTimer_->stop();
+  pending_.clear();
+  file_.close();
+  if (!journalPath_.isEmpty()) {
+    QFile::remove(journalPath_);
+    journalPath_.clear();
+  }
+  lock_.reset();
+  journalBytes_ = 0;
+}
+
+void EditJournal::onContentsChange(int position, int charsRemoved,
+                                   int charsAdded) {
+  // Highlighters re-emit contentsChange for format-only updates; those
+  // leave the revision untouched
+  int revision = document_->revision();
+  if (revision == lastRevision_ || suspended_) {
+    return;
+  }
+  lastRevision_ = revision;
+
+  QString inserted;
+  if (charsAdded > 0) {
+    QTextCursor cursor(document_);
+    cursor.setPosition(position);
+    cursor.setPosition(
+        qMin(position + charsAdded, document_->characterCount() - 1),
+        QTextCursor::KeepAnchor);
+    inserted = cursor.selectedText();
+    inserted.replace(QChar::ParagraphSeparator, QLatin1Char('\n'));
+  }
+
+  QDataStream out(&pending_, QIODevice::WriteOnly | QIODevice::Append);
+  configure(out) << quint8(EditRecord) << qint32(position)
+                 << qint32(charsRemoved) << inserted;
+
+  if (!flushTimer_->isActive()) {
+    flushTimer_->start();
+  }
+}
+
+bool EditJournal::ensureOpen() {
+  if (file_.isOpen()) {
+    return true;
+  }
+
+  QDir().mkpath(journalDirectory());
+  journalPath_ = journalDirectory() + "/" +
+                 QUuid::createUuid().toString(QUuid::WithoutBraces) +
+                 ".journal";
+
+  // The lock tells other instances this journal is still live
+  lock_.reset(new QLockFile(journalPath_ + ".lock"));
+  lock_->tryLock(0);
+
+  file_.setFileName(journalPath_);
+  if (!file_.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+    qWarning() << "Cannot create edit journal" << journalPath_
+               << file_.errorString();
+    return false;
+  }
+  QByteArray bytes = header();
+  file_.write(bytes);
+  journalBytes_ = bytes.size();
+  return true;
+}
+
+QByteArray EditJournal::header() const {
+  QFileInfo info(filePath_);
+  bool exists = !filePath_.isEmpty() && info.exists();
+
+  QByteArray bytes;
+  QDataStream out(&bytes, QIODevice::WriteOnly);
+  configure(out) << kJournalMagic << kJournalVersion << filePath_
+                 << qint64(exists ? info.size() : -1)
+                 << qint64(exists ? info.lastModified().toMSecsSinceEpoch()
+                                  : 0);
+  return bytes;
+}
+
+QByteArray EditJournal::snapshotRecord() const {
+  QByteArray bytes;
+  QDataStream out(&bytes, QIODevice::WriteOnly);
+  configure(out) << quint8(SnapshotRecord) << document_->toPlainText();
+  return bytes;
+}
+
+bool EditJournal::appendPending() {
+  if (pending_.isEmpty() || !ensureOpen()) {
+    return false;
+  }
+
+  file_.write(pending_);
+  file_.flush();
+  journalBytes_ += pending_.size();
+  pending_.clear();
+  return true;
+}
+
+void EditJournal::flush() {
+  if (!appendPending()) {
+    return;
+  }
+
+  // UTF-16 snapshot size is the break-even point for compaction
+  qint64 documentBytes = qint64(document_->characterCount()) * 2;
+  if (journalBytes_ > kCompactBytes && journalBytes_ > 2 * documentBytes) {
+    compact();
+  }
+}
+
+void EditJournal::writeSnapshot() {
+  pending_.clear();
+  if (!suspended_ && ensureOpen()) {
+    compact();
+  }
+}
+
+// Replace the journal with header + one snapshot. QSaveFile keeps the old
+// journal intact until the new one is complete.
+void EditJournal::compact() {
+  file_.close();
+
+  QSaveFile out(journalPath_);
+  if (out.open(QIODevice::WriteOnly)) {
+    out.write(header());
+    out.write(snapshotRecord());
+    out.commit();
+  }
+
+  file_.setFileName(journalPath_);
+  file_.open(QIODevice::WriteOnly | QIODevice::Append);
+  journalBytes_ = file_.size();
+}
+
+QStringList EditJournal::orphanedJournals() {
+  QStringList result;
+  QDir dir(journalDirectory());
+  const QStringList names =
+      dir.entryList(QStringList() << "*.journal", QDir::Files, QDir::Time);
+  for (const QString &name : names) {
+    QString path = dir.filePath(name);
+
+    // A live owner holds the lock; stale locks of dead processes are
+    // broken by tryLock()
+    QLockFile lock(path + ".lock");
+    if (lock.tryLock(0)) {
+      result.append(path);
+      lock.unlock();
+    }
+  }
+  return result;
+}
+
+bool EditJournal::replay(const QString &journalPath, QString *filePath,
+                         QString *text, QString *error) {
+  QFile file(journalPath);
+  if (!file.open(QIODevice::ReadOnly)) {
+    if (error) {
+      *error = file.errorString();
+    }
+    return false;
+  }
+
+  QDataStream in(&file);
+  configure(in);
+  quint32 magic;
+  quint16 version;
+  QString path;
+  qint64 baseSize;
+  qint64 baseModified;
+  in >> magic >> version >> path >> baseSize >> baseModified;
+  if (in.status() != QDataStream::Ok || magic != kJournalMagic ||
+      version != kJournalVersion) {
+    if (error) {
+      *error = "Not a CyberMD edit journal";
+    }
+    return false;
+  }
+
+  // Start from the saved file the journal was recorded against
+  QString result;
+  bool baseChanged = false;
+  if (!path.isEmpty()) {
+    QFile base(path);
+    if (base.open(QIODevice::ReadOnly)) {
+      QByteArray bytes = base.readAll();
+      result = FileLoader::decodeUtf8(bytes.constData(), bytes.size()).text;
+    }
+    QFileInfo info(path);
+    baseChanged = !info.exists() || info.size() != baseSize ||
+                  info.lastModified().toMSecsSinceEpoch() != baseModified;
+  }
+
+  bool snapshotSeen = false;
+  while (!in.atEnd()) {
+    quint8 kind;
+    in >> kind;
+    if (kind == EditRecord) {
+      qint32 position;
+      qint32 removed;
+      QString inserted;
+      in >> position >> removed >> inserted;
+      if (in.status() != QDataStream::Ok) {
+        break; // Torn tail from the crash
+      }
+      position = qBound(0, position, int(result.size()));
+      removed = qBound(0, removed, int(result.size()) - position);
+      result.replace(position, removed, inserted);
+    } else if (kind == SnapshotRecord) {
+      QString snapshot;
+      in >> snapshot;
+      if (in.status() != QDataStream::Ok) {
+        break;
+      }
+      result = snapshot;
+      snapshotSeen = true;
+    } else {
+      break;
+    }
+  }
+
+  if (baseChanged && !snapshotSeen) {
+    qWarning() << "Edit journal replayed against a file changed on disk:"
+               << path;
+  }
+
+  *filePath = path;
+  *text = result;
+  return true;
+}
@@ -0,0 +1,349 @@
+#include "fileloader.h"
+#include "gzipdevice.h"
+#include <QFile>
+#include <QFileInfo>
+#include <QThreadPool>
+#include <QtAlgorithms>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define CYBERMD_HAVE_SSE2 1
+#endif
+
+namespace {
+
+// Line terminators seen so far
+struct LineEndingCounts {
+  qint64 lf = 0;
+  qint64 crlf = 0;
+  qint64 cr = 0;
+};
+
+// Decodes one multi-byte sequence starting at p. Returns the number of
+// bytes consumed, or 0 if the sequence is malformed (overlong, surrogate,
+// out of range or truncated).
+int decodeSequence(const uchar *p, const uchar *end, char32_t &codePoint) {
+  uchar lead = p[0];
+  int length;
+  char32_t minimum;
+  if ((lead & 0xE0) == 0xC0) {
+    length = 2;
+    minimum = 0x80;
+    codePoint = lead & 0x1F;
+  } else if ((lead & 0xF0) == 0xE0) {
+    length = 3;
+    minimum = 0x800;
+    codePoint = lead & 0x0F;
+  } else if ((lead & 0xF8) == 0xF0) {
+    length = 4;
+    minimum = 0x10000;
+    codePoint = lead & 0x07;
+  } else {
+    return 0;
+  }
+
+  if (end - p < length) {
+    return 0;
+  }
+  for (int i = 1; i < length; ++i) {
+    if ((p[i] & 0xC0) != 0x80) {
+      return 0;
+    }
+    codePoint = (codePoint << 6) | (p[i] & 0x3F);
+  }
+
+  if (codePoint < minimum || codePoint > 0x10FFFF ||
+      (codePoint >= 0xD800 && codePoint <= 0xDFFF)) {
+    return 0;
+  }
+  return length;
+}
+
+// Decompressed text handed to the editor at a time
+const int kStreamChunkBytes = 1024 * 1024;
+
+LineEnding classify(const LineEndingCounts &counts) {
+  int kinds = (counts.lf > 0) + (counts.crlf > 0) + (counts.cr > 0);
+  if (kinds > 1) {
+    return LineEnding::Mixed;
+  }
+  if (counts.crlf > 0) {
+    return LineEnding::CRLF;
+  }
+  if (counts.cr > 0) {
+    return LineEnding::CR;
+  }
+  return LineEnding::LF;
+}
+
+} // namespace
+
+// ==================== DiskState ====================
+
+DiskState DiskState::read(const QString &filePath) {
+  DiskState state;
+  QFile file(filePath);
+  if (!file.open(QIODevice::ReadOnly)) {
+    return state;
+  }
+  state.size = file.size();
+  state.modified = QFileInfo(file).lastModified().toMSecsSinceEpoch();
+  qint64 tailSize = qMin<qint64>(state.size, kTailBytes);
+  if (tailSize > 0 && file.seek(state.size - tailSize)) {
+    state.tail = file.read(tailSize);
+  }
+  return state;
+}
+
+// ==================== FileLoader ====================
+
+FileLoader::FileLoader(QObject *parent) : QObject(parent) {
+  qRegisterMetaType<LoadedText>("LoadedText");
+}
+
+void FileLoader::load(const QString &filePath) {
+  FileLoadJob *job = new FileLoadJob(filePath);
+  connect(job, &FileLoadJob::chunkDecoded, this, &FileLoader::chunkLoaded,
+          Qt::QueuedConnection);
+  connect(
+      job, &FileLoadJob::finished, this,
+      [this](const QString &path, const LoadedText &text,
+             const QString &error) {
+        if (error.isEmpty()) {
+          emit fileLoaded(path, text);
+        } else {
+          emit loadFailed(path, error);
+        }
+      },
+      Qt::QueuedConnection);
+  QThreadPool::globalInstance()->start(job);
+}
+
+LoadedText FileLoader::decodeUtf8(const char *data, qint64 size) {
+  LoadedText result;
+  const uchar *p = reinterpret_cast<const uchar *>(data);
+  const uchar *end = p + size;
+
+  if (size >= 3 && p[0] == 0xEF && p[1] == 0xBB && p[2] == 0xBF) {
+    result.hasBom = true;
+    p += 3;
+  }
+
+  if (end - p > FileLoader::kMaxTextBytes) {
+    result.validUtf8 = false;
+    return result;
+  }
+
+  // UTF-16 never needs more code units than UTF-8 has bytes
+  QString text(int(end - p), Qt::Uninitialized);
+  ushort *out = reinterpret_cast<ushort *>(text.data());
+  ushort *const outBegin = out;
+  LineEndingCounts counts;
+
+  while (p < end) {
+    // Fast path: widen pure-ASCII blocks without line-ending work
+#ifdef CYBERMD_HAVE_SSE2
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i lf = _mm_set1_epi8('\n');
+    const __m128i cr = _mm_set1_epi8('\r');
+    while (end - p >= 16) {
+      __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+      if (_mm_movemask_epi8(chunk) != 0 ||
+          _mm_movemask_epi8(_mm_cmpeq_epi8(chunk, cr)) != 0) {
+        break;
+      }
+      counts.lf += qPopulationCount(
+          quint32(_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, lf))));
+      _mm_storeu_si128(reinterpret_cast<__m128i *>(out),
+                       _mm_unpacklo_epi8(chunk, zero));
+      _mm_storeu_si128(reinterpret_cast<__m128i *>(out + 8),
+                       _mm_unpackhi_epi8(chunk, zero));
+      p += 16;
+      out += 16;
+    }
+#else
+    while (end - p >= 8) {
+      quint64 word;
+      std::memcpy(&word, p, sizeof(word));
+      if (word & 0x8080808080808080ULL) {
+        break;
+      }
+      bool hasCr = false;
+      for (int i = 0; i < 8; ++i) {
+        hasCr |= p[i] == '\r';
+      }
+      if (hasCr) {
+        break;
+      }
+      for (int i = 0; i < 8; ++i) {
+        counts.lf += p[i] == '\n';
+        out[i] = p[i];
+      }
+      p += 8;
+      out += 8;
+    }
+#endif
+
+    // Slow path: decode the rest of the current block one sequence at a
+    // time, validating and normalizing line endings
+    const uchar *blockEnd = qMin(end, p + 16);
+    while (p < blockEnd) {
+      uchar c = *p;
+      if (c < 0x80) {
+        if (c == '\r') {
+          if (p + 1 < end && p[1] == '\n') {
+            ++counts.crlf;
+            ++p;
+          } else {
+            ++counts.cr;
+          }
+          *out++ = '\n';
+        } else {
+          counts.lf += c == '\n';
+          *out++ = c;
+        }
+        ++p;
+        continue;
+      }
+
+      char32_t codePoint;
+      int length = decodeSequence(p, end, codePoint);
+      if (length == 0) {
+        result.validUtf8 = false;
+        *out++ = 0xFFFD;
+        ++p;
+      } else if (codePoint >= 0x10000) {
+        *out++ = QChar::highSurrogate(codePoint);
+        *out++ = QChar::lowSurrogate(codePoint);
+        p += length;
+      } else {
+        *out++ = ushort(codePoint);
+        p += length;
+      }
+    }
+  }
+
+  text.resize(int(out - outBegin));
+  result.text = text;
+  result.lineEnding = classify(counts);
+  return result;
+}
+
+int FileLoader::completePrefix(const char *data, int size) {
+  int end = size;
+  if (end > 0 && data[end - 1] == '\r') {
+    --end;
+  }
+
+  int i = end;
+  int continuation = 0;
+  while (i > 0 && continuation < 3 && (uchar(data[i - 1]) & 0xC0) == 0x80) {
+    --i;
+    ++continuation;
+  }
+  if (i > 0) {
+    uchar lead = uchar(data[i - 1]);
+    int length = lead >= 0xF0 ? 4 : lead >= 0xE0 ? 3 : lead >= 0xC0 ? 2 : 1;
+    if (length > 1 && continuation + 1 < length) {
+      end = i - 1;
+    }
+  }
+  return end;
+}
+
+// ==================== FileLoadJob ====================
+
+FileLoadJob::FileLoadJob(const QString &filePath) : filePath_(filePath) {}
+
+void FileLoadJob::run() {
+  LoadedText text;
+  QString error;
+
+  QFile file(filePath_);
+  if (!file.open(QIODevice::ReadOnly)) {
+    error = file.errorString();
+  } else if (GzipDevice::isGzip(&file)) {
+    GzipDevice gzip(&file);
+    if (!gzip.open(QIODevice::ReadOnly)) {
+      error = gzip.errorString();
+    } else {
+      inflateText(&gzip, text);
+      if (gzip.hasError()) {
+        error = gzip.errorString();
+      }
+    }
+  } else if (file.size() > FileLoader::kMaxTextBytes) {
+    error = "The file is too large to load as text";
+  } else {
+    qint64 size = file.size();
+    qint64 tailSize = qMin<qint64>(size, DiskState::kTailBytes);
+    uchar *mapped = size > 0 ? file.map(0, size) : nullptr;
+    if (mapped) {
+      const char *data = reinterpret_cast<const char *>(mapped);
+      text = FileLoader::decodeUtf8(data, size);
+      text.disk.tail = QByteArray(data + size - tailSize, int(tailSize));
+      file.unmap(mapped);
+    } else {
+      // Empty, special or unmappable files
+      QByteArray bytes = file.readAll();
+      text = FileLoader::decodeUtf8(bytes.constData(), bytes.size());
+      text.disk.tail = bytes.right(DiskState::kTailBytes);
+      size = bytes.size();
+    }
+    // Kept so change detection can ignore events for this exact version
+    text.disk.size = size;
+    text.disk.modified = QFileInfo(file).lastModified().toMSecsSinceEpoch();
+  }
+
+  emit finished(filePath_, text, error);
+  deleteLater();
+}
+
+// Streams decoded text out in chunks. disk.size counts the decompressed
+// bytes; compressed files are never diffed against the disk.
+void FileLoadJob::inflateText(QIODevice *device, LoadedText &text) {
+  text.compressed = true;
+  text.disk.size = 0;
+
+  QByteArray pending;
+  bool first = true;
+  bool seenLineEnding = false;
+  while (!device->atEnd()) {
+    QByteArray bytes = device->read(kStreamChunkBytes);
+    if (bytes.isEmpty()) {
+      break;
+    }
+    text.disk.size += bytes.size();
+    pending += bytes;
+
+    // Keep a split UTF-8 sequence or CRLF for the next chunk
+    int complete = FileLoader::completePrefix(pending.constData(),
+                                              pending.size());
+    LoadedText chunk = FileLoader::decodeUtf8(pending.constData(), complete);
+    pending.remove(0, complete);
+
+    if (first) {
+      text.hasBom = chunk.hasBom;
+    }
+    text.validUtf8 &= chunk.validUtf8;
+    if (chunk.text.contains(QLatin1Char('\n'))) {
+      if (!seenLineEnding) {
+        text.lineEnding = chunk.lineEnding;
+        seenLineEnding = true;
+      } else if (chunk.lineEnding != text.lineEnding) {
+        text.lineEnding = LineEnding::Mixed;
+      }
+    }
+
+    emit chunkDecoded(filePath_, chunk.text, first);
+    first = false;
+  }
+
+  if (!pending.isEmpty() || first) {
+    LoadedText chunk = FileLoader::decodeUtf8(pending.constData(),
+                                              pending.size());
+    text.validUtf8 &= chunk.validUtf8;
+    emit chunkDecoded(filePath_, chunk.text, first);
+  }
+}
@@ -0,0 +1,190 @@
+#include "filesaver.h"
+#include <QFileInfo>
+#include <QMessageBox>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QPushButton>
+#include <QSaveFile>
+#include <QThreadPool>
+#include <atomic>
+#include <memory>
+
+namespace {
+
+// Per file: a lock held across each write, and the number of the newest
+// write that reached the disk
+struct WriteState {
+  QMutex mutex;
+  quint64 written = 0;
+};
+
+QMutex writeStatesMutex;
+QHash<QString, std::shared_ptr<WriteState>> writeStates;
+
+// Shared by every FileSaver, since two of them may write the same file
+std::atomic<quint64> nextSequence(0);
+
+std::shared_ptr<WriteState> writeStateFor(const QString &filePath) {
+  QMutexLocker locker(&writeStatesMutex);
+  std::shared_ptr<WriteState> &state = writeStates[filePath];
+  if (!state) {
+    state = std::make_shared<WriteState>();
+  }
+  return state;
+}
+
+} // namespace
+
+// ==================== FileSaver ====================
+
+FileSaver::FileSaver(QObject *parent) : QObject(parent) {}
+
+void FileSaver::save(const QString &filePath, const QString &text,
+                     LineEnding lineEnding, bool hasBom, int revision) {
+  Request request = {text, lineEnding, hasBom, revision};
+
+  // Never race two renames onto the same file: the newest snapshot waits
+  // for the running write and replaces any older queued one
+  if (inFlight_.contains(filePath)) {
+    queued_.insert(filePath, request);
+    return;
+  }
+  start(filePath, request);
+}
+
+bool FileSaver::isSaving(const QString &filePath) const {
+  return inFlight_.contains(filePath);
+}
+
+bool FileSaver::saveNow(const QString &filePath, const QString &text,
+                        LineEnding lineEnding, bool hasBom,
+                        QString *errorString) {
+  // This text is newer than anything queued; a write already running
+  // is ordered by its number
+  queued_.remove(filePath);
+  return FileSaveJob::write(filePath, ++nextSequence,
+                            encode(text, lineEnding, hasBom), errorString);
+}
+
+void FileSaver::start(const QString &filePath, const Request &request) {
+  inFlight_.insert(filePath);
+
+  FileSaveJob *job =
+      new FileSaveJob(filePath, request.text, request.lineEnding,
+                      request.hasBom, request.revision, ++nextSequence);
+  connect(job, &FileSaveJob::finished, this, &FileSaver::onJobFinished,
+          Qt::QueuedConnection);
+  QThreadPool::globalInstance()->start(job);
+}
+
+void FileSaver::onJobFinished(const QString &filePath, int revision,
+                              const QString &error) {
+  inFlight_.remove(filePath);
+
+  if (error.isEmpty()) {
+    emit saved(filePath, revision);
+  } else {
+    emit saveFailed(filePath, revision, error);
+  }
+
+  auto it = queued_.find(filePath);
+  if (it != queued_.end()) {
+    Request next = it.value();
+    queued_.erase(it);
+    start(filePath, next);
+  }
+}
+
+QByteArray FileSaver::encode(const QString &text, LineEnding lineEnding,
+                             bool hasBom) {
+  QByteArray bytes = text.toUtf8();
+
+  switch (lineEnding) {
+  case LineEnding::CRLF:
+    bytes.replace("\n", "\r\n");
+    break;
+  case LineEnding::CR:
+    bytes.replace('\n', '\r');
+    break;
+  default:
+    Q_ASSERT(lineEnding != LineEnding::Mixed);
+    break;
+  }
+
+  if (hasBom) {
+    bytes.prepend("\xEF\xBB\xBF");
+  }
+  return bytes;
+}
+
+bool FileSaver::resolveLineEnding(QWidget *parent, const QString &fileName,
+                                  LineEnding *lineEnding) {
+  if (*lineEnding != LineEnding::Mixed) {
+    return true;
+  }
+
+  QMessageBox box(QMessageBox::Question, "Mixed Line Endings",
+                  QString("%1 uses more than one line ending convention.\n"
+                          "Saving converts every line to one of them.")
+                      .arg(QFileInfo(fileName).fileName()),
+                  QMessageBox::Cancel, parent);
+  QPushButton *lf = box.addButton("Convert to LF", QMessageBox::AcceptRole);
+  QPushButton *crlf =
+      box.addButton("Convert to CRLF", QMessageBox::AcceptRole);
+  box.setDefaultButton(lf);
+  box.exec();
+
+  if (box.clickedButton() == lf) {
+    *lineEnding = LineEnding::LF;
+  } else if (box.clickedButton() == crlf) {
+    *lineEnding = LineEnding::CRLF;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+// ==================== FileSaveJob ====================
+
+FileSaveJob::FileSaveJob(const QString &filePath, const QString &text,
+                         LineEnding lineEnding, bool hasBom, int revision,
+                         quint64 sequence)
+    : filePath_(filePath), text_(text), lineEnding_(lineEnding),
+      hasBom_(hasBom), revision_(revision), sequence_(sequence) {}
+
+void FileSaveJob::run() {
+  QString error;
+  write(filePath_, sequence_, FileSaver::encode(text_, lineEnding_, hasBom_),
+        &error);
+
+  emit finished(filePath_, revision_, error);
+  deleteLater();
+}
+
+bool FileSaveJob::write(const QString &filePath, quint64 sequence,
+                        const QByteArray &bytes, QString *errorString) {
+  std::shared_ptr<WriteState> state = writeStateFor(filePath);
+  QMutexLocker locker(&state->mutex);
+  if (sequence < state->written) {
+    return true; // A newer snapshot is already on disk
+  }
+
+  // QSaveFile writes to a temporary file and only replaces the target on
+  // commit(), after flushing it to disk
+  QSaveFile file(filePath);
+  if (!file.open(QIODevice::WriteOnly)) {
+    *errorString = file.errorString();
+    return false;
+  }
+  if (file.write(bytes) != bytes.size()) {
+    *errorString = file.errorString();
+    file.cancelWriting();
+    return false;
+  }
+  if (!file.commit()) {
+    *errorString = file.errorString();
+    return false;
+  }
+  state->written = sequence;
+  return true;
+}
@@ -14,6 +14,96 @@
 #include <QStyle>
 #include <QUrl>
 
+FileTreeItem::FileTreeItem(QTreeWidgetItem *parent)
+    : QTreeWidgetItem(parent), fileType_(FileType::Unknown) {}
+
+FileTreeItem::FileTreeItem(QTreeWidget *parent)
+    : QTreeWidgetItem(parent), fileType_(FileType::Unknown) {}
+
+void FileTreeItem::setFileInfo(const QFileInfo &info) {
+  fileInfo_ = info;
+  determineFileType();
+}
+
+void FileTreeItem::determineFileType() { fileType_ = typeOf(fileInfo_); }
+
+FileType FileTreeItem::typeOf(const QFileInfo &info) {
+  if (info.isDir()) {
+    return FileType::Folder;
+  }
+
+  QString name = info.fileName().toLower();
+  QString suffix = info.suffix().toLower();
+
+  if (name == "makefile" || name == "gnumakefile") {
+    return FileType::Makefile;
+  } else if (name == "cmakelists.txt" || suffix == "cmake") {
+    return FileType::CMake;
+  } else if (name == ".gitignore" || name == ".gitattributes" ||
+             name == ".gitmodules") {
+    return FileType::Git;
+  } else if (name.startsWith("license") || name.startsWith("copying")) {
+    return FileType::License;
+  } else if (name.startsWith("readme")) {
+    return FileType::Readme;
+  } else if (suffix == "lock" || name == "package-lock.json") {
+    return FileType::Lock;
+  }
+
+  if (suffix == "md" || suffix == "markdown") {
+    return FileType::Markdown;
+  } else if (suffix == "cpp" || suffix == "cc" || suffix == "cxx" ||
+             suffix == "c++" || suffix == "c") {
+    return FileType::Cpp;
+  } else if (suffix == "h" || suffix == "hpp" || suffix == "hxx" ||
+             suffix == "h++") {
+    return FileType::Header;
+  } else if (suffix == "py") {
+    return FileType::Python;
+  } else if (suffix == "rs") {
+    return FileType::Rust;
+  } else if (suffix == "js" || suffix == "jsx" || suffix == "mjs") {
+    return FileType::JavaScript;
+  } else if (suffix == "ts" || suffix == "tsx") {
+    return FileType::TypeScript;
+  } else if (suffix == "html" || suffix == "htm") {
+    return FileType::Html;
+  } else if (suffix == "css" || suffix == "scss") {
+    return FileType::Css;
+  } else if (suffix == "json") {
+    return FileType::Json;
+  } else if (suffix == "yaml" || suffix == "yml") {
+    return FileType::Yaml;
+  } else if (suffix == "toml") {
+    return FileType::Toml;
+  } else if (suffix == "xml") {
+    return FileType::Xml;
+  } else if (suffix == "sh" || suffix == "bash" || suffix == "zsh") {
+    return FileType::Shell;
+  } else if (suffix == "ini" || suffix == "cfg" || suffix == "conf") {
+    return FileType::Config;
+  } else if (suffix == "png" || suffix == "jpg" || suffix == "jpeg" ||
+             suffix == "gif" || suffix == "bmp" || suffix == "ico" ||
+             suffix == "svg" || suffix == "webp") {
+    return FileType::Image;
+  } else if (suffix == "pdf" || suffix == "doc" || suffix == "docx" ||
+             suffix == "odt") {
+    return FileType::Document;
+  } else if (suffix == "zip" || suffix == "tar" || suffix == "gz" ||
+             suffix == "tgz" || suffix == "bz2" || suffix == "xz" ||
+             suffix == "zst" || suffix == "7z" || suffix == "rar" ||
+             suffix == "jar") {
+    return FileType::Archive;
+  } else if (suffix == "exe" || suffix == "dll" || suffix == "so" ||
+             suffix == "dylib" || suffix == "o" || suffix == "obj" ||
+             suffix == "a" || suffix == "lib" || suffix == "bin" ||
+             suffix == "img" || suffix == "iso" || suffix == "wasm" ||
+             suffix == "class" || suffix == "pyc") {
+    return FileType::Binary;
+  }
+  return FileType::Unknown;
+}
+
 FileTree::FileTree(QWidget *parent) : QTreeWidget(parent) {
   setupUI();
   setRootPath(QDir::homePath());
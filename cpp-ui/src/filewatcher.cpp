@@ -0,0 +1,391 @@
+#include "filewatcher.h"
+#include <QDateTime>
+#include <QFile>
+#include <QFileInfo>
+#include <QFileSystemWatcher>
+#include <QTextBlock>
+#include <QTextCursor>
+#include <QTextDocument>
+#include <QThreadPool>
+#include <QTimer>
+#include <vector>
+
+namespace {
+
+// Editors and generators often write a file in several steps
+const int kSettleMs = 100;
+
+// Beyond this many line edits the middle of the file is replaced as one
+// hunk; the diff trace grows quadratically with the edit count
+const int kMaxEditDistance = 1000;
+
+} // namespace
+
+// ==================== FileWatcher ====================
+
+FileWatcher::FileWatcher(QObject *parent)
+    : QObject(parent), watcher_(new QFileSystemWatcher(this)),
+      settleTimer_(new QTimer(this)) {
+  qRegisterMetaType<ReloadResult>("ReloadResult");
+
+  settleTimer_->setSingleShot(true);
+  settleTimer_->setInterval(kSettleMs);
+  connect(settleTimer_, &QTimer::timeout, this, &FileWatcher::checkPending);
+  connect(watcher_, &QFileSystemWatcher::fileChanged, this,
+          &FileWatcher::onFileChanged);
+  connect(watcher_, &QFileSystemWatcher::directoryChanged, this,
+          &FileWatcher::onDirectoryChanged);
+}
+
+void FileWatcher::watch(const QString &filePath, const DiskState &state) {
+  if (filePath.isEmpty()) {
+    return;
+  }
+  known_[filePath] = state;
+  removed_.remove(filePath);
+
+  if (!watcher_->files().contains(filePath)) {
+    watcher_->addPath(filePath);
+  }
+  // The directory reports files being replaced or recreated, which drops
+  // them from the file watch
+  QString directory = QFileInfo(filePath).absolutePath();
+  if (!watcher_->directories().contains(directory)) {
+    watcher_->addPath(directory);
+  }
+}
+
+void FileWatcher::unwatch(const QString &filePath) {
+  if (!known_.remove(filePath)) {
+    return;
+  }
+  pending_.remove(filePath);
+  removed_.remove(filePath);
+  watcher_->removePath(filePath);
+
+  QString directory = QFileInfo(filePath).absolutePath();
+  for (auto it = known_.cbegin(); it != known_.cend(); ++it) {
+    if (QFileInfo(it.key()).absolutePath() == directory) {
+      return;
+    }
+  }
+  watcher_->removePath(directory);
+}
+
+void FileWatcher::acknowledge(const QString &filePath) {
+  if (known_.contains(filePath)) {
+    known_[filePath] = DiskState::read(filePath);
+  }
+}
+
+void FileWatcher::reload(const QString &filePath, const QString &bufferText,
+                         int revision, bool incremental) {
+  // One reload per file at a time: two appends read against the same old
+  // end would insert the new bytes twice
+  if (inFlight_.contains(filePath)) {
+    stale_.insert(filePath);
+    return;
+  }
+  inFlight_.insert(filePath);
+
+  DiskState known = incremental ? known_.value(filePath) : DiskState();
+  FileReloadJob *job =
+      new FileReloadJob(filePath, known, bufferText, revision);
+  connect(
+      job, &FileReloadJob::finished, this,
+      [this](const QString &path, const ReloadResult &result,
+             const QString &error) {
+        inFlight_.remove(path);
+        if (error.isEmpty()) {
+          emit reloadReady(path, result);
+        } else {
+          emit reloadFailed(path, error);
+        }
+
+        // Changes that arrived meanwhile are checked against the state the
+        // receiver recorded with watch()
+        if (stale_.remove(path)) {
+          pending_.insert(path);
+          settleTimer_->start();
+        }
+      },
+      Qt::QueuedConnection);
+  QThreadPool::globalInstance()->start(job);
+}
+
+void FileWatcher::onFileChanged(const QString &path) {
+  pending_.insert(path);
+  settleTimer_->start();
+}
+
+void FileWatcher::onDirectoryChanged(const QString &path) {
+  // Only files that fell out of the file watch need attention here
+  const QStringList watched = watcher_->files();
+  for (auto it = known_.cbegin(); it != known_.cend(); ++it) {
+    if (!watched.contains(it.key()) &&
+        QFileInfo(it.key()).absolutePath() == path) {
+      pending_.insert(it.key());
+    }
+  }
+  if (!pending_.isEmpty()) {
+    settleTimer_->start();
+  }
+}
+
+void FileWatcher::checkPending() {
+  // Receivers may watch or unwatch while we emit
+  const QSet<QString> paths = pending_;
+  pending_.clear();
+
+  for (const QString &path : paths) {
+    if (!known_.contains(path)) {
+      continue;
+    }
+    if (inFlight_.contains(path)) {
+      stale_.insert(path);
+      continue;
+    }
+
+    QFileInfo info(path);
+    if (!info.exists()) {
+      if (!removed_.contains(path)) {
+        removed_.insert(path);
+        emit fileRemoved(path);
+      }
+      continue;
+    }
+    removed_.remove(path);
+    if (!watcher_->files().contains(path)) {
+      watcher_->addPath(path);
+    }
+
+    // Our own saves, and touches that rewrote identical metadata
+    const DiskState &state = known_[path];
+    if (info.size() == state.size &&
+        info.lastModified().toMSecsSinceEpoch() == state.modified) {
+      continue;
+    }
+    emit fileChanged(path);
+  }
+}
+
+// Myers' O(ND) diff on the lines between the common prefix and suffix
+QVector<LineHunk> FileWatcher::diffLines(const QStringList &oldLines,
+                                         const QStringList &newLines) {
+  QVector<LineHunk> hunks;
+  int oldSize = oldLines.size();
+  int newSize = newLines.size();
+
+  int prefix = 0;
+  while (prefix < oldSize && prefix < newSize &&
+         oldLines[prefix] == newLines[prefix]) {
+    ++prefix;
+  }
+  int suffix = 0;
+  while (suffix < oldSize - prefix && suffix < newSize - prefix &&
+         oldLines[oldSize - 1 - suffix] == newLines[newSize - 1 - suffix]) {
+    ++suffix;
+  }
+
+  const int n = oldSize - prefix - suffix;
+  const int m = newSize - prefix - suffix;
+  if (n == 0 && m == 0) {
+    return hunks;
+  }
+
+  auto a = [&](int i) -> const QString & { return oldLines[prefix + i]; };
+  auto b = [&](int j) -> const QString & { return newLines[prefix + j]; };
+
+  // trace[d] holds the furthest x on each diagonal k in [-d, d] after d
+  // edits, indexed by k + d
+  const int maxD = qMin(n + m, kMaxEditDistance);
+  std::vector<std::vector<int>> trace;
+  std::vector<int> v(2 * (maxD + 1) + 1, 0);
+  const int offset = maxD + 1;
+  int found = -1;
+
+  for (int d = 0; d <= maxD && found < 0; ++d) {
+    for (int k = -d; k <= d; k += 2) {
+      int x;
+      if (k == -d || (k != d && v[offset + k - 1] < v[offset + k + 1])) {
+        x = v[offset + k + 1];
+      } else {
+        x = v[offset + k - 1] + 1;
+      }
+      int y = x - k;
+      while (x < n && y < m && a(x) == b(y)) {
+        ++x;
+        ++y;
+      }
+      v[offset + k] = x;
+      if (x >= n && y >= m) {
+        found = d;
+      }
+    }
+    trace.emplace_back(v.begin() + offset - d, v.begin() + offset + d + 1);
+  }
+
+  if (found < 0) {
+    LineHunk hunk;
+    hunk.oldStart = prefix;
+    hunk.oldCount = n;
+    hunk.lines = newLines.mid(prefix, m);
+    hunks.append(hunk);
+    return hunks;
+  }
+
+  // Walk the trace backwards, marking deleted old and inserted new lines
+  std::vector<bool> deleted(n, false);
+  std::vector<bool> inserted(m, false);
+  int x = n;
+  int y = m;
+  for (int d = found; d > 0; --d) {
+    const std::vector<int> &previous = trace[d - 1];
+    auto at = [&](int k) { return previous[k + d - 1]; };
+    int k = x - y;
+    int previousK =
+        (k == -d || (k != d && at(k - 1) < at(k + 1))) ? k + 1 : k - 1;
+    int previousX = at(previousK);
+    int previousY = previousX - previousK;
+    while (x > previousX && y > previousY) {
+      --x;
+      --y;
+    }
+    if (previousK == k + 1) {
+      inserted[previousY] = true;
+    } else {
+      deleted[previousX] = true;
+    }
+    x = previousX;
+    y = previousY;
+  }
+
+  // Unmarked lines pair up in order; everything between them is a hunk
+  int i = 0;
+  int j = 0;
+  while (i < n || j < m) {
+    if (i < n && j < m && !deleted[i] && !inserted[j]) {
+      ++i;
+      ++j;
+      continue;
+    }
+    LineHunk hunk;
+    hunk.oldStart = prefix + i;
+    while (i < n && deleted[i]) {
+      ++i;
+    }
+    hunk.oldCount = prefix + i - hunk.oldStart;
+    while (j < m && inserted[j]) {
+      hunk.lines.append(b(j));
+      ++j;
+    }
+    hunks.append(hunk);
+  }
+  return hunks;
+}
+
+void FileWatcher::apply(QTextDocument *document, const ReloadResult &result) {
+  QTextCursor cursor(document);
+  cursor.beginEditBlock();
+
+  if (result.appended) {
+    cursor.movePosition(QTextCursor::End);
+    cursor.insertText(result.appendedText);
+  } else {
+    // Back to front, so earlier hunks keep their line numbers
+    for (int h = result.hunks.size() - 1; h >= 0; --h) {
+      const LineHunk &hunk = result.hunks[h];
+      int blocks = document->blockCount();
+      int documentEnd = document->characterCount() - 1;
+      int oldEnd = hunk.oldStart + hunk.oldCount;
+      QString text = hunk.lines.join(QLatin1Char('\n'));
+      int start;
+      int end;
+
+      if (oldEnd < blocks) {
+        // Whole lines including their terminators
+        start = document->findBlockByNumber(hunk.oldStart).position();
+        end = document->findBlockByNumber(oldEnd).position();
+        if (!hunk.lines.isEmpty()) {
+          text += QLatin1Char('\n');
+        }
+      } else if (hunk.oldStart < blocks) {
+        // Runs to the end of the document, which has no final terminator
+        start = document->findBlockByNumber(hunk.oldStart).position();
+        end = documentEnd;
+        if (hunk.lines.isEmpty() && hunk.oldStart > 0) {
+          --start;
+        }
+      } else {
+        // New lines after the last one
+        start = documentEnd;
+        end = documentEnd;
+        text.prepend(QLatin1Char('\n'));
+      }
+
+      cursor.setPosition(start);
+      cursor.setPosition(end, QTextCursor::KeepAnchor);
+      cursor.insertText(text);
+    }
+  }
+
+  cursor.endEditBlock();
+}
+
+// ==================== FileReloadJob ====================
+
+FileReloadJob::FileReloadJob(const QString &filePath, const DiskState &known,
+                             const QString &bufferText, int revision)
+    : filePath_(filePath), known_(known), bufferText_(bufferText),
+      revision_(revision) {}
+
+bool FileReloadJob::readAppended(QFile &file, ReloadResult &result) {
+  qint64 size = file.size();
+  if (!known_.isValid() || known_.tail.isEmpty() || size <= known_.size) {
+    return false;
+  }
+
+  // The old end must still be there, byte for byte
+  qint64 anchor = known_.size - known_.tail.size();
+  if (!file.seek(anchor) || file.read(known_.tail.size()) != known_.tail) {
+    return false;
+  }
+
+  QByteArray bytes = file.read(size - known_.size);
+  bytes.truncate(FileLoader::completePrefix(bytes.constData(), bytes.size()));
+  LoadedText decoded = FileLoader::decodeUtf8(bytes.constData(), bytes.size());
+
+  result.appended = true;
+  result.appendedText = decoded.text;
+  result.disk.size = known_.size + bytes.size();
+  result.disk.modified = QFileInfo(file).lastModified().toMSecsSinceEpoch();
+  result.disk.tail = (known_.tail + bytes).right(DiskState::kTailBytes);
+  return true;
+}
+
+void FileReloadJob::run() {
+  ReloadResult result;
+  result.revision = revision_;
+  QString error;
+
+  QFile file(filePath_);
+  if (!file.open(QIODevice::ReadOnly)) {
+    error = file.errorString();
+  } else if (!readAppended(file, result)) {
+    file.seek(0);
+    QByteArray bytes = file.readAll();
+    LoadedText decoded =
+        FileLoader::decodeUtf8(bytes.constData(), bytes.size());
+
+    result.lineEnding = decoded.lineEnding;
+    result.hasBom = decoded.hasBom;
+    result.disk.size = bytes.size();
+    result.disk.modified = QFileInfo(file).lastModified().toMSecsSinceEpoch();
+    result.disk.tail = bytes.right(DiskState::kTailBytes);
+    result.hunks = FileWatcher::diffLines(bufferText_.split(QLatin1Char('\n')),
+                                          decoded.text.split(QLatin1Char('\n')));
+  }
+
+  emit finished(filePath_, result, error);
+  deleteLater();
+}
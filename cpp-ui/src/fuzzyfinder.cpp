@@ -1,5 +1,9 @@
 #include "fuzzyfinder.h"
+#include "contentsearch.h"
+#include "fuzzymatcher.h"
 #include "theme.h"
+#include "trigramindex.h"
+#include "workspaceindex.h"
 
 #include <QVBoxLayout>
 #include <QHBoxLayout>
@@ -7,21 +11,160 @@
 #include <QDir>
 #include <QFileInfo>
 #include <QDirIterator>
-#include <QTextStream>
 #include <QApplication>
+#include <QPainter>
 #include <QScreen>
+#include <QThreadPool>
 #include <algorithm>
 
-// ==================== FuzzyListItem ====================
+namespace {
 
-FuzzyListItem::FuzzyListItem(const FuzzyMatch &match, QListWidget *parent)
-    : QListWidgetItem(parent)
-    , filePath_(match.filePath)
-    , score_(match.score)
+// Rows kept by a file search
+const int kMaxFileResults = 100;
+
+// Queries remembered for narrowing
+const int kMaxNarrowedQueries = 16;
+
+// Content hits listed before a search stops; only the rows on screen
+// cost anything to show
+const int kMaxContentHits = 100000;
+
+} // namespace
+
+// ==================== FuzzyResultModel ====================
+
+FuzzyResultModel::FuzzyResultModel(QObject *parent)
+    : QAbstractListModel(parent)
+{
+}
+
+int FuzzyResultModel::rowCount(const QModelIndex &parent) const
+{
+    return parent.isValid() ? 0 : matches_.size();
+}
+
+QVariant FuzzyResultModel::data(const QModelIndex &index, int role) const
+{
+    if (!index.isValid() || index.row() >= matches_.size()) {
+        return QVariant();
+    }
+    
+    const FuzzyMatch &match = matches_.at(index.row());
+    switch (role) {
+        case Qt::DisplayRole:
+        case Qt::ToolTipRole:
+            return match.text;
+        case FilePathRole:
+            return match.filePath;
+        case PositionsRole:
+            return QVariant::fromValue(match.matchPositions);
+        case LineNumberRole:
+            return match.lineNumber;
+        case ColumnRole:
+            return match.column;
+        default:
+            return QVariant();
+    }
+}
+
+void FuzzyResultModel::setMatches(const QVector<FuzzyMatch> &matches)
+{
+    beginResetModel();
+    matches_ = matches;
+    endResetModel();
+}
+
+void FuzzyResultModel::appendMatches(const QVector<FuzzyMatch> &matches)
+{
+    if (matches.isEmpty()) {
+        return;
+    }
+    beginInsertRows(QModelIndex(), matches_.size(), matches_.size() + matches.size() - 1);
+    matches_ += matches;
+    endInsertRows();
+}
+
+void FuzzyResultModel::clear()
+{
+    if (matches_.isEmpty()) {
+        return;
+    }
+    beginResetModel();
+    matches_.clear();
+    endResetModel();
+}
+
+// ==================== FuzzyResultDelegate ====================
+
+FuzzyResultDelegate::FuzzyResultDelegate(QObject *parent)
+    : QStyledItemDelegate(parent)
+{
+}
+
+void FuzzyResultDelegate::setColors(const QColor &text, const QColor &selectedText,
+                                    const QColor &match)
+{
+    text_ = text;
+    selectedText_ = selectedText;
+    match_ = match;
+}
+
+void FuzzyResultDelegate::paint(QPainter *painter, const QStyleOptionViewItem &option,
+                                const QModelIndex &index) const
 {
-    setText(match.text);
-    setData(Qt::UserRole, match.filePath);
-    setData(Qt::UserRole + 1, QVariant::fromValue(match.matchPositions));
+    QStyleOptionViewItem opt = option;
+    initStyleOption(&opt, index);
+    const QWidget *widget = opt.widget;
+    QStyle *style = widget ? widget->style() : QApplication::style();
+    
+    // Background, hover and selection come from the style sheet; the
+    // text is drawn here, a run at a time
+    const QRect textRect = style->subElementRect(QStyle::SE_ItemViewItemText, &opt, widget);
+    const QString text = opt.text;
+    opt.text.clear();
+    style->drawControl(QStyle::CE_ItemViewItem, &opt, painter, widget);
+    
+    const bool selected = opt.state & QStyle::State_Selected;
+    QColor plain = selected ? selectedText_ : text_;
+    if (!plain.isValid()) {
+        plain = opt.palette.color(selected ? QPalette::HighlightedText : QPalette::Text);
+    }
+    const QColor highlight = match_.isValid() ? match_ : opt.palette.color(QPalette::Link);
+    
+    const QFontMetrics metrics(opt.font);
+    const QString elided = metrics.elidedText(text, Qt::ElideRight, textRect.width());
+    // Characters of text shown before any ellipsis
+    const int shown = elided == text ? text.length() : qMax(0, elided.length() - 1);
+    
+    QVector<bool> matched(shown, false);
+    for (int pos : index.data(FuzzyResultModel::PositionsRole).value<QVector<int>>()) {
+        if (pos >= 0 && pos < shown) {
+            matched[pos] = true;
+        }
+    }
+    
+    painter->save();
+    painter->setFont(opt.font);
+    painter->setClipRect(textRect);
+    int x = textRect.left();
+    const int baseline = textRect.top() + (textRect.height() - metrics.height()) / 2 +
+                         metrics.ascent();
+    for (int start = 0; start < shown;) {
+        int end = start + 1;
+        while (end < shown && matched[end] == matched[start]) {
+            ++end;
+        }
+        const QString run = text.mid(start, end - start);
+        painter->setPen(matched[start] ? highlight : plain);
+        painter->drawText(QPoint(x, baseline), run);
+        x += metrics.horizontalAdvance(run);
+        start = end;
+    }
+    if (shown < text.length()) {
+        painter->setPen(plain);
+        painter->drawText(QPoint(x, baseline), elided.right(1));
+    }
+    painter->restore();
 }
 
 // ==================== FuzzyLineEdit ====================
@@ -58,12 +201,20 @@ FuzzyFinder::FuzzyFinder(QWidget *parent)
     : QDialog(parent, Qt::Popup | Qt::FramelessWindowHint)
     , searchInput_(nullptr)
     , resultsList_(nullptr)
+    , resultsModel_(nullptr)
+    , resultsDelegate_(nullptr)
     , statusLabel_(nullptr)
     , modeLabel_(nullptr)
     , currentMode_(FileMode)
+    , index_(nullptr)
+    , trigrams_(nullptr)
     , theme_(nullptr)
     , searchTimer_(new QTimer(this))
+    , narrowingRevision_(0)
 {
+    qRegisterMetaType<FileSearchResult>("FileSearchResult");
+    qRegisterMetaType<QVector<FuzzyMatch>>("QVector<FuzzyMatch>");
+    
     setupUI();
     
     // Setup search debounce timer
@@ -107,6 +258,12 @@ FuzzyFinder::FuzzyFinder(QWidget *parent)
 
 FuzzyFinder::~FuzzyFinder()
 {
+    if (fileSearch_) {
+        fileSearch_->cancel();
+    }
+    if (contentSearch_) {
+        contentSearch_->cancel();
+    }
 }
 
 void FuzzyFinder::setupUI()
@@ -136,11 +293,17 @@ void FuzzyFinder::setupUI()
     searchInput_->setMinimumHeight(36);
     containerLayout->addWidget(searchInput_);
     
-    // Results list
-    resultsList_ = new QListWidget(container);
+    // Results list; uniform rows let the view place any row without
+    // measuring the others
+    resultsModel_ = new FuzzyResultModel(this);
+    resultsDelegate_ = new FuzzyResultDelegate(this);
+    resultsList_ = new QListView(container);
     resultsList_->setObjectName("fuzzyResultsList");
+    resultsList_->setModel(resultsModel_);
+    resultsList_->setItemDelegate(resultsDelegate_);
     resultsList_->setUniformItemSizes(true);
     resultsList_->setSelectionMode(QAbstractItemView::SingleSelection);
+    resultsList_->setEditTriggers(QAbstractItemView::NoEditTriggers);
     containerLayout->addWidget(resultsList_, 1);
     
     // Status label at bottom
@@ -155,8 +318,8 @@ void FuzzyFinder::setupUI()
     connect(searchInput_, &FuzzyLineEdit::moveUp, this, &FuzzyFinder::onMoveUp);
     connect(searchInput_, &FuzzyLineEdit::moveDown, this, &FuzzyFinder::onMoveDown);
     connect(searchInput_, &FuzzyLineEdit::selectCurrent, this, &FuzzyFinder::onSelectCurrent);
-    connect(resultsList_, &QListWidget::itemActivated, this, &FuzzyFinder::onItemActivated);
-    connect(resultsList_, &QListWidget::itemDoubleClicked, this, &FuzzyFinder::onItemActivated);
+    connect(resultsList_, &QListView::activated, this, &FuzzyFinder::onItemActivated);
+    connect(resultsList_, &QListView::doubleClicked, this, &FuzzyFinder::onItemActivated);
 }
 
 void FuzzyFinder::setMode(Mode mode)
@@ -183,6 +346,10 @@ void FuzzyFinder::setMode(Mode mode)
             modeText = "📋 Open Buffers";
             placeholder = "Search open files...";
             break;
+        case BufferContentMode:
+            modeText = "📝 Search in Open Buffers";
+            placeholder = "Search open buffers...";
+            break;
     }
     
     modeLabel_->setText(modeText);
@@ -193,8 +360,20 @@ void FuzzyFinder::setMode(Mode mode)
 
 void FuzzyFinder::setRootPath(const QString &path)
 {
-    rootPath_ = path;
-    indexedFiles_.clear();
+    rootPath_ = path.isEmpty() ? QDir::currentPath() : path;
+    
+    // Built once per root and kept current in the background, so opening
+    // the palette never walks the tree
+    WorkspaceIndex *index = WorkspaceIndex::forRoot(rootPath_);
+    if (index != index_) {
+        if (index_) {
+            disconnect(index_, nullptr, this, nullptr);
+        }
+        index_ = index;
+        trigrams_ = TrigramIndex::forIndex(index_);
+        rootPath_ = index_->rootPath();
+        connect(index_, &WorkspaceIndex::updated, this, &FuzzyFinder::onIndexUpdated);
+    }
 }
 
 void FuzzyFinder::setOpenFiles(const QStringList &files)
@@ -202,6 +381,11 @@ void FuzzyFinder::setOpenFiles(const QStringList &files)
     openFiles_ = files;
 }
 
+void FuzzyFinder::setOpenBuffers(const QVector<BufferSnapshot> &buffers)
+{
+    openBuffers_ = buffers;
+}
+
 void FuzzyFinder::setTheme(Theme *theme)
 {
     theme_ = theme;
@@ -212,15 +396,16 @@ void FuzzyFinder::showFileSearch(const QString &rootPath)
 {
     setRootPath(rootPath);
     setMode(FileMode);
-    indexFiles();
     show();
 }
 
 void FuzzyFinder::showContentSearch(const QString &rootPath)
 {
     setRootPath(rootPath);
+    // Files edited since the last pass stay candidates until checked and
+    // reindexed; the rest of the index narrows meanwhile
+    trigrams_->refresh();
     setMode(ContentMode);
-    indexFiles();
     show();
 }
 
@@ -231,6 +416,13 @@ void FuzzyFinder::showBufferSearch(const QStringList &openFiles)
     show();
 }
 
+void FuzzyFinder::showBufferContentSearch(const QVector<BufferSnapshot> &buffers)
+{
+    setOpenBuffers(buffers);
+    setMode(BufferContentMode);
+    show();
+}
+
 void FuzzyFinder::showCommandSearch()
 {
     setMode(CommandMode);
@@ -278,12 +470,14 @@ void FuzzyFinder::onTextChanged(const QString &text)
     searchTimer_->start();
 }
 
-void FuzzyFinder::onItemActivated(QListWidgetItem *item)
+void FuzzyFinder::onItemActivated(const QModelIndex &index)
 {
-    if (!item) return;
+    if (!index.isValid()) return;
     
-    QString filePath = item->data(Qt::UserRole).toString();
-    int lineNumber = item->data(Qt::UserRole + 2).toInt();
+    const FuzzyMatch &match = resultsModel_->match(index.row());
+    QString filePath = match.filePath;
+    int lineNumber = match.lineNumber;
+    int column = match.column;
     
     switch (currentMode_) {
         case FileMode:
@@ -298,6 +492,9 @@ void FuzzyFinder::onItemActivated(QListWidgetItem *item)
         case BufferMode:
             emit bufferSelected(filePath);
             break;
+        case BufferContentMode:
+            emit bufferContentSelected(filePath, lineNumber, column);
+            break;
     }
     
     hide();
@@ -305,26 +502,23 @@ void FuzzyFinder::onItemActivated(QListWidgetItem *item)
 
 void FuzzyFinder::onMoveUp()
 {
-    int current = resultsList_->currentRow();
+    int current = resultsList_->currentIndex().row();
     if (current > 0) {
-        resultsList_->setCurrentRow(current - 1);
+        resultsList_->setCurrentIndex(resultsModel_->index(current - 1));
     }
 }
 
 void FuzzyFinder::onMoveDown()
 {
-    int current = resultsList_->currentRow();
-    if (current < resultsList_->count() - 1) {
-        resultsList_->setCurrentRow(current + 1);
+    int current = resultsList_->currentIndex().row();
+    if (current < resultsModel_->rowCount() - 1) {
+        resultsList_->setCurrentIndex(resultsModel_->index(current + 1));
     }
 }
 
 void FuzzyFinder::onSelectCurrent()
 {
-    QListWidgetItem *item = resultsList_->currentItem();
-    if (item) {
-        onItemActivated(item);
-    }
+    onItemActivated(resultsList_->currentIndex());
 }
 
 void FuzzyFinder::performSearch()
@@ -344,6 +538,18 @@ void FuzzyFinder::performSearch()
         case BufferMode:
             searchBuffers(pattern);
             break;
+        case BufferContentMode:
+            searchContent(pattern);
+            break;
+    }
+}
+
+void FuzzyFinder::onIndexUpdated()
+{
+    // File results follow the index as it loads and changes; content
+    // searches are too expensive to repeat unasked
+    if (isVisible() && currentMode_ == FileMode) {
+        searchTimer_->start();
     }
 }
 
@@ -352,11 +558,22 @@ void FuzzyFinder::applyTheme()
     if (!theme_) return;
     
     setStyleSheet(theme_->getFuzzyFinderStyleSheet());
+    resultsDelegate_->setColors(theme_->fuzzyForeground(), theme_->fuzzySelected(),
+                                theme_->fuzzyMatch());
+    resultsList_->viewport()->update();
 }
 
 void FuzzyFinder::clearResults()
 {
-    resultsList_->clear();
+    if (fileSearch_) {
+        fileSearch_->cancel();
+        fileSearch_ = nullptr;
+    }
+    if (contentSearch_) {
+        contentSearch_->cancel();
+        contentSearch_ = nullptr;
+    }
+    resultsModel_->clear();
     statusLabel_->setText("0 results");
 }
 
@@ -364,75 +581,15 @@ void FuzzyFinder::clearResults()
 
 int FuzzyFinder::fuzzyScore(const QString &pattern, const QString &text, QVector<int> &positions)
 {
-    positions.clear();
-    
-    if (pattern.isEmpty()) {
-        return 1;  // Empty pattern matches everything with low score
-    }
-    
-    int patternLen = pattern.length();
-    int textLen = text.length();
-    
-    int patternIdx = 0;
-    int score = 0;
-    int consecutive = 0;
-    int lastMatchIdx = -1;
-    
-    QString lowerPattern = pattern.toLower();
-    QString lowerText = text.toLower();
-    
-    for (int i = 0; i < textLen && patternIdx < patternLen; ++i) {
-        if (lowerText[i] == lowerPattern[patternIdx]) {
-            positions.append(i);
-            
-            // Bonus for consecutive matches
-            if (lastMatchIdx >= 0 && i == lastMatchIdx + 1) {
-                consecutive++;
-                score += consecutive * 10;
-            } else {
-                consecutive = 0;
-            }
-            
-            // Bonus for match at start
-            if (i == 0) {
-                score += 50;
-            }
-            
-            // Bonus for match after separator
-            if (i > 0 && (text[i-1] == '/' || text[i-1] == '_' || text[i-1] == '-' || text[i-1] == '.')) {
-                score += 30;
-            }
-            
-            // Bonus for case match
-            if (text[i] == pattern[patternIdx]) {
-                score += 5;
-            }
-            
-            // Bonus for match at word start (camelCase)
-            if (i > 0 && text[i].isUpper() && text[i-1].isLower()) {
-                score += 20;
-            }
-            
-            score += 10;  // Base score for each match
-            lastMatchIdx = i;
-            patternIdx++;
-        }
-    }
+    // Commands and buffers are few; indexed files use prepared keys instead
+    FuzzyMatcher matcher(pattern);
+    QByteArray utf8 = text.toUtf8();
+    QByteArray lower = FuzzyMatcher::toLowerAscii(utf8);
     
-    // Did we match all pattern characters?
-    if (patternIdx < patternLen) {
-        return 0;  // No match
-    }
-    
-    // Penalty for longer strings
-    score -= (textLen - patternLen);
-    
-    // Bonus for shorter strings (exact or near matches)
-    if (textLen == patternLen) {
-        score += 100;
-    }
-    
-    return qMax(1, score);
+    QVector<int> bytePositions;
+    int score = matcher.alignScore(utf8.constData(), lower.constData(), utf8.size(), &bytePositions);
+    positions = FuzzyMatcher::toStringPositions(utf8, bytePositions);
+    return score;
 }
 
 bool FuzzyFinder::fuzzyMatch(const QString &pattern, const QString &text)
@@ -445,86 +602,147 @@ bool FuzzyFinder::fuzzyMatch(const QString &pattern, const QString &text)
 
 void FuzzyFinder::searchFiles(const QString &pattern)
 {
-    QVector<FuzzyMatch> matches;
+    // A newer query makes the running search pointless
+    if (fileSearch_) {
+        fileSearch_->cancel();
+    }
     
-    for (const QString &filePath : indexedFiles_) {
-        QString fileName = QFileInfo(filePath).fileName();
-        QString relativePath = filePath;
-        if (filePath.startsWith(rootPath_)) {
-            relativePath = filePath.mid(rootPath_.length() + 1);
-        }
-        
-        QVector<int> positions;
-        int score = fuzzyScore(pattern, fileName, positions);
-        
-        if (score > 0) {
-            FuzzyMatch match;
-            match.text = relativePath;
-            match.filePath = filePath;
-            match.score = score;
-            match.matchPositions = positions;
-            matches.append(match);
+    const QStringList files = index_ ? index_->files() : QStringList();
+    const QVector<FileKey> keys = index_ ? index_->keys() : QVector<FileKey>();
+    
+    // Remembered matches refer to positions in one revision's key list
+    quint64 revision = index_ ? index_->revision() : 0;
+    if (revision != narrowingRevision_) {
+        narrowing_.clear();
+        narrowingRevision_ = revision;
+    }
+    
+    // The longest remembered query this one extends (or repeats, after a
+    // backspace) bounds the candidates
+    const NarrowedQuery *narrowed = nullptr;
+    for (const NarrowedQuery &query : narrowing_) {
+        if (pattern.startsWith(query.pattern) &&
+            (!narrowed || query.pattern.length() > narrowed->pattern.length())) {
+            narrowed = &query;
         }
     }
     
-    // Sort by score
-    std::sort(matches.begin(), matches.end());
+    // Scored on the thread pool; the current rows stay until it finishes
+    if (narrowed) {
+        fileSearch_ = new FileSearchJob(pattern, files, keys, kMaxFileResults,
+                                        narrowed->candidates);
+    } else {
+        fileSearch_ = new FileSearchJob(pattern, files, keys, kMaxFileResults);
+    }
+    connect(fileSearch_, &FileSearchJob::finished, this, &FuzzyFinder::onFileSearchFinished,
+            Qt::QueuedConnection);
+    QThreadPool::globalInstance()->start(fileSearch_);
+}
+
+void FuzzyFinder::onFileSearchFinished(const FileSearchResult &result)
+{
+    // Superseded by a newer query or cleared
+    if (sender() != fileSearch_) {
+        return;
+    }
+    fileSearch_ = nullptr;
+    
+    rememberMatches(result);
+    displayResults(result.matches);
     
-    // Limit results
-    if (matches.size() > 100) {
-        matches.resize(100);
+    QString status = result.matched > result.matches.size()
+        ? QString("%1 of %2 results").arg(result.matches.size()).arg(result.matched)
+        : QString("%1 results").arg(result.matched);
+    if (index_ && !index_->isReady()) {
+        status += QString(" (indexing %1 files...)").arg(index_->fileCount());
+    }
+    statusLabel_->setText(status);
+}
+
+void FuzzyFinder::rememberMatches(const FileSearchResult &result)
+{
+    // The empty query matches everything; nothing to narrow from
+    if (result.pattern.isEmpty() || !index_ || index_->revision() != narrowingRevision_) {
+        return;
     }
     
-    displayResults(matches);
+    // Keep only the chain of prefixes of this query: anything else was
+    // typed over and will not be reached by backspacing
+    for (int i = narrowing_.size() - 1; i >= 0; --i) {
+        const QString &pattern = narrowing_.at(i).pattern;
+        if (!result.pattern.startsWith(pattern) || pattern == result.pattern) {
+            narrowing_.remove(i);
+        }
+    }
+    if (narrowing_.size() >= kMaxNarrowedQueries) {
+        narrowing_.remove(0);
+    }
+    narrowing_.append({result.pattern, result.candidates});
 }
 
 void FuzzyFinder::searchContent(const QString &pattern)
 {
+    // Also cancels the search for the previous query
+    clearResults();
     if (pattern.isEmpty()) {
-        clearResults();
         return;
     }
     
-    QVector<FuzzyMatch> matches;
-    
-    for (const QString &filePath : indexedFiles_) {
-        QFile file(filePath);
-        if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) continue;
-        
-        QTextStream stream(&file);
-        int lineNumber = 0;
-        
-        while (!stream.atEnd() && matches.size() < 200) {
-            QString line = stream.readLine();
-            lineNumber++;
-            
-            if (line.contains(pattern, Qt::CaseInsensitive)) {
-                FuzzyMatch match;
-                QString relativePath = filePath;
-                if (filePath.startsWith(rootPath_)) {
-                    relativePath = filePath.mid(rootPath_.length() + 1);
-                }
-                match.text = QString("%1:%2: %3").arg(relativePath).arg(lineNumber).arg(line.trimmed().left(80));
-                match.filePath = filePath;
-                match.score = 100;  // All content matches have same base score
-                
-                // Store line number in a special way
-                QListWidgetItem *item = new QListWidgetItem();
-                item->setText(match.text);
-                item->setData(Qt::UserRole, filePath);
-                item->setData(Qt::UserRole + 2, lineNumber);
-                resultsList_->addItem(item);
-            }
+    if (ContentSearchJob::isRegex(pattern)) {
+        QRegularExpression regex = ContentSearchJob::regexFor(pattern);
+        if (!regex.isValid()) {
+            statusLabel_->setText(QString("Invalid regular expression: %1").arg(regex.errorString()));
+            return;
         }
-        
-        file.close();
     }
     
-    statusLabel_->setText(QString("%1 results").arg(resultsList_->count()));
+    // Searched on the thread pool; hits stream in as they are found
+    if (currentMode_ == BufferContentMode) {
+        // The snapshots taken when the palette opened, not the files on disk
+        contentSearch_ = new ContentSearchJob(pattern, rootPath_, openBuffers_,
+                                              kMaxContentHits);
+    } else {
+        // Literals are only searched for in files holding all their
+        // trigrams; regular expressions go through every file
+        QStringList files;
+        if (ContentSearchJob::isRegex(pattern) || !trigrams_ ||
+            !trigrams_->candidates(pattern, files)) {
+            files = index_ ? index_->files() : QStringList();
+        }
+        contentSearch_ = new ContentSearchJob(pattern, rootPath_, files, kMaxContentHits);
+    }
+    connect(contentSearch_, &ContentSearchJob::hitsFound, this, &FuzzyFinder::onContentHits,
+            Qt::QueuedConnection);
+    connect(contentSearch_, &ContentSearchJob::finished, this,
+            &FuzzyFinder::onContentSearchFinished, Qt::QueuedConnection);
+    QThreadPool::globalInstance()->start(contentSearch_);
+    statusLabel_->setText("Searching...");
+}
+
+void FuzzyFinder::onContentHits(const QVector<FuzzyMatch> &hits)
+{
+    if (sender() != contentSearch_) {
+        return;
+    }
     
-    if (resultsList_->count() > 0) {
-        resultsList_->setCurrentRow(0);
+    bool wasEmpty = resultsModel_->rowCount() == 0;
+    resultsModel_->appendMatches(hits);
+    if (wasEmpty && resultsModel_->rowCount() > 0) {
+        resultsList_->setCurrentIndex(resultsModel_->index(0));
+    }
+    statusLabel_->setText(QString("%1 results (searching...)").arg(resultsModel_->rowCount()));
+}
+
+void FuzzyFinder::onContentSearchFinished(int hitCount, bool truncated)
+{
+    if (sender() != contentSearch_) {
+        return;
     }
+    contentSearch_ = nullptr;
+    
+    statusLabel_->setText(truncated
+        ? QString("%1 results (stopped at %1)").arg(hitCount)
+        : QString("%1 results").arg(hitCount));
 }
 
 void FuzzyFinder::searchBuffers(const QString &pattern)
@@ -538,6 +756,11 @@ void FuzzyFinder::searchBuffers(const QString &pattern)
         int score = fuzzyScore(pattern, fileName, positions);
         
         if (score > 0) {
+            // Scored on the name, shown as the full path it ends
+            const int offset = filePath.length() - fileName.length();
+            for (int &position : positions) {
+                position += offset;
+            }
             FuzzyMatch match;
             match.text = filePath;
             match.filePath = filePath;
@@ -573,87 +796,15 @@ void FuzzyFinder::searchCommands(const QString &pattern)
     displayResults(matches);
 }
 
-void FuzzyFinder::scanDirectory(const QString &path, QStringList &files, int maxDepth)
-{
-    if (maxDepth <= 0) return;
-    
-    QDir dir(path);
-    
-    // Skip certain directories
-    static const QStringList skipDirs = {
-        "node_modules", ".git", ".svn", ".hg", "__pycache__",
-        "target", "build", "dist", ".cache", "vendor"
-    };
-    
-    QString dirName = dir.dirName();
-    if (skipDirs.contains(dirName) || dirName.startsWith('.')) {
-        return;
-    }
-    
-    // Get files
-    QStringList nameFilters;
-    nameFilters << "*.md" << "*.txt" << "*.cpp" << "*.h" << "*.hpp" << "*.c"
-                << "*.py" << "*.rs" << "*.js" << "*.ts" << "*.jsx" << "*.tsx"
-                << "*.json" << "*.yaml" << "*.yml" << "*.toml" << "*.html"
-                << "*.css" << "*.scss" << "*.sh" << "*.bash" << "*.zsh"
-                << "CMakeLists.txt" << "Makefile" << "Cargo.toml";
-    
-    QFileInfoList fileInfos = dir.entryInfoList(nameFilters, QDir::Files | QDir::Readable);
-    for (const QFileInfo &info : fileInfos) {
-        files.append(info.absoluteFilePath());
-    }
-    
-    // Recurse into subdirectories
-    QFileInfoList dirInfos = dir.entryInfoList(QDir::Dirs | QDir::NoDotAndDotDot);
-    for (const QFileInfo &info : dirInfos) {
-        scanDirectory(info.absoluteFilePath(), files, maxDepth - 1);
-    }
-}
-
-void FuzzyFinder::indexFiles()
-{
-    indexedFiles_.clear();
-    
-    if (rootPath_.isEmpty()) {
-        rootPath_ = QDir::currentPath();
-    }
-    
-    scanDirectory(rootPath_, indexedFiles_, 8);
-    
-    statusLabel_->setText(QString("Indexed %1 files").arg(indexedFiles_.size()));
-}
-
 void FuzzyFinder::displayResults(const QVector<FuzzyMatch> &matches)
 {
-    resultsList_->clear();
-    
-    for (const FuzzyMatch &match : matches) {
-        FuzzyListItem *item = new FuzzyListItem(match, resultsList_);
-        resultsList_->addItem(item);
-    }
+    // One reset rather than a row at a time
+    resultsModel_->setMatches(matches);
     
     statusLabel_->setText(QString("%1 results").arg(matches.size()));
     
-    if (resultsList_->count() > 0) {
-        resultsList_->setCurrentRow(0);
+    if (resultsModel_->rowCount() > 0) {
+        resultsList_->setCurrentIndex(resultsModel_->index(0));
+        resultsList_->scrollToTop();
     }
 }
-
-QString FuzzyFinder::highlightMatches(const QString &text, const QVector<int> &positions)
-{
-    if (positions.isEmpty()) return text;
-    
-    QString result;
-    int lastPos = 0;
-    
-    for (int pos : positions) {
-        if (pos >= 0 && pos < text.length()) {
-            result += text.mid(lastPos, pos - lastPos);
-            result += QString("<b>%1</b>").arg(text[pos]);
-            lastPos = pos + 1;
-        }
-    }
-    
-    result += text.mid(lastPos);
-    return result;
-}
@@ -0,0 +1,523 @@
+#include "fuzzymatcher.h"
+#include <QThread>
+#include <QVarLengthArray>
+#include <algorithm>
+
+namespace {
+
+// Candidates between cancellation checks
+const int kCancelCheckInterval = 4096;
+
+// Below this, splitting costs more than it saves
+const int kMinShardSize = 8192;
+
+// Candidates per returned row that get the full alignment
+const int kRescoreFactor = 8;
+
+inline char lowerAscii(char c) {
+  return (c >= 'A' && c <= 'Z') ? char(c + ('a' - 'A')) : c;
+}
+
+// Scoring constants of fzf's algorithm: matches earn more right after
+// boundaries and in runs, gaps cost
+const int kScoreMatch = 16;
+const int kScoreGapStart = -3;
+const int kScoreGapExtension = -1;
+const int kBonusBoundary = kScoreMatch / 2;
+const int kBonusNonWord = kScoreMatch / 2;
+const int kBonusCamel123 = kBonusBoundary + kScoreGapExtension;
+const int kBonusConsecutive = -(kScoreGapStart + kScoreGapExtension);
+const int kBonusBoundaryWhite = kBonusBoundary + 2;
+const int kBonusBoundaryDelimiter = kBonusBoundary + 1;
+const int kBonusFirstCharMultiplier = 2;
+
+// Longer queries or wider windows fall back to the single-pass score
+const int kMaxAlignPattern = 64;
+const qint64 kMaxAlignCells = 64 * 1024;
+
+enum CharClass {
+  kWhite,
+  kNonWord,
+  kDelimiter,
+  kLower,
+  kUpper,
+  kLetter, // Any non-ASCII byte
+  kNumber
+};
+
+// The start of a path counts as a boundary
+const CharClass kInitialClass = kWhite;
+
+inline CharClass classOf(char c) {
+  if (c >= 'a' && c <= 'z') {
+    return kLower;
+  }
+  if (c >= 'A' && c <= 'Z') {
+    return kUpper;
+  }
+  if (c >= '0' && c <= '9') {
+    return kNumber;
+  }
+  if (uchar(c) >= 0x80) {
+    return kLetter;
+  }
+  switch (c) {
+  case ' ':
+  case '\t':
+  case '\n':
+  case '\r':
+    return kWhite;
+  case '/':
+  case ',':
+  case ':':
+  case ';':
+  case '|':
+    return kDelimiter;
+  default:
+    return kNonWord;
+  }
+}
+
+inline int bonusFor(CharClass prevClass, CharClass charClass) {
+  if (charClass > kNonWord) {
+    switch (prevClass) {
+    case kWhite:
+      return kBonusBoundaryWhite;
+    case kDelimiter:
+      return kBonusBoundaryDelimiter;
+    case kNonWord:
+      return kBonusBoundary;
+    default:
+      break;
+    }
+  }
+  if ((prevClass == kLower && charClass == kUpper) ||
+      (prevClass != kNumber && charClass == kNumber)) {
+    return kBonusCamel123;
+  }
+  if (charClass == kNonWord || charClass == kDelimiter) {
+    return kBonusNonWord;
+  }
+  if (charClass == kWhite) {
+    return kBonusBoundaryWhite;
+  }
+  return 0;
+}
+
+// Letters and digits get a bit each; everything else shares the rest.
+// Sharing only makes the prefilter weaker, never wrong.
+inline int charBit(uchar c) {
+  if (c >= 'a' && c <= 'z') {
+    return c - 'a';
+  }
+  if (c >= '0' && c <= '9') {
+    return 26 + (c - '0');
+  }
+  return 36 + (c % 28);
+}
+
+} // namespace
+
+FuzzyMatcher::FuzzyMatcher(const QString &pattern)
+    : pattern_(pattern.toUtf8()), lower_(toLowerAscii(pattern_)),
+      mask_(charMask(lower_.constData(), lower_.size())) {}
+
+int FuzzyMatcher::score(const char *text, const char *lower, int length,
+                        QVector<int> *positions) const {
+  if (positions) {
+    positions->clear();
+  }
+  const int patternLength = lower_.size();
+  if (patternLength == 0) {
+    return 1; // Empty pattern matches everything with low score
+  }
+  const char *pattern = lower_.constData();
+
+  // Leftmost match of the whole query...
+  int patternIndex = 0;
+  int start = -1;
+  int end = -1;
+  for (int i = 0; i < length; ++i) {
+    if (lower[i] == pattern[patternIndex]) {
+      if (start < 0) {
+        start = i;
+      }
+      if (++patternIndex == patternLength) {
+        end = i + 1;
+        break;
+      }
+    }
+  }
+  if (end < 0) {
+    return 0;
+  }
+
+  // ...shrunk from the right to the shortest span ending there
+  patternIndex = patternLength - 1;
+  for (int i = end - 1; i >= start; --i) {
+    if (lower[i] == pattern[patternIndex] && --patternIndex < 0) {
+      start = i;
+      break;
+    }
+  }
+
+  patternIndex = 0;
+  int score = 0;
+  int consecutive = 0;
+  int firstBonus = 0;
+  bool inGap = false;
+  CharClass prevClass = start > 0 ? classOf(text[start - 1]) : kInitialClass;
+  for (int i = start; i < end; ++i) {
+    CharClass charClass = classOf(text[i]);
+    if (lower[i] == pattern[patternIndex]) {
+      if (positions) {
+        positions->append(i);
+      }
+      int bonus = bonusFor(prevClass, charClass);
+      if (consecutive == 0) {
+        firstBonus = bonus;
+      } else {
+        // A run keeps the bonus of its first character, unless a
+        // stronger boundary starts a new run
+        if (bonus >= kBonusBoundary && bonus > firstBonus) {
+          firstBonus = bonus;
+        }
+        bonus = qMax(qMax(bonus, firstBonus), kBonusConsecutive);
+      }
+      score += kScoreMatch +
+               (patternIndex == 0 ? bonus * kBonusFirstCharMultiplier : bonus);
+      inGap = false;
+      ++consecutive;
+      ++patternIndex;
+    } else {
+      score += inGap ? kScoreGapExtension : kScoreGapStart;
+      inGap = true;
+      consecutive = 0;
+      firstBonus = 0;
+    }
+    prevClass = charClass;
+  }
+  return qMax(1, score);
+}
+
+int FuzzyMatcher::alignScore(const char *text, const char *lower, int length,
+                             QVector<int> *positions) const {
+  if (positions) {
+    positions->clear();
+  }
+  const int m = lower_.size();
+  if (m == 0) {
+    return 1;
+  }
+  const char *pattern = lower_.constData();
+
+  // Earliest position each query character can take; none of them can
+  // match further left
+  QVarLengthArray<int, 32> first(m);
+  int patternIndex = 0;
+  for (int i = 0; i < length && patternIndex < m; ++i) {
+    if (lower[i] == pattern[patternIndex]) {
+      first[patternIndex++] = i;
+    }
+  }
+  if (patternIndex < m) {
+    return 0;
+  }
+
+  // The last occurrence of the final character closes the window
+  int last = first[m - 1];
+  for (int i = length - 1; i > last; --i) {
+    if (lower[i] == pattern[m - 1]) {
+      last = i;
+      break;
+    }
+  }
+
+  const int minIndex = first[0];
+  const int width = last - minIndex + 1;
+  if (m > kMaxAlignPattern || qint64(m) * width > kMaxAlignCells) {
+    return score(text, lower, length, positions);
+  }
+
+  // H: best score with query[0..i] placed and query[i] at or before the
+  // column; C: length of the run of matches ending at the column
+  std::vector<qint16> h(size_t(m) * width, 0);
+  std::vector<qint16> c(size_t(m) * width, 0);
+  std::vector<qint16> bonuses(width);
+
+  int maxScore = 0;
+  int maxColumn = 0;
+
+  // First row, computing each column's boundary bonus on the way
+  CharClass prevClass =
+      minIndex > 0 ? classOf(text[minIndex - 1]) : kInitialClass;
+  bool inGap = false;
+  int prevScore = 0;
+  for (int col = 0; col < width; ++col) {
+    const int i = minIndex + col;
+    CharClass charClass = classOf(text[i]);
+    bonuses[col] = qint16(bonusFor(prevClass, charClass));
+    prevClass = charClass;
+
+    if (lower[i] == pattern[0]) {
+      int cell = kScoreMatch + bonuses[col] * kBonusFirstCharMultiplier;
+      h[col] = qint16(cell);
+      c[col] = 1;
+      if (m == 1 && cell > maxScore) {
+        maxScore = cell;
+        maxColumn = col;
+      }
+      inGap = false;
+    } else {
+      h[col] = qint16(qMax(
+          prevScore + (inGap ? kScoreGapExtension : kScoreGapStart), 0));
+      inGap = true;
+    }
+    prevScore = h[col];
+  }
+
+  // Remaining rows; each starts where its character first can match, so
+  // the columns read on the left and the diagonal always exist
+  for (int row = 1; row < m; ++row) {
+    qint16 *hRow = h.data() + size_t(row) * width;
+    const qint16 *hUp = hRow - width;
+    qint16 *cRow = c.data() + size_t(row) * width;
+    const qint16 *cUp = cRow - width;
+    const char p = pattern[row];
+
+    inGap = false;
+    for (int col = first[row] - minIndex; col < width; ++col) {
+      int viaGap =
+          hRow[col - 1] + (inGap ? kScoreGapExtension : kScoreGapStart);
+      int viaMatch = 0;
+      int consecutive = 0;
+      if (lower[minIndex + col] == p) {
+        viaMatch = hUp[col - 1] + kScoreMatch;
+        int bonus = bonuses[col];
+        consecutive = cUp[col - 1] + 1;
+        if (consecutive > 1) {
+          int runBonus = bonuses[col - consecutive + 1];
+          if (bonus >= kBonusBoundary && bonus > runBonus) {
+            consecutive = 1;
+          } else {
+            bonus = qMax(bonus, qMax(kBonusConsecutive, runBonus));
+          }
+        }
+        if (viaMatch + bonus < viaGap) {
+          viaMatch += bonuses[col];
+          consecutive = 0;
+        } else {
+          viaMatch += bonus;
+        }
+      }
+      cRow[col] = qint16(consecutive);
+      inGap = viaMatch < viaGap;
+      int cell = qMax(qMax(viaMatch, viaGap), 0);
+      hRow[col] = qint16(cell);
+      if (row == m - 1 && cell > maxScore) {
+        maxScore = cell;
+        maxColumn = col;
+      }
+    }
+  }
+
+  if (positions) {
+    // Walk back from the best cell, preferring to stay in runs
+    positions->resize(m);
+    int row = m - 1;
+    bool preferMatch = true;
+    for (int col = maxColumn; col >= 0; --col) {
+      const size_t at = size_t(row) * width + col;
+      const int firstColumn = first[row] - minIndex;
+      int cell = h[at];
+      int diagonal = (row > 0 && col >= firstColumn) ? h[at - width - 1] : 0;
+      int left = col > firstColumn ? h[at - 1] : 0;
+      if (cell > diagonal && (cell > left || (cell == left && preferMatch))) {
+        (*positions)[row] = minIndex + col;
+        if (row == 0) {
+          break;
+        }
+        --row;
+      }
+      preferMatch = c[at] > 1 || (at + width + 1 < c.size() &&
+                                  c[at + width + 1] > 0);
+    }
+  }
+  return qMax(1, maxScore);
+}
+
+QByteArray FuzzyMatcher::toLowerAscii(const QByteArray &utf8) {
+  QByteArray lower = utf8;
+  char *data = lower.data();
+  for (int i = 0; i < lower.size(); ++i) {
+    data[i] = lowerAscii(data[i]);
+  }
+  return lower;
+}
+
+quint64 FuzzyMatcher::charMask(const char *lower, int length) {
+  quint64 mask = 0;
+  for (int i = 0; i < length; ++i) {
+    mask |= quint64(1) << charBit(uchar(lower[i]));
+  }
+  return mask;
+}
+
+QVector<int> FuzzyMatcher::toStringPositions(const QByteArray &utf8,
+                                             const QVector<int> &bytePositions) {
+  QVector<int> result;
+  result.reserve(bytePositions.size());
+
+  // Walks the bytes once, counting UTF-16 units: four-byte sequences
+  // become surrogate pairs, continuation bytes add nothing
+  int byte = 0;
+  int unit = 0;
+  int charStart = 0;
+  for (int position : bytePositions) {
+    while (byte < position && byte < utf8.size()) {
+      uchar c = uchar(utf8[byte]);
+      if ((c & 0xC0) != 0x80) {
+        charStart = unit;
+        unit += (c >= 0xF0) ? 2 : 1;
+      }
+      ++byte;
+    }
+    uchar c = byte < utf8.size() ? uchar(utf8[byte]) : 0;
+    result.append((c & 0xC0) == 0x80 ? charStart : unit);
+  }
+  return result;
+}
+
+// ==================== FileSearchJob ====================
+
+FileSearchJob::FileSearchJob(const QString &pattern, const QStringList &files,
+                             const QVector<FileKey> &keys, int limit)
+    : pattern_(pattern), files_(files), keys_(keys), limit_(limit),
+      narrowed_(false), cancelled_(false) {}
+
+FileSearchJob::FileSearchJob(const QString &pattern, const QStringList &files,
+                             const QVector<FileKey> &keys, int limit,
+                             const QVector<int> &candidates)
+    : FileSearchJob(pattern, files, keys, limit) {
+  candidates_ = candidates;
+  narrowed_ = true;
+}
+
+void FileSearchJob::run() {
+  FuzzyMatcher matcher(pattern_);
+  const int count = narrowed_ ? candidates_.size() : keys_.size();
+  const int kept = limit_ * kRescoreFactor;
+  const int shards =
+      qBound(1, count / kMinShardSize, qMax(1, QThread::idealThreadCount()));
+
+  std::vector<std::vector<Candidate>> best(shards);
+  std::vector<QVector<int>> matched(shards);
+
+  runParallel(shards, [&](int s) {
+    int begin = int(qint64(count) * s / shards);
+    int end = int(qint64(count) * (s + 1) / shards);
+    scoreShard(matcher, begin, end, kept, best[s], matched[s]);
+  });
+
+  if (cancelled_) {
+    deleteLater();
+    return;
+  }
+
+  FileSearchResult result;
+  result.pattern = pattern_;
+  std::vector<Candidate> merged;
+  for (int s = 0; s < shards; ++s) {
+    merged.insert(merged.end(), best[s].begin(), best[s].end());
+    // Shards cover consecutive ranges, so this stays ascending
+    result.candidates += matched[s];
+  }
+  result.matched = result.candidates.size();
+  std::sort(merged.begin(), merged.end(),
+            [](const Candidate &a, const Candidate &b) {
+              return a.score != b.score ? a.score > b.score
+                                        : a.index < b.index;
+            });
+  if (int(merged.size()) > kept) {
+    merged.resize(kept);
+  }
+
+  // The survivors of the cheap pass get the best alignment; on equal
+  // scores shorter paths come first
+  for (Candidate &candidate : merged) {
+    const FileKey &key = keys_.at(candidate.index);
+    candidate.score = matcher.alignScore(
+        key.path.constData(), key.lower.constData(), key.path.size());
+  }
+  std::sort(merged.begin(), merged.end(),
+            [this](const Candidate &a, const Candidate &b) {
+              if (a.score != b.score) {
+                return a.score > b.score;
+              }
+              int aLength = keys_.at(a.index).path.size();
+              int bLength = keys_.at(b.index).path.size();
+              return aLength != bLength ? aLength < bLength
+                                        : a.index < b.index;
+            });
+  if (int(merged.size()) > limit_) {
+    merged.resize(limit_);
+  }
+
+  // Positions and strings only for the rows that are shown
+  result.matches.reserve(int(merged.size()));
+  for (const Candidate &candidate : merged) {
+    const FileKey &key = keys_.at(candidate.index);
+    QVector<int> positions;
+    matcher.alignScore(key.path.constData(), key.lower.constData(),
+                       key.path.size(), &positions);
+
+    FuzzyMatch match;
+    match.text = QString::fromUtf8(key.path);
+    match.filePath = files_.at(candidate.index);
+    match.score = candidate.score;
+    match.matchPositions = FuzzyMatcher::toStringPositions(key.path, positions);
+    result.matches.append(match);
+  }
+
+  emit finished(result);
+  deleteLater();
+}
+
+void FileSearchJob::scoreShard(const FuzzyMatcher &matcher, int begin,
+                               int end, int kept,
+                               std::vector<Candidate> &best,
+                               QVector<int> &matched) const {
+  // Heap ordered so the front is the worst candidate kept; on equal
+  // scores the earlier index ranks higher
+  auto ranksAbove = [](const Candidate &a, const Candidate &b) {
+    return a.score != b.score ? a.score > b.score : a.index < b.index;
+  };
+  best.reserve(kept + 1);
+
+  for (int n = begin; n < end; ++n) {
+    if ((n - begin) % kCancelCheckInterval == 0 && cancelled_) {
+      return;
+    }
+
+    const int i = narrowed_ ? candidates_.at(n) : n;
+    const FileKey &key = keys_.at(i);
+    if (!matcher.mayMatch(key.mask)) {
+      continue;
+    }
+    int score = matcher.score(key.path.constData(), key.lower.constData(),
+                              key.path.size());
+    if (score <= 0) {
+      continue;
+    }
+
+    matched.append(i);
+    if (int(best.size()) < kept) {
+      best.push_back({score, i});
+      std::push_heap(best.begin(), best.end(), ranksAbove);
+    } else if (kept > 0 && score > best.front().score) {
+      std::pop_heap(best.begin(), best.end(), ranksAbove);
+      best.back() = {score, i};
+      std::push_heap(best.begin(), best.end(), ranksAbove);
+    }
+  }
+}
@@ -0,0 +1,134 @@
+#include "gzipdevice.h"
+#include <QFile>
+#include <zlib.h>
+
+namespace {
+
+// Compressed bytes pulled from the source per refill
+const qint64 kInputChunk = 64 * 1024;
+
+// windowBits for inflateInit2(): 15-bit window, gzip header only
+const int kGzipWindowBits = 15 + 16;
+
+} // namespace
+
+struct GzipDevice::Stream {
+  z_stream z;
+  int members = 0; // Completed gzip members
+};
+
+GzipDevice::GzipDevice(QIODevice *source, QObject *parent)
+    : QIODevice(parent), source_(source), finished_(false), failed_(false) {}
+
+GzipDevice::~GzipDevice() { close(); }
+
+bool GzipDevice::isGzip(QIODevice *device) {
+  QByteArray magic = device->peek(2);
+  return magic.size() == 2 && uchar(magic[0]) == 0x1F &&
+         uchar(magic[1]) == 0x8B;
+}
+
+bool GzipDevice::isGzip(const QString &filePath) {
+  QFile file(filePath);
+  return file.open(QIODevice::ReadOnly) && isGzip(&file);
+}
+
+bool GzipDevice::open(OpenMode mode) {
+  if ((mode & QIODevice::WriteOnly) || !source_ || !source_->isReadable()) {
+    setErrorString("GzipDevice only supports reading");
+    return false;
+  }
+
+  stream_.reset(new Stream);
+  z_stream &z = stream_->z;
+  z.zalloc = Z_NULL;
+  z.zfree = Z_NULL;
+  z.opaque = Z_NULL;
+  z.next_in = Z_NULL;
+  z.avail_in = 0;
+  if (inflateInit2(&z, kGzipWindowBits) != Z_OK) {
+    stream_.reset();
+    setErrorString("Cannot initialize zlib");
+    return false;
+  }
+
+  finished_ = false;
+  failed_ = false;
+  input_.clear();
+  return QIODevice::open(mode);
+}
+
+void GzipDevice::close() {
+  if (stream_) {
+    inflateEnd(&stream_->z);
+    stream_.reset();
+  }
+  QIODevice::close();
+}
+
+bool GzipDevice::atEnd() const {
+  // The base class only knows about its own buffer
+  return finished_ && QIODevice::atEnd();
+}
+
+qint64 GzipDevice::readData(char *data, qint64 maxSize) {
+  if (finished_ || !stream_) {
+    return 0;
+  }
+
+  z_stream &z = stream_->z;
+  z.next_out = reinterpret_cast<Bytef *>(data);
+  z.avail_out = uInt(qMin<qint64>(maxSize, 1 << 30));
+  const uInt requested = z.avail_out;
+
+  // total_in and total_out count the current member only; inflateReset()
+  // clears them
+  while (z.avail_out > 0) {
+    if (z.avail_in == 0) {
+      input_ = source_->read(kInputChunk);
+      if (input_.isEmpty()) {
+        finished_ = true;
+        if (stream_->members > 0 && z.total_in == 0) {
+          break;
+        }
+        setErrorString(QStringLiteral("Truncated gzip data"));
+        failed_ = true;
+        break;
+      }
+      z.next_in = reinterpret_cast<Bytef *>(input_.data());
+      z.avail_in = uInt(input_.size());
+    }
+
+    int result = inflate(&z, Z_NO_FLUSH);
+    if (result == Z_STREAM_END) {
+      ++stream_->members;
+      if (z.avail_in == 0 && source_->atEnd()) {
+        finished_ = true;
+        break;
+      }
+      inflateReset(&z);
+    } else if (result != Z_OK && result != Z_BUF_ERROR) {
+      // Padding after a complete member is common; an error inside a
+      // member means the data is damaged
+      finished_ = true;
+      if (stream_->members > 0 && z.total_out == 0) {
+        break;
+      }
+      setErrorString(z.msg ? QString::fromLatin1(z.msg)
+                           : QStringLiteral("Corrupt gzip data"));
+      failed_ = true;
+      break;
+    }
+  }
+
+  // What was decoded before a failure is still handed out; callers check
+  // hasError() once the device is at its end
+  qint64 decoded = qint64(requested - z.avail_out);
+  return failed_ && decoded == 0 ? -1 : decoded;
+}
+
+qint64 GzipDevice::writeData(const char *data, qint64 size) {
+  Q_UNUSED(data)
+  Q_UNUSED(size)
+  return -1;
+}
@@ -0,0 +1,507 @@
+#include "hexview.h"
+#include "filetree.h"
+#include "gzipdevice.h"
+#include "largefile.h"
+#include "settings.h"
+#include "theme.h"
+#include <QFile>
+#include <QFileInfo>
+#include <QFontMetrics>
+#include <QInputDialog>
+#include <QKeyEvent>
+#include <QMessageBox>
+#include <QMouseEvent>
+#include <QPainter>
+#include <QScrollBar>
+#include <QThreadPool>
+#include <climits>
+
+#ifdef Q_OS_UNIX
+#include <string.h>
+#else
+#include <algorithm>
+#include <functional>
+#endif
+
+namespace {
+
+// Bytes checked for NULs when the name does not say binary
+const qint64 kSniffBytes = 8192;
+
+// Bytes searched between checks for cancellation
+const qint64 kSearchChunk = 64 * 1024 * 1024;
+
+const char kHexDigits[] = "0123456789abcdef";
+
+} // namespace
+
+// ==================== HexView ====================
+
+HexView::HexView(QWidget *parent)
+    : QAbstractScrollArea(parent), theme_(nullptr), cursor_(0),
+      selectionLength_(0), rowScale_(1), charWidth_(1), lineHeight_(1),
+      ascent_(0), offsetDigits_(8) {
+  Settings settings;
+  QFont font(settings.fontFamily(), settings.fontSize());
+  font.setStyleHint(QFont::Monospace);
+  font.setFixedPitch(true);
+  setFont(font);
+
+  setFocusPolicy(Qt::StrongFocus);
+  setHorizontalScrollBarPolicy(Qt::ScrollBarAlwaysOff);
+  updateMetrics();
+}
+
+HexView::~HexView() { cancelSearch(); }
+
+bool HexView::open(const QString &filePath) {
+  // deleteLater keeps the QObject's destruction on its own thread even if
+  // a search job drops the last reference
+  std::shared_ptr<MappedFile> mapping(new MappedFile(filePath),
+                                      [](MappedFile *m) { m->deleteLater(); });
+  if (!mapping->isValid()) {
+    return false;
+  }
+
+  cancelSearch();
+  mapping_ = mapping;
+  filePath_ = filePath;
+
+  // Offsets past 4 GB need more than eight digits
+  offsetDigits_ = 8;
+  for (qint64 size = mapping_->size() >> 32; size > 0; size >>= 4) {
+    ++offsetDigits_;
+  }
+
+  updateScrollBar();
+  verticalScrollBar()->setValue(0);
+  setCursorOffset(0);
+  return true;
+}
+
+void HexView::close() {
+  cancelSearch();
+  mapping_.reset();
+  filePath_.clear();
+  cursor_ = 0;
+  selectionLength_ = 0;
+  updateScrollBar();
+  viewport()->update();
+}
+
+qint64 HexView::size() const { return mapping_ ? mapping_->size() : 0; }
+
+void HexView::setTheme(Theme *theme) {
+  theme_ = theme;
+  viewport()->update();
+}
+
+void HexView::goToOffset(qint64 offset) {
+  setCursorOffset(offset);
+
+  // Jumps land in the middle of the view rather than at its edge
+  qint64 row = cursor_ / kBytesPerRow;
+  qint64 top = qMax<qint64>(0, row - visibleRows() / 2);
+  verticalScrollBar()->setValue(int(top / rowScale_));
+}
+
+void HexView::find(const QByteArray &pattern) {
+  if (pattern.isEmpty()) {
+    return;
+  }
+  pattern_ = pattern;
+  startSearch(cursor_);
+}
+
+void HexView::findNext() {
+  if (pattern_.isEmpty()) {
+    promptFind();
+    return;
+  }
+  startSearch(cursor_ + 1);
+}
+
+QByteArray HexView::parsePattern(const QString &text) {
+  if (text.size() >= 2 && text.startsWith(QLatin1Char('"')) &&
+      text.endsWith(QLatin1Char('"'))) {
+    return text.mid(1, text.size() - 2).toUtf8();
+  }
+
+  QString digits = text.simplified();
+  if (digits.startsWith("0x", Qt::CaseInsensitive)) {
+    digits = digits.mid(2);
+  }
+  digits.remove(QLatin1Char(' '));
+
+  bool isHex = !digits.isEmpty() && digits.size() % 2 == 0;
+  for (QChar c : digits) {
+    QChar lower = c.toLower();
+    if (!c.isDigit() && (lower < QLatin1Char('a') || lower > QLatin1Char('f'))) {
+      isHex = false;
+      break;
+    }
+  }
+  return isHex ? QByteArray::fromHex(digits.toLatin1()) : text.toUtf8();
+}
+
+bool HexView::isBinaryFile(const QString &filePath) {
+  QFileInfo info(filePath);
+  if (!info.isFile()) {
+    return false;
+  }
+
+  QFile file(filePath);
+  if (!file.open(QIODevice::ReadOnly)) {
+    return false;
+  }
+
+  // Compressed text streams through FileLoader instead; tarballs and
+  // other compressed binaries are judged by their inflated head
+  if (GzipDevice::isGzip(&file)) {
+    GzipDevice gzip(&file);
+    if (!gzip.open(QIODevice::ReadOnly)) {
+      return true;
+    }
+    QByteArray head = gzip.read(kSniffBytes);
+    return gzip.hasError() || head.contains('\0');
+  }
+
+  FileType type = FileTreeItem::typeOf(info);
+  if (type == FileType::Binary || type == FileType::Archive) {
+    return true;
+  }
+  return file.read(kSniffBytes).contains('\0');
+}
+
+bool HexView::event(QEvent *event) {
+  // Keep the view's own shortcuts from triggering editor menu actions
+  if (event->type() == QEvent::ShortcutOverride) {
+    QKeyEvent *key = static_cast<QKeyEvent *>(event);
+    bool control = key->modifiers() & Qt::ControlModifier;
+    if ((control && (key->key() == Qt::Key_G || key->key() == Qt::Key_F)) ||
+        key->key() == Qt::Key_F3) {
+      event->accept();
+      return true;
+    }
+  }
+  return QAbstractScrollArea::event(event);
+}
+
+void HexView::paintEvent(QPaintEvent *event) {
+  QPainter painter(viewport());
+
+  QColor background =
+      theme_ ? theme_->editorBackground() : palette().color(QPalette::Base);
+  QColor foreground =
+      theme_ ? theme_->editorForeground() : palette().color(QPalette::Text);
+  QColor dimmed = theme_ ? theme_->lineNumberForeground()
+                         : palette().color(QPalette::Disabled, QPalette::Text);
+  QColor selection = theme_ ? theme_->editorSelection()
+                            : palette().color(QPalette::Highlight);
+
+  painter.fillRect(event->rect(), background);
+  if (!mapping_ || mapping_->size() == 0) {
+    return;
+  }
+
+  const uchar *data = reinterpret_cast<const uchar *>(mapping_->data());
+  const qint64 size = mapping_->size();
+  const qint64 rows = rowCount();
+  const qint64 first = firstVisibleRow();
+  const int margin = charWidth_ / 2;
+  const int hexX = margin + (offsetDigits_ + 2) * charWidth_;
+  const int asciiX = hexX + (kBytesPerRow * 3 + 2) * charWidth_;
+  auto hexColumn = [](int i) { return i * 3 + (i >= kBytesPerRow / 2); };
+
+  // Only the rows intersecting the exposed rectangle are formatted
+  int top = event->rect().top() / lineHeight_;
+  int bottom = event->rect().bottom() / lineHeight_;
+
+  QString hex(kBytesPerRow * 3 + 1, QLatin1Char(' '));
+  QString ascii(kBytesPerRow, QLatin1Char(' '));
+  for (int r = top; r <= bottom && first + r < rows; ++r) {
+    qint64 offset = (first + r) * kBytesPerRow;
+    int count = int(qMin<qint64>(kBytesPerRow, size - offset));
+    int y = r * lineHeight_;
+
+    qint64 selectionEnd = cursor_ + selectionLength_;
+    if (selectionLength_ > 0 && cursor_ < offset + count &&
+        selectionEnd > offset) {
+      int from = int(qMax(cursor_, offset) - offset);
+      int to = int(qMin(selectionEnd, offset + count) - offset);
+      painter.fillRect(hexX + hexColumn(from) * charWidth_, y,
+                       (hexColumn(to - 1) + 2 - hexColumn(from)) * charWidth_,
+                       lineHeight_, selection);
+      painter.fillRect(asciiX + from * charWidth_, y,
+                       (to - from) * charWidth_, lineHeight_, selection);
+    }
+
+    hex.fill(QLatin1Char(' '));
+    ascii.fill(QLatin1Char(' '));
+    for (int i = 0; i < count; ++i) {
+      uchar byte = data[offset + i];
+      hex[hexColumn(i)] = QLatin1Char(kHexDigits[byte >> 4]);
+      hex[hexColumn(i) + 1] = QLatin1Char(kHexDigits[byte & 0xF]);
+      ascii[i] = byte >= 0x20 && byte < 0x7F ? QLatin1Char(char(byte))
+                                              : QLatin1Char('.');
+    }
+
+    painter.setPen(dimmed);
+    painter.drawText(margin, y + ascent_,
+                     QString("%1").arg(offset, offsetDigits_, 16,
+                                       QLatin1Char('0')));
+    painter.setPen(foreground);
+    painter.drawText(hexX, y + ascent_, hex);
+    painter.drawText(asciiX, y + ascent_, ascii);
+  }
+}
+
+void HexView::resizeEvent(QResizeEvent *event) {
+  QAbstractScrollArea::resizeEvent(event);
+  updateScrollBar();
+}
+
+void HexView::keyPressEvent(QKeyEvent *event) {
+  bool control = event->modifiers() & Qt::ControlModifier;
+  qint64 page = qint64(visibleRows()) * kBytesPerRow;
+  qint64 rowStart = cursor_ - cursor_ % kBytesPerRow;
+
+  if (control && event->key() == Qt::Key_G) {
+    promptGoTo();
+  } else if (control && event->key() == Qt::Key_F) {
+    promptFind();
+  } else if (event->key() == Qt::Key_F3) {
+    findNext();
+  } else if (event->key() == Qt::Key_Escape && search_) {
+    cancelSearch();
+    emit searchFinished(-1);
+  } else if (event->key() == Qt::Key_Left) {
+    setCursorOffset(cursor_ - 1);
+  } else if (event->key() == Qt::Key_Right) {
+    setCursorOffset(cursor_ + 1);
+  } else if (event->key() == Qt::Key_Up) {
+    setCursorOffset(cursor_ - kBytesPerRow);
+  } else if (event->key() == Qt::Key_Down) {
+    setCursorOffset(cursor_ + kBytesPerRow);
+  } else if (event->key() == Qt::Key_PageUp) {
+    setCursorOffset(cursor_ - page);
+  } else if (event->key() == Qt::Key_PageDown) {
+    setCursorOffset(cursor_ + page);
+  } else if (event->key() == Qt::Key_Home) {
+    setCursorOffset(control ? 0 : rowStart);
+  } else if (event->key() == Qt::Key_End) {
+    setCursorOffset(control ? size() - 1 : rowStart + kBytesPerRow - 1);
+  } else {
+    QAbstractScrollArea::keyPressEvent(event);
+  }
+}
+
+void HexView::mousePressEvent(QMouseEvent *event) {
+  qint64 offset = offsetAt(event->pos());
+  if (offset >= 0) {
+    setCursorOffset(offset);
+  }
+}
+
+void HexView::changeEvent(QEvent *event) {
+  QAbstractScrollArea::changeEvent(event);
+  if (event->type() == QEvent::FontChange) {
+    updateMetrics();
+    updateScrollBar();
+    viewport()->update();
+  }
+}
+
+void HexView::onSearchFinished(qint64 offset) {
+  if (sender() != search_) {
+    return; // Cancelled in favour of a newer search
+  }
+  search_ = nullptr;
+
+  if (offset >= 0) {
+    setCursorOffset(offset, pattern_.size());
+  }
+  emit searchFinished(offset);
+}
+
+qint64 HexView::rowCount() const {
+  return (size() + kBytesPerRow - 1) / kBytesPerRow;
+}
+
+qint64 HexView::firstVisibleRow() const {
+  qint64 last = qMax<qint64>(0, rowCount() - visibleRows());
+  return qMin(qint64(verticalScrollBar()->value()) * rowScale_, last);
+}
+
+int HexView::visibleRows() const {
+  return qMax(1, viewport()->height() / lineHeight_);
+}
+
+void HexView::updateMetrics() {
+  QFontMetrics metrics(font());
+  charWidth_ = qMax(1, metrics.horizontalAdvance(QLatin1Char('0')));
+  lineHeight_ = qMax(1, metrics.height());
+  ascent_ = metrics.ascent();
+}
+
+void HexView::updateScrollBar() {
+  qint64 maxRow = qMax<qint64>(0, rowCount() - visibleRows());
+  rowScale_ = maxRow / INT_MAX + 1;
+
+  QScrollBar *scrollBar = verticalScrollBar();
+  scrollBar->setRange(0, int((maxRow + rowScale_ - 1) / rowScale_));
+  scrollBar->setPageStep(qMax(1, int(visibleRows() / rowScale_)));
+  scrollBar->setSingleStep(1);
+}
+
+void HexView::ensureVisible(qint64 offset) {
+  qint64 row = offset / kBytesPerRow;
+  qint64 first = firstVisibleRow();
+  if (row < first) {
+    verticalScrollBar()->setValue(int(row / rowScale_));
+  } else if (row >= first + visibleRows()) {
+    qint64 top = row - visibleRows() + 1;
+    verticalScrollBar()->setValue(int((top + rowScale_ - 1) / rowScale_));
+  }
+}
+
+void HexView::setCursorOffset(qint64 offset, qint64 selectionLength) {
+  qint64 last = qMax<qint64>(0, size() - 1);
+  cursor_ = qBound<qint64>(0, offset, last);
+  selectionLength_ = size() > 0 ? qMin(selectionLength, size() - cursor_) : 0;
+
+  ensureVisible(cursor_);
+  viewport()->update();
+  emit cursorMoved(cursor_);
+}
+
+qint64 HexView::offsetAt(const QPoint &pos) const {
+  const int margin = charWidth_ / 2;
+  int column = (pos.x() - margin) / charWidth_ - (offsetDigits_ + 2);
+  int asciiColumn = column - (kBytesPerRow * 3 + 2);
+
+  int index;
+  if (asciiColumn >= 0) {
+    index = asciiColumn;
+  } else if (column >= 0) {
+    // The second half of the hex column is one character further right
+    int half = kBytesPerRow / 2 * 3;
+    index = column < half ? column / 3 : (column - 1) / 3;
+  } else {
+    return -1;
+  }
+  if (index >= kBytesPerRow) {
+    return -1;
+  }
+
+  qint64 row = firstVisibleRow() + pos.y() / lineHeight_;
+  qint64 offset = row * kBytesPerRow + index;
+  return offset < size() ? offset : -1;
+}
+
+void HexView::startSearch(qint64 from) {
+  cancelSearch();
+  if (size() == 0) {
+    emit searchFinished(-1);
+    return;
+  }
+
+  HexSearchJob *job = new HexSearchJob(mapping_, pattern_, from % size());
+  connect(job, &HexSearchJob::finished, this, &HexView::onSearchFinished,
+          Qt::QueuedConnection);
+  search_ = job;
+  QThreadPool::globalInstance()->start(job);
+}
+
+void HexView::cancelSearch() {
+  if (search_) {
+    search_->cancel();
+    search_ = nullptr;
+  }
+}
+
+void HexView::promptGoTo() {
+  bool ok = false;
+  QString text = QInputDialog::getText(
+      this, "Go to Offset", "Offset (decimal, or hex with 0x):",
+      QLineEdit::Normal, QString("0x%1").arg(cursor_, 0, 16), &ok);
+  if (!ok || text.trimmed().isEmpty()) {
+    return;
+  }
+
+  text = text.trimmed();
+  bool hex = text.startsWith("0x", Qt::CaseInsensitive);
+  qint64 offset = hex ? text.mid(2).toLongLong(&ok, 16) : text.toLongLong(&ok);
+  if (!ok || offset < 0) {
+    QMessageBox::warning(this, "Go to Offset",
+                         QString("Invalid offset: %1").arg(text));
+    return;
+  }
+  goToOffset(offset);
+}
+
+void HexView::promptFind() {
+  bool ok = false;
+  QString text = QInputDialog::getText(
+      this, "Find Bytes", "Hex bytes (de ad be ef) or text (\"quoted\"):",
+      QLineEdit::Normal, QString::fromLatin1(pattern_.toHex(' ')), &ok);
+  if (ok && !text.isEmpty()) {
+    find(parsePattern(text));
+  }
+}
+
+// ==================== HexSearchJob ====================
+
+HexSearchJob::HexSearchJob(std::shared_ptr<MappedFile> mapping,
+                           const QByteArray &pattern, qint64 from)
+    : mapping_(std::move(mapping)), pattern_(pattern), from_(from),
+      cancelled_(false) {}
+
+void HexSearchJob::run() {
+  qint64 size = mapping_->size();
+  qint64 found = searchRange(from_, size);
+  if (found < 0) {
+    // Wrap around; matches straddling the start offset count too
+    found = searchRange(0, qMin(size, from_ + pattern_.size() - 1));
+  }
+
+  if (!cancelled_) {
+    emit finished(found);
+  }
+  deleteLater();
+}
+
+qint64 HexSearchJob::searchRange(qint64 from, qint64 to) const {
+  // Chunks overlap by the pattern length so no match is split
+  const char *data = mapping_->data();
+  for (qint64 start = from; start < to && !cancelled_; start += kSearchChunk) {
+    qint64 end = qMin(to, start + kSearchChunk + pattern_.size() - 1);
+    qint64 found = search(data, start, end, pattern_);
+    if (found >= 0) {
+      return found;
+    }
+  }
+  return -1;
+}
+
+qint64 HexSearchJob::search(const char *data, qint64 from, qint64 to,
+                            const QByteArray &needle) {
+  if (needle.isEmpty() || to - from < needle.size()) {
+    return -1;
+  }
+
+#ifdef Q_OS_UNIX
+  // glibc's memmem is a vectorized two-way search
+  const void *hit = memmem(data + from, size_t(to - from), needle.constData(),
+                           size_t(needle.size()));
+  return hit ? static_cast<const char *>(hit) - data : -1;
+#else
+  const char *begin = data + from;
+  const char *end = data + to;
+  const char *hit = std::search(
+      begin, end,
+      std::boyer_moore_horspool_searcher<const char *>(needle.constBegin(),
+                                                       needle.constEnd()));
+  return hit == end ? -1 : hit - data;
+#endif
+}
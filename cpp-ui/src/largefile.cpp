@@ -0,0 +1,479 @@
+#include "largefile.h"
+#include "codeeditor.h"
+#include "fileloader.h"
+#include "gzipdevice.h"
+#include "settings.h"
+#include <QFileInfo>
+#include <QMetaObject>
+#include <QSaveFile>
+#include <QScrollBar>
+#include <QTextBlock>
+#include <QTextDocument>
+#include <QThreadPool>
+#include <cstring>
+
+// ==================== MappedFile ====================
+
+MappedFile::MappedFile(const QString &path)
+    : cancelled(false), file_(path), data_(nullptr), size_(0) {
+  if (file_.open(QIODevice::ReadOnly)) {
+    size_ = file_.size();
+    if (size_ > 0) {
+      data_ = file_.map(0, size_);
+    }
+  }
+}
+
+MappedFile::~MappedFile() {
+  if (data_) {
+    file_.unmap(data_);
+  }
+}
+
+// ==================== LargeFileBuffer ====================
+
+LargeFileBuffer::LargeFileBuffer(QObject *parent)
+    : QObject(parent), size_(0), indexed_(false), modified_(false),
+      crlf_(false) {}
+
+LargeFileBuffer::~LargeFileBuffer() {
+  if (mapping_) {
+    mapping_->cancelled = true;
+  }
+}
+
+bool LargeFileBuffer::isLargeFile(const QString &filePath) {
+  // Compressed files stream into a normal buffer; the piece table needs
+  // the text on disk
+  qint64 size = QFileInfo(filePath).size();
+  qint64 threshold = qint64(Settings().largeFileThresholdMB()) * 1024 * 1024;
+  return ((threshold > 0 && size >= threshold) ||
+          size > FileLoader::kMaxTextBytes) &&
+         !GzipDevice::isGzip(filePath);
+}
+
+bool LargeFileBuffer::open(const QString &filePath) {
+  // deleteLater keeps the QObject's destruction on its own thread even if
+  // an indexing job drops the last reference
+  std::shared_ptr<MappedFile> mapping(new MappedFile(filePath),
+                                      [](MappedFile *m) { m->deleteLater(); });
+  if (!mapping->isValid()) {
+    return false;
+  }
+
+  if (mapping_) {
+    mapping_->cancelled = true;
+  }
+  mapping_ = mapping;
+  filePath_ = filePath;
+  size_ = mapping_->size();
+  added_.clear();
+  pieces_.clear();
+  if (size_ > 0) {
+    pieces_.append({Original, 0, size_});
+  }
+  lineStarts_.clear();
+  lineStarts_.append(0);
+  indexed_ = false;
+  modified_ = false;
+
+  const char *data = mapping_->data();
+  const char *newline =
+      size_ > 0 ? static_cast<const char *>(std::memchr(data, '\n', size_))
+                : nullptr;
+  crlf_ = newline && newline > data && newline[-1] == '\r';
+
+  connect(mapping_.get(), &MappedFile::chunkIndexed, this,
+          &LargeFileBuffer::onChunkIndexed);
+  startIndexing();
+  return true;
+}
+
+// Scan the mapping for newlines in fixed-size chunks on the thread pool.
+// Each chunk's line starts are handed back on the owner's thread.
+void LargeFileBuffer::startIndexing() {
+  std::shared_ptr<MappedFile> mapping = mapping_;
+  QThreadPool::globalInstance()->start([mapping]() {
+    const qint64 chunkSize = 16 * 1024 * 1024;
+    const char *base = mapping->data();
+    qint64 position = 0;
+
+    do {
+      qint64 end = qMin(position + chunkSize, mapping->size());
+      QVector<qint64> starts;
+      const char *p = base + position;
+      const char *stop = base + end;
+      while (p < stop) {
+        p = static_cast<const char *>(std::memchr(p, '\n', stop - p));
+        if (!p) {
+          break;
+        }
+        ++p;
+        starts.append(p - base);
+      }
+
+      position = end;
+      bool finished = position >= mapping->size();
+      MappedFile *target = mapping.get();
+      QMetaObject::invokeMethod(
+          target,
+          [mapping, starts, finished]() {
+            emit mapping->chunkIndexed(starts, finished);
+          },
+          Qt::QueuedConnection);
+    } while (position < mapping->size() && !mapping->cancelled);
+  });
+}
+
+void LargeFileBuffer::onChunkIndexed(const QVector<qint64> &lineStarts,
+                                     bool finished) {
+  if (sender() != mapping_.get()) {
+    return; // Stale job from a previous open()
+  }
+
+  lineStarts_ += lineStarts;
+  emit indexProgress(lineStarts_.size());
+
+  if (finished) {
+    indexed_ = true;
+    emit indexingFinished();
+  }
+}
+
+qint64 LargeFileBuffer::lineEnd(int line) const {
+  return line + 1 < lineStarts_.size() ? lineStarts_[line + 1] : size_;
+}
+
+QByteArray LargeFileBuffer::read(qint64 position, qint64 length) const {
+  QByteArray result;
+  result.reserve(int(length));
+
+  qint64 start = 0;
+  qint64 end = position + length;
+  for (const Piece &piece : pieces_) {
+    qint64 pieceEnd = start + piece.length;
+    if (pieceEnd > position && start < end) {
+      qint64 from = qMax(position, start) - start;
+      qint64 to = qMin(end, pieceEnd) - start;
+      const char *source = piece.source == Original ? mapping_->data()
+                                                    : added_.constData();
+      result.append(source + piece.offset + from, int(to - from));
+    }
+    if (pieceEnd >= end) {
+      break;
+    }
+    start = pieceEnd;
+  }
+  return result;
+}
+
+// Classic piece-table edit: split the pieces around [position,
+// position + removed) and splice in one piece referencing the add buffer.
+void LargeFileBuffer::replace(qint64 position, qint64 removed,
+                              const QByteArray &bytes) {
+  Piece addition = {Added, qint64(added_.size()), qint64(bytes.size())};
+  added_.append(bytes);
+
+  QVector<Piece> result;
+  result.reserve(pieces_.size() + 2);
+  qint64 end = position + removed;
+  qint64 start = 0;
+  bool inserted = false;
+
+  for (const Piece &piece : pieces_) {
+    qint64 pieceEnd = start + piece.length;
+
+    if (start < position) {
+      qint64 keep = qMin(pieceEnd, position) - start;
+      result.append({piece.source, piece.offset, keep});
+    }
+    if (!inserted && pieceEnd >= position) {
+      if (addition.length > 0) {
+        result.append(addition);
+      }
+      inserted = true;
+    }
+    if (pieceEnd > end) {
+      qint64 skip = qMax(end, start) - start;
+      result.append({piece.source, piece.offset + skip, piece.length - skip});
+    }
+
+    start = pieceEnd;
+  }
+  if (!inserted && addition.length > 0) {
+    result.append(addition);
+  }
+
+  pieces_ = result;
+  size_ += bytes.size() - removed;
+  modified_ = true;
+}
+
+QString LargeFileBuffer::lines(int first, int count) const {
+  if (first < 0 || first >= lineStarts_.size() || count <= 0) {
+    return QString();
+  }
+
+  int last = qMin(first + count, lineStarts_.size()) - 1;
+  qint64 from = lineStarts_[first];
+  qint64 to = lineEnd(last);
+  QByteArray bytes = read(from, to - from);
+
+  // Drop the terminator of the last materialized line
+  if (bytes.endsWith('\n')) {
+    bytes.chop(1);
+  }
+  if (crlf_) {
+    bytes.replace("\r\n", "\n");
+    if (bytes.endsWith('\r')) {
+      bytes.chop(1);
+    }
+  }
+  return QString::fromUtf8(bytes);
+}
+
+void LargeFileBuffer::replaceLines(int first, int count, const QString &text) {
+  if (!indexed_ || first < 0 || first >= lineStarts_.size()) {
+    return;
+  }
+
+  int last = qMin(first + count, lineStarts_.size()) - 1;
+  bool atEnd = last + 1 >= lineStarts_.size();
+  qint64 from = lineStarts_[first];
+  qint64 to = lineEnd(last);
+
+  const QByteArray newline = crlf_ ? QByteArray("\r\n") : QByteArray("\n");
+  QByteArray bytes = text.toUtf8();
+  if (crlf_) {
+    bytes.replace("\n", "\r\n");
+  }
+  if (!atEnd) {
+    bytes.append(newline);
+  }
+
+  replace(from, to - from, bytes);
+
+  // Splice the new line starts in and shift everything after the edit
+  QVector<qint64> starts;
+  starts.append(from);
+  int scanEnd = atEnd ? bytes.size() : bytes.size() - newline.size();
+  for (int i = 0; i < scanEnd; ++i) {
+    if (bytes.at(i) == '\n') {
+      starts.append(from + i + 1);
+    }
+  }
+
+  qint64 delta = bytes.size() - (to - from);
+  QVector<qint64> updated;
+  updated.reserve(lineStarts_.size() - (last - first + 1) + starts.size());
+  updated.append(lineStarts_.mid(0, first));
+  updated += starts;
+  for (int i = last + 1; i < lineStarts_.size(); ++i) {
+    updated.append(lineStarts_[i] + delta);
+  }
+  lineStarts_ = updated;
+}
+
+bool LargeFileBuffer::save(const QString &filePath, QString *errorString) {
+  QSaveFile file(filePath);
+  if (!file.open(QIODevice::WriteOnly)) {
+    if (errorString) {
+      *errorString = file.errorString();
+    }
+    return false;
+  }
+
+  for (const Piece &piece : pieces_) {
+    const char *source =
+        piece.source == Original ? mapping_->data() : added_.constData();
+    if (file.write(source + piece.offset, piece.length) != piece.length) {
+      if (errorString) {
+        *errorString = file.errorString();
+      }
+      file.cancelWriting();
+      return false;
+    }
+  }
+
+  if (!file.commit()) {
+    if (errorString) {
+      *errorString = file.errorString();
+    }
+    return false;
+  }
+
+  // The old mapping stays valid after the rename, so pieces keep working
+  filePath_ = filePath;
+  modified_ = false;
+  return true;
+}
+
+// ==================== LargeFileController ====================
+
+LargeFileController::LargeFileController(CodeEditor *editor,
+                                         LargeFileBuffer *buffer)
+    : QObject(editor), editor_(editor), buffer_(buffer),
+      scrollBar_(new QScrollBar(Qt::Vertical, editor)),
+      wrapMode_(editor->lineWrapMode()),
+      folding_(editor->isCodeFoldingEnabled()), windowFirst_(0),
+      windowCount_(0), windowDirty_(false), loading_(false) {
+  buffer_->setParent(this);
+
+  // Reduced mode: no wrapping (scroll lines map 1:1 to blocks), no folding,
+  // read-only until the line index is complete.
+  editor_->setLineWrapMode(QPlainTextEdit::NoWrap);
+  editor_->enableCodeFolding(false);
+  editor_->setVerticalScrollBarPolicy(Qt::ScrollBarAlwaysOff);
+  editor_->setReadOnly(true);
+
+  connect(buffer_, &LargeFileBuffer::indexProgress, this,
+          &LargeFileController::onIndexProgress);
+  connect(buffer_, &LargeFileBuffer::indexingFinished, this,
+          &LargeFileController::onIndexingFinished);
+  connect(scrollBar_, &QScrollBar::valueChanged, this,
+          &LargeFileController::onScrollBarMoved);
+  connect(editor_->verticalScrollBar(), &QScrollBar::valueChanged, this,
+          &LargeFileController::onEditorScrolled);
+  connect(editor_->document(), &QTextDocument::contentsChange, this,
+          &LargeFileController::onContentsChange);
+
+  editor_->setLargeFileController(this);
+}
+
+void LargeFileController::detach() {
+  disconnect(buffer_, nullptr, this, nullptr);
+  disconnect(editor_->verticalScrollBar(), nullptr, this, nullptr);
+  disconnect(editor_->document(), nullptr, this, nullptr);
+  delete scrollBar_;
+  scrollBar_ = nullptr;
+
+  editor_->setLargeFileController(nullptr);
+  editor_->setLineNumberOffset(0);
+  editor_->clear();
+  editor_->setLineWrapMode(QPlainTextEdit::LineWrapMode(wrapMode_));
+  editor_->enableCodeFolding(folding_);
+  editor_->setVerticalScrollBarPolicy(Qt::ScrollBarAsNeeded);
+  editor_->setReadOnly(false);
+}
+
+void LargeFileController::onIndexProgress(int lineCount) {
+  Q_UNUSED(lineCount)
+  updateScrollRange();
+
+  // Show the first screen as soon as the first chunk is indexed
+  if (windowCount_ == 0) {
+    loadWindow(0, 0);
+  }
+}
+
+void LargeFileController::onIndexingFinished() {
+  updateScrollRange();
+
+  // Reload in case the first window was cut short by a partial index
+  if (windowCount_ < windowLines()) {
+    loadWindow(windowFirst_, editor_->verticalScrollBar()->value());
+  }
+  editor_->setReadOnly(false);
+}
+
+void LargeFileController::updateScrollRange() {
+  int visible = editor_->viewport()->height() /
+                qMax(1, editor_->fontMetrics().height());
+  scrollBar_->blockSignals(true);
+  scrollBar_->setRange(0, qMax(0, buffer_->lineCount() - visible));
+  scrollBar_->setPageStep(visible);
+  scrollBar_->blockSignals(false);
+}
+
+void LargeFileController::loadWindow(int firstLine, int topLine) {
+  int total = buffer_->lineCount();
+  firstLine = qBound(0, firstLine, qMax(0, total - windowLines()));
+
+  // Keep the cursor on the same file line when it survives the move
+  int cursorLine = windowFirst_ + editor_->textCursor().blockNumber();
+  int cursorColumn = editor_->textCursor().positionInBlock();
+
+  loading_ = true;
+  editor_->setPlainText(buffer_->lines(firstLine, windowLines()));
+  editor_->setLineNumberOffset(firstLine);
+  windowFirst_ = firstLine;
+  windowCount_ = editor_->document()->blockCount();
+  windowDirty_ = false;
+
+  // Window loads must not clear the tab's modified state
+  editor_->document()->setModified(buffer_->isModified());
+  loading_ = false;
+
+  if (cursorLine >= windowFirst_ && cursorLine < windowFirst_ + windowCount_) {
+    QTextBlock block =
+        editor_->document()->findBlockByNumber(cursorLine - windowFirst_);
+    QTextCursor cursor(block);
+    cursor.setPosition(block.position() +
+                       qMin(cursorColumn, block.length() - 1));
+    editor_->setTextCursor(cursor);
+  }
+
+  editor_->verticalScrollBar()->setValue(topLine - windowFirst_);
+}
+
+void LargeFileController::flushWindow() {
+  if (!windowDirty_) {
+    return;
+  }
+  buffer_->replaceLines(windowFirst_, windowCount_, editor_->toPlainText());
+  windowCount_ = editor_->document()->blockCount();
+  windowDirty_ = false;
+  updateScrollRange();
+}
+
+void LargeFileController::onContentsChange(int position, int charsRemoved,
+                                           int charsAdded) {
+  Q_UNUSED(position)
+  if (!loading_ && (charsRemoved || charsAdded)) {
+    windowDirty_ = true;
+  }
+}
+
+void LargeFileController::onScrollBarMoved(int value) {
+  int visible = scrollBar_->pageStep();
+  if (value >= windowFirst_ && value + visible <= windowFirst_ + windowCount_) {
+    editor_->verticalScrollBar()->setValue(value - windowFirst_);
+    return;
+  }
+
+  flushWindow();
+  loadWindow(value - windowLines() / 4, value);
+}
+
+// The editor scrolled inside its window: mirror the position on the file
+// scrollbar and recenter the window once the view gets close to its edge.
+void LargeFileController::onEditorScrolled(int value) {
+  if (loading_) {
+    return;
+  }
+
+  int top = windowFirst_ + value;
+  scrollBar_->blockSignals(true);
+  scrollBar_->setValue(top);
+  scrollBar_->blockSignals(false);
+
+  int margin = windowLines() / 8;
+  int visible = scrollBar_->pageStep();
+  bool nearTop = value < margin && windowFirst_ > 0;
+  bool nearBottom = value + visible > windowCount_ - margin &&
+                    windowFirst_ + windowCount_ < buffer_->lineCount();
+  if (nearTop || nearBottom) {
+    flushWindow();
+    loadWindow(top - windowLines() / 2, top);
+  }
+}
+
+bool LargeFileController::save(const QString &filePath,
+                               QString *errorString) {
+  flushWindow();
+  if (!buffer_->save(filePath, errorString)) {
+    return false;
+  }
+  editor_->document()->setModified(false);
+  return true;
+}
@@ -1,15 +1,20 @@
 #include "mainwindow.h"
 #include "codeeditor.h"
+#include "documentmodel.h"
+#include "editjournal.h"
 #include "codefolding.h"
 #include "commandhelper.h"
 #include "featurepanel.h"
 #include "filetree.h"
 #include "fuzzyfinder.h"
+#include "hexview.h"
+#include "largefile.h"
 #include "markdownpreview.h"
 #include "regexhelper.h"
 #include "searchdialog.h"
 #include "shellchecker.h"
 #include "syntaxhighlighter.h"
+#include "tailfollower.h"
 #include "tabwidget.h"
 #include "theme.h"
 #include "vimmode.h"
@@ -30,27 +35,35 @@
 #include <QProcess>
 #include <QPushButton>
 #include <QRegularExpression>
+#include <QScrollBar>
 #include <QSpinBox>
 #include <QTemporaryFile>
 #include <QTextBlock>
 #include <QTextCharFormat>
 #include <QTextCursor>
 #include <QTextDocument>
+#include <QTextLayout>
 #include <QTextStream>
 #include <QTimer>
 #include <QVBoxLayout>
 
 MainWindow::MainWindow(QWidget *parent)
-    : QMainWindow(parent), editor_(nullptr), preview_(nullptr),
+    : QMainWindow(parent), tabWidget_(nullptr), editor_(nullptr),
+      preview_(nullptr),
       splitter_(nullptr), isModified_(false), isPreviewMode_(false),
       parser_(std::make_unique<CyberMD::Parser>()), highlighter_(nullptr),
       syntaxHighlighter_(nullptr), statusLabel_(nullptr), settings_(),
       recentFilesMenu_(nullptr), searchDialog_(nullptr), regexHelper_(nullptr),
-      commandHelper_(nullptr), shellChecker_(nullptr), vimMode_(nullptr),
+      commandHelper_(nullptr), shellChecker_(nullptr), fuzzyFinder_(nullptr),
+      vimMode_(nullptr),
       vimModeLabel_(nullptr), fileTypeLabel_(nullptr), lineCountLabel_(nullptr),
       errorCountLabel_(nullptr), fileTree_(nullptr), featurePanel_(nullptr),
       currentTheme_(nullptr), mainSplitter_(nullptr), shellCheckTimer_(nullptr),
-      shellCheckProcess_(nullptr), isShellCheckEnabled_(true) {
+      shellCheckProcess_(nullptr), isShellCheckEnabled_(true),
+      fileLoader_(nullptr), fileSaver_(nullptr),
+      currentLineEnding_(LineEnding::LF), currentHasBom_(false),
+      fileWatcher_(nullptr),
+      journal_(nullptr) {
   qDebug() << "=== MainWindow Constructor Start ===";
 
   // Initialize theme system
@@ -86,6 +99,32 @@ MainWindow::MainWindow(QWidget *parent)
   regexHelper_ = new RegexHelper(this);
   commandHelper_ = new CommandHelper(this);
   shellChecker_ = new ShellChecker(this);
+  setupFuzzyFinder();
+
+  // Files are read and decoded on the thread pool
+  fileLoader_ = new FileLoader(this);
+  connect(fileLoader_, &FileLoader::fileLoaded, this,
+          &MainWindow::onFileLoaded);
+  connect(fileLoader_, &FileLoader::chunkLoaded, this,
+          &MainWindow::onFileChunkLoaded);
+  connect(fileLoader_, &FileLoader::loadFailed, this,
+          &MainWindow::onFileLoadFailed);
+
+  // Saves write a snapshot atomically on the thread pool
+  fileSaver_ = new FileSaver(this);
+  connect(fileSaver_, &FileSaver::saved, this, &MainWindow::onFileSaved);
+  connect(fileSaver_, &FileSaver::saveFailed, this,
+          &MainWindow::onFileSaveFailed);
+
+  // Files changed by other programs are reloaded as a minimal diff
+  fileWatcher_ = new FileWatcher(this);
+  connect(fileWatcher_, &FileWatcher::fileChanged, this,
+          &MainWindow::onFileChangedOnDisk);
+  connect(fileWatcher_, &FileWatcher::reloadReady, this,
+          &MainWindow::onReloadReady);
+
+  // Unsaved edits are journaled for crash recovery
+  journal_ = new EditJournal(editor_->document());
 
   // Make The Editor Read And Write
   editor_->setReadOnly(false);
@@ -128,6 +167,9 @@ MainWindow::MainWindow(QWidget *parent)
   updateStatusBar();
   qDebug() << "Status bar updated";
 
+  // Offer to recover buffers left behind by a crashed session
+  QTimer::singleShot(0, this, &MainWindow::recoverJournals);
+
   qDebug() << "=== MainWindow Constructor Complete ===";
 }
 
@@ -161,6 +203,15 @@ void MainWindow::setupUI() {
   preview_->setVisible(false);
   centerLayout->addWidget(preview_);
 
+  // Binary files replace the editor with a hex view (initially hidden)
+  hexView_ = new HexView(centerWidget);
+  hexView_->setVisible(false);
+  centerLayout->addWidget(hexView_);
+  connect(hexView_, &HexView::cursorMoved, this,
+          &MainWindow::onHexCursorMoved);
+  connect(hexView_, &HexView::searchFinished, this,
+          &MainWindow::onHexSearchFinished);
+
   mainSplitter_->addWidget(centerWidget);
 
   // RIGHT SIDE: Feature panel
@@ -299,6 +350,24 @@ void MainWindow::setupMenuBar() {
   connect(gotoLineAction, &QAction::triggered, this,
           &MainWindow::showGoToLineDialog);
 
+  QAction *fileSearchAction = editMenu->addAction("Go to &File...");
+  fileSearchAction->setShortcut(Qt::CTRL | Qt::Key_P);
+  fileSearchAction->setToolTip("Open a file in the folder by fuzzy name (Ctrl+P)");
+  connect(fileSearchAction, &QAction::triggered, this,
+          &MainWindow::showFuzzyFileSearch);
+
+  QAction *contentSearchAction = editMenu->addAction("Find in &Folder...");
+  contentSearchAction->setShortcut(Qt::CTRL | Qt::ALT | Qt::Key_F);
+  contentSearchAction->setToolTip("Search the contents of the files in the folder");
+  connect(contentSearchAction, &QAction::triggered, this,
+          &MainWindow::showFuzzyContentSearch);
+
+  QAction *bufferSearchAction = editMenu->addAction("Find in Open &Buffers...");
+  bufferSearchAction->setShortcut(Qt::CTRL | Qt::SHIFT | Qt::Key_F);
+  bufferSearchAction->setToolTip("Search the open text, unsaved edits included");
+  connect(bufferSearchAction, &QAction::triggered, this,
+          &MainWindow::showFuzzyBufferContentSearch);
+
   // View menu
   QMenu *viewMenu = menuBar()->addMenu("&View");
 
@@ -325,6 +394,23 @@ void MainWindow::setupMenuBar() {
   vimModeAction->setChecked(false);
   connect(vimModeAction, &QAction::toggled, this, &MainWindow::toggleVimMode);
 
+  QAction *minimapAction = viewMenu->addAction("Show Mini&map");
+  minimapAction->setCheckable(true);
+  minimapAction->setChecked(minimapEnabled_);
+  connect(minimapAction, &QAction::toggled, this, &MainWindow::toggleMinimap);
+
+  viewMenu->addSeparator();
+
+  followAction_ = viewMenu->addAction("&Follow File");
+  followAction_->setCheckable(true);
+  followAction_->setToolTip("Show lines appended to the file as they are written");
+  connect(followAction_, &QAction::toggled, this,
+          &MainWindow::toggleFollowMode);
+
+  QAction *followFilterAction = viewMenu->addAction("Filter Followed &Lines...");
+  connect(followFilterAction, &QAction::triggered, this,
+          &MainWindow::setFollowFilter);
+
   viewMenu->addSeparator();
 
   // Theme submenu
@@ -333,8 +419,9 @@ void MainWindow::setupMenuBar() {
   viewMenu->addSeparator();
 
   QAction *toggleViewAction = viewMenu->addAction("Toggle &Preview");
-  toggleViewAction->setShortcut(Qt::CTRL | Qt::Key_P);
-  toggleViewAction->setToolTip("Toggle between edit and preview mode (Ctrl+P)");
+  toggleViewAction->setShortcut(Qt::CTRL | Qt::SHIFT | Qt::Key_V);
+  toggleViewAction->setToolTip(
+      "Toggle between edit and preview mode (Ctrl+Shift+V)");
   connect(toggleViewAction, &QAction::triggered, this,
           &MainWindow::toggleViewMode);
 
@@ -488,7 +575,10 @@ void MainWindow::updateStatusBar() {
 }
 
 void MainWindow::newFile() {
-  if (isModified_) {
+  // Window loads of a large file replace the text without modifying it
+  bool modified = editor_->isLargeFileMode() ? editor_->document()->isModified()
+                                             : isModified_;
+  if (modified) {
     QMessageBox::StandardButton reply;
     reply = QMessageBox::question(
         this, "Unsaved Changes", "Do you want to save your changes?",
@@ -501,9 +591,23 @@ void MainWindow::newFile() {
     }
   }
 
+  if (follower_) {
+    followAction_->setChecked(false);
+  }
+  hideHexView();
+  closeLargeFile();
   editor_->clear();
+  if (currentCompressed_) {
+    currentCompressed_ = false;
+    editor_->setReadOnly(false);
+    editor_->document()->setUndoRedoEnabled(true);
+  }
+  fileWatcher_->unwatch(currentFile_);
   currentFile_ = QString();
+  currentLineEnding_ = LineEnding::LF;
+  currentHasBom_ = false;
   isModified_ = false;
+  journal_->rebase(QString());
   setWindowTitle("CyberMD - Markdown Editor");
   statusBar()->showMessage("New file created");
 }
@@ -532,20 +636,88 @@ void MainWindow::openRecentFile() {
 }
 
 void MainWindow::openFileByPath(const QString &fileName) {
-  QFile file(fileName);
-  if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
-    QMessageBox::critical(this, "Error", "Could not open file: " + fileName);
+  // Binary files would come out as garbage text
+  if (HexView::isBinaryFile(fileName)) {
+    showHexView(fileName);
+    return;
+  }
+  if (LargeFileBuffer::isLargeFile(fileName)) {
+    openLargeFile(fileName);
     return;
   }
 
-  QTextStream in(&file);
-  editor_->setPlainText(in.readAll());
-  file.close();
+  // The most recent request wins if several loads overlap
+  pendingFile_ = fileName;
+  editor_->setReadOnly(true);
+  statusBar()->showMessage("Loading " + fileName + "...");
+  fileLoader_->load(fileName);
+}
 
+void MainWindow::onFileLoadFailed(const QString &fileName,
+                                  const QString &error) {
+  if (fileName != pendingFile_) {
+    return;
+  }
+  pendingFile_.clear();
+  // Partly streamed compressed text stays a read-only view
+  editor_->setReadOnly(currentCompressed_);
+  statusBar()->clearMessage();
+  QMessageBox::critical(this, "Error",
+                        "Could not open file: " + fileName + "\n" + error);
+}
+
+void MainWindow::onFileLoaded(const QString &fileName,
+                              const LoadedText &text) {
+  if (fileName != pendingFile_) {
+    return;
+  }
+  pendingFile_.clear();
+
+  if (follower_) {
+    followAction_->setChecked(false);
+  }
+  hideHexView();
+  closeLargeFile();
+  fileWatcher_->unwatch(currentFile_);
+  if (text.compressed) {
+    // Already in the editor through onFileChunkLoaded(); there is nothing
+    // to diff a reload against, and nothing to journal in a read-only view
+    editor_->document()->setModified(false);
+    journal_->discard();
+  } else {
+    editor_->setPlainText(text.text);
+    editor_->setReadOnly(false);
+    editor_->document()->setUndoRedoEnabled(true);
+    fileWatcher_->watch(fileName, text.disk);
+    journal_->rebase(fileName);
+  }
+  currentCompressed_ = text.compressed;
   currentFile_ = fileName;
+  currentLineEnding_ = text.lineEnding;
+  currentHasBom_ = text.hasBom;
   isModified_ = false;
-  setWindowTitle("CyberMD - " + QFileInfo(fileName).fileName());
-  statusBar()->showMessage("File opened: " + fileName);
+  statusBar()->showMessage(text.compressed
+                               ? "File opened read-only: " + fileName
+                               : "File opened: " + fileName);
+  showFileInfo(fileName);
+  if (pendingSession_.filePath == fileName) {
+    applySession(pendingSession_);
+  }
+  pendingSession_ = SessionTab();
+  if (jumpFile_ == fileName) {
+    goToLine(jumpLine_);
+  }
+  jumpFile_.clear();
+
+  // Add to recent files
+  settings_.addRecentFile(fileName);
+  updateRecentFilesMenu();
+}
+
+void MainWindow::showFileInfo(const QString &fileName) {
+  setWindowTitle(fileName.isEmpty()
+                     ? QString("CyberMD - Markdown Editor")
+                     : "CyberMD - " + QFileInfo(fileName).fileName());
 
   // Apply syntax highlighting based on file type
   applySyntaxHighlighter(fileName);
@@ -566,31 +738,313 @@ void MainWindow::openFileByPath(const QString &fileName) {
     fileType = "Rust";
   }
   fileTypeLabel_->setText(fileType);
+}
 
-  // Add to recent files
+void MainWindow::onFileChunkLoaded(const QString &fileName,
+                                   const QString &text, bool first) {
+  if (fileName != pendingFile_) {
+    return;
+  }
+
+  if (first) {
+    if (follower_) {
+      followAction_->setChecked(false);
+    }
+    // The editor now shows this file, even if the rest fails to inflate
+    hideHexView();
+    closeLargeFile();
+    fileWatcher_->unwatch(currentFile_);
+    currentFile_ = fileName;
+    currentCompressed_ = true;
+    editor_->document()->setUndoRedoEnabled(false);
+    editor_->clear();
+    setWindowTitle("CyberMD - " + QFileInfo(fileName).fileName());
+  }
+
+  // The text so far is readable while the rest is still inflating
+  QTextCursor cursor(editor_->document());
+  cursor.movePosition(QTextCursor::End);
+  cursor.insertText(text);
+  editor_->document()->setModified(false);
+  journal_->discard();
+}
+
+void MainWindow::showHexView(const QString &fileName) {
+  if (!hexView_->open(fileName)) {
+    QMessageBox::critical(this, "Error", "Could not map file: " + fileName);
+    return;
+  }
+
+  // A text load still in flight would replace the view when it lands
+  if (!pendingFile_.isEmpty()) {
+    pendingFile_.clear();
+    editor_->setReadOnly(currentCompressed_ || follower_);
+  }
+
+  // editor_ keeps its buffer; currentFile_ still refers to it
+  editor_->setVisible(false);
+  preview_->setVisible(false);
+  hexView_->setVisible(true);
+  hexView_->setFocus();
+
+  setWindowTitle("CyberMD - " + QFileInfo(fileName).fileName());
+  fileTypeLabel_->setText("Binary");
+  statusBar()->showMessage(QString("Opened %1 read-only (%2 bytes)")
+                               .arg(fileName)
+                               .arg(hexView_->size()));
   settings_.addRecentFile(fileName);
   updateRecentFilesMenu();
 }
 
+void MainWindow::openLargeFile(const QString &fileName) {
+  LargeFileBuffer *buffer = new LargeFileBuffer;
+  if (!buffer->open(fileName)) {
+    // An editor without its buffer would show empty text, and a save
+    // would write that over the file
+    delete buffer;
+    QMessageBox::critical(this, "Error", "Could not map file: " + fileName);
+    return;
+  }
+
+  if (follower_) {
+    followAction_->setChecked(false);
+  }
+  // A text load still in flight would replace the window when it lands
+  pendingFile_.clear();
+  hideHexView();
+  closeLargeFile();
+  fileWatcher_->unwatch(currentFile_);
+  // Document positions are window positions, not file positions
+  journal_->suspend();
+  if (currentCompressed_) {
+    currentCompressed_ = false;
+    editor_->document()->setUndoRedoEnabled(true);
+  }
+
+  new LargeFileController(editor_, buffer);
+  currentFile_ = fileName;
+  currentLineEnding_ = LineEnding::LF; // The piece table keeps the file's
+  currentHasBom_ = false;
+  isModified_ = false;
+  setWindowTitle("CyberMD - " + QFileInfo(fileName).fileName());
+  statusBar()->showMessage("Large file opened: " + fileName);
+  applySyntaxHighlighter(fileName);
+
+  settings_.addRecentFile(fileName);
+  updateRecentFilesMenu();
+}
+
+void MainWindow::closeLargeFile() {
+  LargeFileController *large = editor_->largeFileController();
+  if (!large) {
+    return;
+  }
+  large->detach();
+  delete large;
+}
+
+void MainWindow::hideHexView() {
+  if (!hexView_->isVisible()) {
+    return;
+  }
+  hexView_->close();
+  hexView_->setVisible(false);
+  editor_->setVisible(!isPreviewMode_);
+  preview_->setVisible(isPreviewMode_);
+  editor_->setFocus();
+}
+
+void MainWindow::onHexCursorMoved(qint64 offset) {
+  statusBar()->showMessage(QString("Offset 0x%1 (%2) of %3 bytes")
+                               .arg(offset, 0, 16)
+                               .arg(offset)
+                               .arg(hexView_->size()));
+}
+
+void MainWindow::onHexSearchFinished(qint64 offset) {
+  if (offset < 0) {
+    statusBar()->showMessage("Byte pattern not found", 3000);
+  } else {
+    statusBar()->showMessage(QString("Found at offset 0x%1 (%2)")
+                                 .arg(offset, 0, 16)
+                                 .arg(offset));
+  }
+}
+
 void MainWindow::saveFile() {
   if (currentFile_.isEmpty()) {
     saveFileAs();
     return;
   }
 
-  QFile file(currentFile_);
-  if (!file.open(QIODevice::WriteOnly | QIODevice::Text)) {
-    QMessageBox::critical(this, "Error",
-                          "Could not save file: " + currentFile_);
+  if (LargeFileController *large = editor_->largeFileController()) {
+    // The piece table writes the mapping and the edits in one pass
+    QString error;
+    if (!large->save(currentFile_, &error)) {
+      QMessageBox::critical(this, "Error", "Could not save file: " +
+                                               currentFile_ + "\n" + error);
+      return;
+    }
+    isModified_ = false;
+    statusBar()->showMessage("File saved: " + currentFile_);
+    return;
+  }
+
+  if (currentCompressed_) {
+    QMessageBox::information(
+        this, "Save",
+        QFileInfo(currentFile_).fileName() +
+            " is compressed and was opened read-only.\n"
+            "Use Save As to write the uncompressed text.");
+    return;
+  }
+
+  if (!FileSaver::resolveLineEnding(this, currentFile_, &currentLineEnding_)) {
+    return;
+  }
+
+  // The editor stays usable while the snapshot is encoded and written
+  fileSaver_->save(currentFile_, editor_->toPlainText(), currentLineEnding_,
+                   currentHasBom_, editor_->document()->revision());
+  statusBar()->showMessage("Saving " + currentFile_ + "...");
+}
+
+void MainWindow::onFileSaved(const QString &fileName, int revision) {
+  if (fileName == currentFile_) {
+    fileWatcher_->watch(fileName, DiskState::read(fileName));
+    if (editor_->document()->revision() == revision) {
+      isModified_ = false;
+      editor_->document()->setModified(false);
+      journal_->rebase(fileName);
+    } else {
+      // Typed during the write: the old base is gone, keep full text
+      journal_->writeSnapshot();
+    }
+  }
+  statusBar()->showMessage("File saved: " + fileName);
+}
+
+void MainWindow::onFileChangedOnDisk(const QString &fileName) {
+  if (fileName != currentFile_ || fileSaver_->isSaving(fileName)) {
+    return;
+  }
+
+  // The dialog spins an event loop; don't stack a second one
+  static bool asking = false;
+  bool incremental = true;
+  if (editor_->document()->isModified()) {
+    if (asking) {
+      return;
+    }
+    asking = true;
+    QMessageBox::StandardButton reply = QMessageBox::question(
+        this, "File Changed",
+        QFileInfo(fileName).fileName() +
+            " was changed on disk. Reload it and discard your changes?",
+        QMessageBox::Yes | QMessageBox::No);
+    asking = false;
+    if (reply != QMessageBox::Yes) {
+      fileWatcher_->acknowledge(fileName);
+      return;
+    }
+    incremental = false;
+  }
+
+  fileWatcher_->reload(fileName, editor_->toPlainText(),
+                       editor_->document()->revision(), incremental);
+}
+
+void MainWindow::onReloadReady(const QString &fileName,
+                               const ReloadResult &result) {
+  if (fileName != currentFile_) {
     return;
   }
 
-  QTextStream out(&file);
-  out << editor_->toPlainText();
-  file.close();
+  // Typed while the file was being diffed; diff again
+  QTextDocument *document = editor_->document();
+  if (document->revision() != result.revision) {
+    fileWatcher_->reload(fileName, editor_->toPlainText(), document->revision(),
+                         !document->isModified());
+    return;
+  }
 
+  FileWatcher::apply(document, result);
+  if (!result.appended) {
+    currentLineEnding_ = result.lineEnding;
+    currentHasBom_ = result.hasBom;
+  }
+  document->setModified(false);
   isModified_ = false;
-  statusBar()->showMessage("File saved: " + currentFile_);
+  journal_->rebase(fileName);
+  fileWatcher_->watch(fileName, result.disk);
+  statusBar()->showMessage("Reloaded " + fileName, 3000);
+}
+
+void MainWindow::recoverJournals() {
+  const QStringList journals = EditJournal::orphanedJournals();
+  if (journals.isEmpty()) {
+    return;
+  }
+
+  QMessageBox::StandardButton reply = QMessageBox::question(
+      this, "Recover Unsaved Changes",
+      QString("CyberMD did not exit cleanly. Recover unsaved changes to "
+              "%1 file(s)?")
+          .arg(journals.size()),
+      QMessageBox::Yes | QMessageBox::No);
+
+  bool editorUsed = false;
+  for (const QString &journalPath : journals) {
+    if (reply == QMessageBox::Yes) {
+      QString filePath;
+      QString text;
+      QString error;
+      if (!EditJournal::replay(journalPath, &filePath, &text, &error)) {
+        qWarning() << "Cannot replay" << journalPath << error;
+        continue;
+      }
+
+      if (tabWidget_) {
+        tabWidget_->openRecovered(filePath, text);
+      } else if (!editorUsed) {
+        // Same state as a fresh load, except that the text is unsaved. A
+        // file load still in flight would replace it when it lands.
+        pendingFile_.clear();
+        hideHexView();
+        closeLargeFile();
+        fileWatcher_->unwatch(currentFile_);
+        editor_->setPlainText(text);
+        editor_->setReadOnly(false);
+        editor_->document()->setUndoRedoEnabled(true);
+        currentFile_ = filePath;
+        currentLineEnding_ = LineEnding::LF;
+        currentHasBom_ = false;
+        currentCompressed_ = false;
+        journal_->rebase(filePath);
+        journal_->writeSnapshot();
+        editor_->document()->setModified(true);
+        isModified_ = true;
+        showFileInfo(filePath);
+        statusBar()->showMessage("Recovered unsaved changes: " +
+                                 (filePath.isEmpty() ? QString("Untitled")
+                                                     : filePath));
+        editorUsed = true;
+      } else {
+        // Single editor already holds a recovered buffer; keep this
+        // journal for the next launch
+        continue;
+      }
+    }
+    QFile::remove(journalPath);
+  }
+}
+
+void MainWindow::onFileSaveFailed(const QString &fileName, int revision,
+                                  const QString &error) {
+  Q_UNUSED(revision)
+  statusBar()->clearMessage();
+  QMessageBox::critical(this, "Error",
+                        "Could not save file: " + fileName + "\n" + error);
 }
 
 void MainWindow::saveFileAs() {
@@ -601,9 +1055,50 @@ void MainWindow::saveFileAs() {
   if (fileName.isEmpty())
     return;
 
+  if (LargeFileController *large = editor_->largeFileController()) {
+    // The piece table stays on the original mapping; only the title and
+    // later saves move to the new path
+    QString error;
+    if (!large->save(fileName, &error)) {
+      QMessageBox::critical(this, "Error", "Could not save file: " +
+                                               fileName + "\n" + error);
+      return;
+    }
+    currentFile_ = fileName;
+    statusBar()->showMessage("File saved: " + fileName);
+    setWindowTitle("CyberMD - " + QFileInfo(fileName).fileName());
+    return;
+  }
+
+  // Written before returning: the editor only moves to the new path, and
+  // lets go of the old one, once the file is there
+  if (!FileSaver::resolveLineEnding(this, fileName, &currentLineEnding_)) {
+    return;
+  }
+  QString error;
+  if (!fileSaver_->saveNow(fileName, editor_->toPlainText(), currentLineEnding_,
+                           currentHasBom_, &error)) {
+    QMessageBox::critical(this, "Error",
+                          "Could not save file: " + fileName + "\n" + error);
+    return;
+  }
+
+  if (fileName != currentFile_) {
+    fileWatcher_->unwatch(currentFile_);
+  }
+  if (currentCompressed_) {
+    // The saved copy is plain text and can be edited from here on
+    currentCompressed_ = false;
+    editor_->setReadOnly(false);
+    editor_->document()->setUndoRedoEnabled(true);
+  }
   currentFile_ = fileName;
-  saveFile();
+  fileWatcher_->watch(fileName, DiskState::read(fileName));
+  isModified_ = false;
+  editor_->document()->setModified(false);
+  journal_->rebase(fileName);
   setWindowTitle("CyberMD - " + QFileInfo(fileName).fileName());
+  statusBar()->showMessage("File saved: " + fileName);
 }
 
 void MainWindow::about() {
@@ -699,74 +1194,79 @@ QColor MainWindow::getColorForToken(uint32_t tokenType) {
 }
 
 void MainWindow::applyHighlighting(
-    const std::vector<CyberMD::HighlightRange> &ranges) {
+    CodeEditor *editor, const std::vector<CyberMD::HighlightRange> &ranges) {
   // Safety checks
-  if (!editor_) {
+  if (!editor) {
     return;
   }
 
-  QTextDocument *doc = editor_->document();
+  QTextDocument *doc = editor->document();
   if (!doc) {
     return;
   }
 
-  // Clear previous formatting
-  QTextCursor cursor(doc);
-  cursor.select(QTextCursor::Document);
-  QTextCharFormat defaultFormat;
-  defaultFormat.setForeground(currentTheme_ ? currentTheme_->editorForeground()
-                                            : QColor("#D4D4D4"));
-  cursor.setCharFormat(defaultFormat);
+  // The formats go to the Markdown highlighter as layout formats. Setting
+  // char formats would be a document edit: it bumps the revision, lands
+  // on the undo stack and gets journaled like typing.
+  MarkdownHighlighter *markdown = doc->findChild<MarkdownHighlighter *>(
+      QString(), Qt::FindDirectChildrenOnly);
+  if (!markdown) {
+    return;
+  }
 
-  // Apply each highlight range
+  // Ranges are split at line ends, one list per block
+  QVector<QVector<QTextLayout::FormatRange>> blocks(doc->blockCount());
   for (const auto &range : ranges) {
-    QTextBlock startBlock = doc->findBlockByLineNumber(range.start_line);
-    QTextBlock endBlock = doc->findBlockByLineNumber(range.end_line);
-
-    if (!startBlock.isValid() || !endBlock.isValid()) {
+    int startLine = int(range.start_line);
+    int endLine = int(range.end_line);
+    if (startLine < 0 || endLine < startLine || endLine >= blocks.size()) {
       continue;
     }
 
-    int startPos = startBlock.position() + range.start_col;
-    int endPos = endBlock.position() + range.end_col;
-
-    if (startPos >= 0 && endPos >= startPos) {
-      QTextCursor highlightCursor(doc);
-      highlightCursor.setPosition(startPos);
-      highlightCursor.setPosition(endPos, QTextCursor::KeepAnchor);
+    QTextCharFormat format;
+    format.setForeground(getColorForToken(range.token_type));
 
-      QTextCharFormat format;
-      format.setForeground(getColorForToken(range.token_type));
+    // Make headings bold and slightly larger
+    if (range.token_type >= TOKEN_HEADING1 &&
+        range.token_type <= TOKEN_HEADING6) {
+      format.setFontWeight(QFont::Bold);
+      int sizeIncrease = 7 - (range.token_type - TOKEN_HEADING1);
+      format.setFontPointSize(11 + sizeIncrease);
+    }
 
-      // Make headings bold and slightly larger
-      if (range.token_type >= TOKEN_HEADING1 &&
-          range.token_type <= TOKEN_HEADING6) {
-        format.setFontWeight(QFont::Bold);
-        int sizeIncrease = 7 - (range.token_type - TOKEN_HEADING1);
-        format.setFontPointSize(11 + sizeIncrease);
-      }
+    // Make bold text bold
+    if (range.token_type == TOKEN_BOLD) {
+      format.setFontWeight(QFont::Bold);
+    }
 
-      // Make bold text bold
-      if (range.token_type == TOKEN_BOLD) {
-        format.setFontWeight(QFont::Bold);
-      }
+    // Make italic text italic
+    if (range.token_type == TOKEN_ITALIC) {
+      format.setFontItalic(true);
+    }
 
-      // Make italic text italic
-      if (range.token_type == TOKEN_ITALIC) {
-        format.setFontItalic(true);
-      }
+    // Add background for code
+    if (range.token_type == TOKEN_CODE_BLOCK ||
+        range.token_type == TOKEN_INLINE_CODE) {
+      format.setBackground(currentTheme_
+                               ? currentTheme_->syntaxCodeBackground()
+                               : QColor("#1E1E1E"));
+    }
 
-      // Add background for code
-      if (range.token_type == TOKEN_CODE_BLOCK ||
-          range.token_type == TOKEN_INLINE_CODE) {
-        format.setBackground(currentTheme_
-                                 ? currentTheme_->syntaxCodeBackground()
-                                 : QColor("#1E1E1E"));
+    for (int line = startLine; line <= endLine; ++line) {
+      int from = line == startLine ? int(range.start_col) : 0;
+      int to = line == endLine ? int(range.end_col)
+                               : doc->findBlockByNumber(line).length() - 1;
+      if (to > from) {
+        QTextLayout::FormatRange part;
+        part.start = from;
+        part.length = to - from;
+        part.format = format;
+        blocks[line].append(part);
       }
-
-      highlightCursor.mergeCharFormat(format);
     }
   }
+
+  markdown->setParsedFormats(blocks, doc->revision());
 }
 
 void MainWindow::updateHighlighting() {
@@ -776,34 +1276,36 @@ void MainWindow::updateHighlighting() {
   }
 
   // Check if editor is valid
-  if (!editor_) {
+  CodeEditor *editor = activeEditor();
+  if (!editor) {
     return;
   }
 
   // Only use Rust parser for Markdown files
   // For other files, Qt syntax highlighters handle everything
-  QFileInfo fileInfo(currentFile_);
+  QString filePath = activeFilePath();
+  QFileInfo fileInfo(filePath);
   QString extension = fileInfo.suffix().toLower();
 
   // Skip Rust highlighter if not a Markdown file or if no file is open
-  if (currentFile_.isEmpty() ||
-      (extension != "md" && extension != "markdown")) {
+  if (filePath.isEmpty() || (extension != "md" && extension != "markdown")) {
     return; // Qt syntax highlighter handles it
   }
 
-  // Parse the document (Markdown only)
-  QString text = editor_->toPlainText();
+  // The document keeps its formats, so an unchanged tab needs no work
+  DocumentModel *model = DocumentModel::of(editor->document());
+  if (model->isCurrent() && model->highlightsApplied()) {
+    return;
+  }
 
   try {
-    CAST *ast = parser_->parse(text.toStdString());
-    if (ast) {
-      CyberMD::AST astWrapper(ast);
-
-      // Get highlight ranges
-      auto ranges = highlighter_->highlight(astWrapper.get());
+    model->refresh(*parser_);
+    if (model->ast()) {
+      const auto &ranges = model->highlights(*highlighter_);
 
       // Apply highlights to editor
-      applyHighlighting(ranges);
+      applyHighlighting(editor, ranges);
+      model->markHighlightsApplied();
 
       statusBar()->showMessage(
           QString("Parsed successfully - %1 highlight ranges")
@@ -814,9 +1316,17 @@ void MainWindow::updateHighlighting() {
   }
 }
 
+void MainWindow::reapplyHighlighting() {
+  CodeEditor *editor = activeEditor();
+  if (editor) {
+    DocumentModel::of(editor->document())->invalidateFormats();
+  }
+  updateHighlighting();
+}
+
 void MainWindow::updateOutline() {
   // TODO: Implement outline update
-  // This would populate a sidebar with document structure
+  // This would populate a sidebar from DocumentModel::outline()
 }
 
 void MainWindow::loadSettings() {
@@ -830,12 +1340,84 @@ void MainWindow::loadSettings() {
   if (!state.isEmpty()) {
     restoreState(state);
   }
+
+  // Restored tabs stay placeholders until they are first activated
+  if (tabWidget_) {
+    tabWidget_->restoreSession(settings_.sessionTabs(),
+                               settings_.sessionActiveTab());
+  } else {
+    // The single editor reopens the file that was active
+    QVector<SessionTab> tabs = settings_.sessionTabs();
+    int active = settings_.sessionActiveTab();
+    if (active >= 0 && active < tabs.size() &&
+        QFileInfo::exists(tabs[active].filePath)) {
+      pendingSession_ = tabs[active];
+      openFileByPath(pendingSession_.filePath);
+    }
+  }
 }
 
 void MainWindow::saveSettings() {
   // Save window geometry
   settings_.setWindowGeometry(saveGeometry());
   settings_.setWindowState(saveState());
+
+  if (tabWidget_) {
+    int activeTab = 0;
+    QVector<SessionTab> tabs = tabWidget_->sessionState(&activeTab);
+    settings_.setSession(tabs, activeTab);
+  } else {
+    // Before the restored file has loaded, keep the state it was saved with
+    QVector<SessionTab> tabs;
+    if (!pendingSession_.filePath.isEmpty() &&
+        pendingFile_ == pendingSession_.filePath) {
+      tabs.append(pendingSession_);
+    } else if (!currentFile_.isEmpty()) {
+      tabs.append(captureSession());
+    }
+    settings_.setSession(tabs, 0);
+  }
+}
+
+SessionTab MainWindow::captureSession() const {
+  SessionTab session;
+  session.filePath = currentFile_;
+  if (!editor_->isLargeFileMode()) {
+    session.cursorPosition = editor_->textCursor().position();
+    session.firstVisibleLine = editor_->getFirstVisibleBlock().blockNumber();
+    if (editor_->codeFolding()) {
+      const QMap<int, FoldRegion> &regions =
+          editor_->codeFolding()->regions();
+      for (auto it = regions.begin(); it != regions.end(); ++it) {
+        if (it->isFolded) {
+          session.foldedLines.append(it.key());
+        }
+      }
+    }
+  }
+  return session;
+}
+
+void MainWindow::applySession(const SessionTab &session) {
+  if (editor_->isLargeFileMode()) {
+    return;
+  }
+
+  if (editor_->codeFolding() && !session.foldedLines.isEmpty()) {
+    CodeFolding *folding = editor_->codeFolding();
+    folding->analyzeFoldRegions();
+    for (int line : session.foldedLines) {
+      if (folding->isFoldable(line) && !folding->isFolded(line)) {
+        folding->toggleFoldAtLine(line);
+      }
+    }
+  }
+
+  QTextCursor cursor(editor_->document());
+  cursor.setPosition(qBound(0, session.cursorPosition,
+                            editor_->document()->characterCount() - 1));
+  editor_->setTextCursor(cursor);
+  editor_->verticalScrollBar()->setValue(session.firstVisibleLine);
 }
 
 void MainWindow::applyRustHighlighter() {
@@ -850,8 +1432,8 @@ void MainWindow::applyRustHighlighter() {
   }
 
   // Re-apply highlighting if there's content
-  if (!editor_->toPlainText().isEmpty()) {
-    updateHighlighting();
+  if (!editor_->document()->isEmpty()) {
+    reapplyHighlighting();
   }
 }
 
@@ -868,6 +1450,7 @@ void MainWindow::applyEditorSettings() {
   int tabSize = settings_.tabSize();
   QFontMetrics metrics(font);
   editor_->setTabStopDistance(tabSize * metrics.horizontalAdvance(' '));
+  editor_->refreshIndentGuides();
 }
 
 void MainWindow::showPreferences() {
@@ -962,18 +1545,23 @@ void MainWindow::updateRecentFilesMenu() {
 }
 
 void MainWindow::updatePreview() {
-  QString text = editor_->toPlainText();
-
-  try {
-    CAST *ast = parser_->parse(text.toStdString());
-    if (ast) {
-      CyberMD::AST astWrapper(ast);
+  CodeEditor *editor = activeEditor();
+  if (!editor) {
+    return;
+  }
 
-      // Get HTML from AST
-      std::string html = astWrapper.toHtml();
+  // Large files only hold a window of lines; a partial preview is misleading
+  if (editor->isLargeFileMode()) {
+    preview_->setHtml("<p>Preview is disabled for large files.</p>");
+    return;
+  }
 
-      // Update preview
-      preview_->setHtml(QString::fromStdString(html));
+  try {
+    // Reparses only if the document changed since the last refresh
+    DocumentModel *model = DocumentModel::of(editor->document());
+    model->refresh(*parser_);
+    if (model->ast()) {
+      preview_->setHtml(model->previewHtml());
     }
   } catch (const std::exception &e) {
     preview_->setHtml(
@@ -1153,6 +1741,11 @@ void MainWindow::onFeatureToggled() {
 }
 
 void MainWindow::toggleViewMode() {
+  if (hexView_->isVisible()) {
+    statusBar()->showMessage("Binary files have no preview", 2000);
+    return;
+  }
+
   isPreviewMode_ = !isPreviewMode_;
 
   if (isPreviewMode_) {
@@ -1203,6 +1796,9 @@ void MainWindow::applySyntaxHighlighter(const QString &filePath) {
   } else if (extension == "rs") {
     qDebug() << "Creating RustHighlighter";
     syntaxHighlighter_ = new RustHighlighter(editor_->document());
+  } else if (extension == "log") {
+    qDebug() << "Creating LogHighlighter";
+    syntaxHighlighter_ = new LogHighlighter(editor_->document());
   } else {
     qDebug() << "WARNING: No highlighter for file type:" << extension;
     qDebug() << "Supported types: cpp, h, hpp, py, rs, md";
@@ -1224,6 +1820,8 @@ void MainWindow::applySyntaxHighlighter(const QString &filePath) {
     }
 
     qDebug() << "Syntax highlighting should now be active";
+    // Parsed formats lived on the old highlighter
+    DocumentModel::of(editor_->document())->invalidateFormats();
   } else {
     qDebug() << "ERROR: Failed to create syntax highlighter!";
   }
@@ -1377,6 +1975,8 @@ void MainWindow::applyTheme() {
 
   qDebug() << "Setting theme on editor...";
   editor_->setTheme(currentTheme_);
+  hexView_->setTheme(currentTheme_);
+  fuzzyFinder_->setTheme(currentTheme_);
   qDebug() << "Theme set on editor";
 
   // Apply Rust highlighter based on theme type
@@ -1581,7 +2181,7 @@ void MainWindow::applyTheme() {
   }
 
   // Reapply highlighting with new colors
-  updateHighlighting();
+  reapplyHighlighting();
 
   // Force update
   update();
@@ -1606,9 +2206,7 @@ void MainWindow::openFolder() {
 
 void MainWindow::saveAllFiles() {
   if (tabWidget_) {
-    for (int i = 0; i < tabWidget_->count(); ++i) {
-      tabWidget_->saveTab(i);
-    }
+    tabWidget_->saveAllTabs();
   }
 }
 
@@ -1816,9 +2414,109 @@ void MainWindow::toggleFeaturePanel(bool visible) {
   }
 }
 
+void MainWindow::toggleFollowMode(bool enabled) {
+  if (tabWidget_) {
+    if (!tabWidget_->setFollowing(tabWidget_->currentIndex(), enabled)) {
+      QMessageBox::information(this, "Follow File",
+                               "Save the file before following it.");
+      followAction_->setChecked(false);
+    }
+    return;
+  }
+
+  if (enabled == (follower_ != nullptr)) {
+    return;
+  }
+
+  if (enabled) {
+    if (currentFile_.isEmpty() || editor_->document()->isModified()) {
+      QMessageBox::information(this, "Follow File",
+                               "Save the file before following it.");
+      followAction_->setChecked(false);
+      return;
+    }
+    if (editor_->isLargeFileMode()) {
+      QMessageBox::information(this, "Follow File",
+                               "Large files cannot be followed.");
+      followAction_->setChecked(false);
+      return;
+    }
+    if (currentCompressed_) {
+      QMessageBox::information(this, "Follow File",
+                               "Compressed files cannot be followed.");
+      followAction_->setChecked(false);
+      return;
+    }
+
+    // The follower reads appends itself; reload diffs would duplicate them.
+    // It reads on from the size the editor's text was loaded at.
+    qint64 loadedSize = fileWatcher_->state(currentFile_).size;
+    fileWatcher_->unwatch(currentFile_);
+    delete syntaxHighlighter_;
+    syntaxHighlighter_ = new LogHighlighter(editor_->document());
+    if (currentTheme_) {
+      syntaxHighlighter_->setTheme(currentTheme_);
+    }
+
+    follower_ = new TailFollower(editor_, currentFile_,
+                                 settings_.tailMaxLines(), loadedSize);
+    // Appended log lines are not edits worth recovering
+    connect(follower_, &TailFollower::appended, journal_,
+            &EditJournal::discard);
+    connect(follower_, &TailFollower::restarted, this, [this]() {
+      statusBar()->showMessage("File rotated or truncated, following from "
+                               "its start",
+                               3000);
+    });
+    statusBar()->showMessage("Following " + currentFile_);
+  } else {
+    delete follower_;
+    follower_ = nullptr;
+
+    // The buffer only holds the newest lines, and saving it would drop
+    // the rest of the file; read the whole file again. The load restores
+    // the journal, the watch and the highlighter.
+    openFileByPath(currentFile_);
+  }
+}
+
+void MainWindow::setFollowFilter() {
+  TailFollower *follower =
+      tabWidget_ ? tabWidget_->followerAt(tabWidget_->currentIndex())
+                 : follower_;
+  if (!follower) {
+    statusBar()->showMessage("Not following a file", 3000);
+    return;
+  }
+
+  bool ok = false;
+  QString pattern = QInputDialog::getText(
+      this, "Filter Followed Lines",
+      "Show lines matching (regular expression, empty shows all):",
+      QLineEdit::Normal, follower->filter(), &ok);
+  if (!ok) {
+    return;
+  }
+  if (!follower->setFilter(pattern)) {
+    QMessageBox::warning(this, "Filter Followed Lines",
+                         "Invalid regular expression: " + pattern);
+  }
+}
+
 void MainWindow::toggleMinimap(bool visible) {
   minimapEnabled_ = visible;
+
   // Update all editors to show/hide minimap
+  if (editor_) {
+    editor_->enableMinimap(visible);
+  }
+  if (tabWidget_) {
+    for (int i = 0; i < tabWidget_->count(); ++i) {
+      if (CodeEditor *editor = tabWidget_->editorAt(i)) {
+        editor->enableMinimap(visible);
+      }
+    }
+  }
 }
 
 void MainWindow::toggleWordWrap(bool enabled) {
@@ -1953,18 +2651,29 @@ void MainWindow::runShellCheck() {
 // Fuzzy Finder Actions
 // ============================================
 
+void MainWindow::setupFuzzyFinder() {
+  fuzzyFinder_ = new FuzzyFinder(this);
+  connect(fuzzyFinder_, &FuzzyFinder::fileSelected, this,
+          &MainWindow::onFuzzyFileSelected);
+  connect(fuzzyFinder_, &FuzzyFinder::contentSelected, this,
+          &MainWindow::onFuzzyContentSelected);
+  connect(fuzzyFinder_, &FuzzyFinder::commandSelected, this,
+          &MainWindow::onFuzzyCommandSelected);
+  connect(fuzzyFinder_, &FuzzyFinder::bufferContentSelected, this,
+          &MainWindow::onFuzzyBufferContentSelected);
+}
+
 void MainWindow::showFuzzyFileSearch() {
   if (fuzzyFinder_) {
-    fuzzyFinder_->setMode(FuzzyFinder::FileMode);
-    fuzzyFinder_->show();
+    // Sets the root first, which opens the workspace index
+    fuzzyFinder_->showFileSearch(searchRoot());
     fuzzyFinder_->setFocus();
   }
 }
 
 void MainWindow::showFuzzyContentSearch() {
   if (fuzzyFinder_) {
-    fuzzyFinder_->setMode(FuzzyFinder::ContentMode);
-    fuzzyFinder_->show();
+    fuzzyFinder_->showContentSearch(searchRoot());
     fuzzyFinder_->setFocus();
   }
 }
@@ -1985,9 +2694,31 @@ void MainWindow::showFuzzyBufferSearch() {
   }
 }
 
+void MainWindow::showFuzzyBufferContentSearch() {
+  if (!fuzzyFinder_) {
+    return;
+  }
+
+  // Snapshots of the editors as they are now, unsaved edits included
+  QVector<BufferSnapshot> buffers;
+  if (tabWidget_) {
+    buffers = tabWidget_->bufferSnapshots();
+  } else if (!currentFile_.isEmpty() && !hexView_->isVisible() &&
+             !editor_->isLargeFileMode()) {
+    BufferSnapshot buffer;
+    buffer.filePath = currentFile_;
+    buffer.text = editor_->toPlainText();
+    buffers.append(buffer);
+  }
+  fuzzyFinder_->showBufferContentSearch(buffers);
+  fuzzyFinder_->setFocus();
+}
+
 void MainWindow::onFuzzyFileSelected(const QString &filePath) {
   if (tabWidget_) {
     tabWidget_->openFile(filePath);
+  } else if (filePath != currentFile_) {
+    openFileByPath(filePath);
   }
   if (fuzzyFinder_) {
     fuzzyFinder_->hide();
@@ -2006,6 +2737,46 @@ void MainWindow::onFuzzyContentSelected(const QString &filePath, int line) {
       editor->setTextCursor(cursor);
       editor->centerCursor();
     }
+  } else if (filePath == currentFile_) {
+    goToLine(line);
+  } else {
+    // The single editor loads in the background; onFileLoaded() jumps
+    jumpFile_ = filePath;
+    jumpLine_ = line;
+    openFileByPath(filePath);
+  }
+  if (fuzzyFinder_) {
+    fuzzyFinder_->hide();
+  }
+}
+
+void MainWindow::goToLine(int line) {
+  QTextBlock block = editor_->document()->findBlockByNumber(line - 1);
+  if (block.isValid()) {
+    editor_->setTextCursor(QTextCursor(block));
+    editor_->centerCursor();
+  }
+}
+
+void MainWindow::onFuzzyBufferContentSelected(const QString &filePath,
+                                              int lineNumber, int column) {
+  CodeEditor *editor = nullptr;
+  if (tabWidget_) {
+    tabWidget_->openFile(filePath);
+    editor = currentEditor();
+  } else if (filePath == currentFile_) {
+    editor = editor_;
+  }
+  if (editor) {
+    // The buffer may have changed since the snapshot; stay in range
+    QTextBlock block = editor->document()->findBlockByNumber(lineNumber - 1);
+    if (block.isValid()) {
+      QTextCursor cursor(block);
+      cursor.setPosition(block.position() +
+                         qBound(0, column, block.length() - 1));
+      editor->setTextCursor(cursor);
+      editor->centerCursor();
+    }
   }
   if (fuzzyFinder_) {
     fuzzyFinder_->hide();
@@ -2051,6 +2822,18 @@ void MainWindow::onTabChanged(int index) {
     setWindowTitle("CyberMD");
   }
 
+  // The follow action reflects the current tab
+  if (tabWidget_ && followAction_) {
+    QSignalBlocker blocker(followAction_);
+    followAction_->setChecked(
+        tabWidget_->followerAt(tabWidget_->currentIndex()) != nullptr);
+  }
+
+  // Swap in the tab's cached parse state; nothing is reparsed unless the
+  // tab was edited since it was last shown
+  updateHighlighting();
+  updatePreview();
+
   // Update status bar with cursor position
   updateStatusBar();
 }
@@ -2088,3 +2871,21 @@ CodeEditor *MainWindow::currentEditor() {
   }
   return nullptr;
 }
+
+CodeEditor *MainWindow::activeEditor() {
+  return tabWidget_ ? tabWidget_->currentEditor() : editor_;
+}
+
+QString MainWindow::searchRoot() const {
+  if (fileTree_ && !fileTree_->rootPath().isEmpty()) {
+    return fileTree_->rootPath();
+  }
+  if (!currentFile_.isEmpty()) {
+    return QFileInfo(currentFile_).absolutePath();
+  }
+  return QDir::homePath();
+}
+
+QString MainWindow::activeFilePath() const {
+  return tabWidget_ ? tabWidget_->currentFilePath() : currentFile_;
+}
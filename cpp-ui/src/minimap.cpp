@@ -0,0 +1,270 @@
+#include "minimap.h"
+#include "blockdata.h"
+#include "codeeditor.h"
+#include "theme.h"
+#include <QMouseEvent>
+#include <QPaintEvent>
+#include <QPainter>
+#include <QResizeEvent>
+#include <QScrollBar>
+#include <QTextDocument>
+#include <QTextLayout>
+#include <algorithm>
+#include <cstring>
+
+namespace {
+// Columns past this are not summarized (one pixel per column)
+const int kMaxColumns = 160;
+const int kTabColumns = 4;
+} // namespace
+
+Minimap::Minimap(CodeEditor *editor)
+    : QWidget(editor), codeEditor_(editor), firstRow_(0), lastBlockCount_(0),
+      imageValid_(false), background_(qRgb(30, 30, 30)),
+      foreground_(qRgb(212, 212, 212)) {
+  setAttribute(Qt::WA_OpaquePaintEvent);
+  setCursor(Qt::PointingHandCursor);
+  updateColors();
+
+  connect(editor->document(), &QTextDocument::contentsChange, this,
+          &Minimap::onContentsChange);
+  connect(editor->verticalScrollBar(), &QScrollBar::valueChanged, this,
+          &Minimap::onEditorScrolled);
+}
+
+QSize Minimap::sizeHint() const { return QSize(preferredWidth(), 0); }
+
+void Minimap::updateColors() {
+  Theme *theme = codeEditor_->theme();
+  background_ = theme ? theme->editorBackground().rgb() : qRgb(30, 30, 30);
+  foreground_ = theme ? theme->editorForeground().rgb() : qRgb(212, 212, 212);
+  sliderColor_ = theme ? theme->editorSelection() : QColor(128, 128, 128);
+  sliderColor_.setAlpha(60);
+  imageValid_ = false;
+  update();
+}
+
+// Text edits and highlighter passes both arrive here (the highlighter marks
+// re-formatted blocks dirty), so only the touched blocks are re-summarized.
+void Minimap::onContentsChange(int position, int charsRemoved,
+                               int charsAdded) {
+  Q_UNUSED(charsRemoved)
+  QTextDocument *doc = codeEditor_->document();
+  QTextBlock block = doc->findBlock(position);
+  QTextBlock last = doc->findBlock(position + charsAdded);
+  if (!last.isValid()) {
+    last = doc->lastBlock();
+  }
+
+  int firstChanged = block.blockNumber();
+  int lastChanged = last.blockNumber();
+  for (; block.isValid(); block = block.next()) {
+    if (BlockData *data = BlockData::peek(block)) {
+      data->minimapValid = false;
+    }
+    if (block == last) {
+      break;
+    }
+  }
+
+  // Inserted or removed lines shift every row below; re-blit the window
+  // from the cached summaries of the untouched blocks.
+  if (doc->blockCount() != lastBlockCount_ || computeFirstRow() != firstRow_) {
+    imageValid_ = false;
+    update();
+    return;
+  }
+
+  if (!imageValid_) {
+    update();
+    return;
+  }
+
+  int fromRow = qMax(firstChanged - firstRow_, 0);
+  int toRow = qMin(lastChanged - firstRow_, image_.height() - 1);
+  if (fromRow <= toRow) {
+    renderRows(fromRow, toRow);
+    update(0, fromRow, width(), toRow - fromRow + 1);
+  }
+}
+
+void Minimap::onEditorScrolled() {
+  int newFirst = computeFirstRow();
+  int delta = newFirst - firstRow_;
+  if (!imageValid_ || delta == 0) {
+    update();
+    return;
+  }
+
+  // Shift the cached rows and render only the ones that scrolled in
+  int rows = image_.height();
+  if (qAbs(delta) >= rows) {
+    firstRow_ = newFirst;
+    renderRows(0, rows - 1);
+  } else {
+    int stride = image_.bytesPerLine();
+    uchar *bits = image_.bits();
+    if (delta > 0) {
+      std::memmove(bits, bits + delta * stride, (rows - delta) * stride);
+      firstRow_ = newFirst;
+      renderRows(rows - delta, rows - 1);
+    } else {
+      std::memmove(bits - delta * stride, bits, (rows + delta) * stride);
+      firstRow_ = newFirst;
+      renderRows(0, -delta - 1);
+    }
+  }
+  update();
+}
+
+// Keeps the editor's visible region inside the minimap, scrolling the
+// overview proportionally once the document is taller than the widget.
+int Minimap::computeFirstRow() const {
+  int blockCount = codeEditor_->document()->blockCount();
+  int rows = height();
+  if (blockCount <= rows) {
+    return 0;
+  }
+
+  QScrollBar *bar = codeEditor_->verticalScrollBar();
+  int range = bar->maximum() - bar->minimum();
+  if (range <= 0) {
+    return 0;
+  }
+  qint64 offset = qint64(bar->value() - bar->minimum()) * (blockCount - rows);
+  return int(offset / range);
+}
+
+void Minimap::renderWindow() {
+  if (image_.size() != size()) {
+    image_ = QImage(size(), QImage::Format_RGB32);
+  }
+  firstRow_ = computeFirstRow();
+  lastBlockCount_ = codeEditor_->document()->blockCount();
+  renderRows(0, image_.height() - 1);
+  imageValid_ = true;
+}
+
+void Minimap::renderRows(int fromRow, int toRow) {
+  QTextBlock block =
+      codeEditor_->document()->findBlockByNumber(firstRow_ + fromRow);
+  for (int y = fromRow; y <= toRow; ++y) {
+    renderRow(y, block);
+    if (block.isValid()) {
+      block = block.next();
+    }
+  }
+}
+
+void Minimap::renderRow(int y, const QTextBlock &block) {
+  QRgb *line = reinterpret_cast<QRgb *>(image_.scanLine(y));
+  int width = image_.width();
+  std::fill(line, line + width, background_);
+  if (!block.isValid()) {
+    return;
+  }
+
+  BlockData *data = BlockData::of(block);
+  if (!data->minimapValid) {
+    buildSummary(block, data);
+  }
+
+  for (const MinimapRun &run : data->minimapRuns) {
+    if (run.start >= width) {
+      break;
+    }
+    QRgb color = qAlpha(run.color) ? run.color : foreground_;
+    int end = qMin<int>(run.start + run.length, width);
+    std::fill(line + run.start, line + end, color);
+  }
+}
+
+// Summarize a block into colored runs, one column per character. Reads the
+// highlighter's format ranges from the block layout without laying it out.
+void Minimap::buildSummary(const QTextBlock &block, BlockData *data) {
+  data->minimapRuns.clear();
+  data->minimapValid = true;
+
+  const QString text = block.text();
+  if (text.isEmpty()) {
+    return;
+  }
+
+  int length = qMin(text.length(), kMaxColumns);
+  QRgb colors[kMaxColumns];
+  std::fill(colors, colors + length, QRgb(0));
+  const auto formats = block.layout()->formats();
+  for (const QTextLayout::FormatRange &range : formats) {
+    if (range.format.foreground().style() == Qt::NoBrush) {
+      continue;
+    }
+    QRgb rgb = range.format.foreground().color().rgb();
+    int end = qMin(range.start + range.length, length);
+    for (int i = qMax(range.start, 0); i < end; ++i) {
+      colors[i] = rgb;
+    }
+  }
+
+  int column = 0;
+  for (int i = 0; i < length && column < kMaxColumns; ++i) {
+    QChar c = text.at(i);
+    if (c == QLatin1Char('\t')) {
+      column += kTabColumns;
+      continue;
+    }
+    if (c.isSpace()) {
+      ++column;
+      continue;
+    }
+
+    if (!data->minimapRuns.isEmpty()) {
+      MinimapRun &prev = data->minimapRuns.last();
+      if (prev.color == colors[i] && prev.start + prev.length == column) {
+        ++prev.length;
+        ++column;
+        continue;
+      }
+    }
+    MinimapRun run = {quint16(column), quint16(1), colors[i]};
+    data->minimapRuns.append(run);
+    ++column;
+  }
+}
+
+void Minimap::paintEvent(QPaintEvent *event) {
+  if (!imageValid_ || image_.size() != size()) {
+    renderWindow();
+  }
+
+  QPainter painter(this);
+  painter.drawImage(event->rect(), image_, event->rect());
+
+  // Visible region slider
+  QTextBlock first = codeEditor_->getFirstVisibleBlock();
+  int lineHeight = qMax(1, codeEditor_->fontMetrics().height());
+  int visibleRows = codeEditor_->viewport()->height() / lineHeight;
+  QRect slider(0, first.blockNumber() - firstRow_, width(), visibleRows);
+  painter.fillRect(slider, sliderColor_);
+}
+
+void Minimap::mousePressEvent(QMouseEvent *event) {
+  scrollEditorTo(qRound(event->position().y()));
+}
+
+void Minimap::mouseMoveEvent(QMouseEvent *event) {
+  if (event->buttons() & Qt::LeftButton) {
+    scrollEditorTo(qRound(event->position().y()));
+  }
+}
+
+void Minimap::resizeEvent(QResizeEvent *event) {
+  QWidget::resizeEvent(event);
+  imageValid_ = false;
+}
+
+void Minimap::scrollEditorTo(int y) {
+  int lineHeight = qMax(1, codeEditor_->fontMetrics().height());
+  int visibleRows = codeEditor_->viewport()->height() / lineHeight;
+  int target = qMax(0, firstRow_ + y - visibleRows / 2);
+  codeEditor_->verticalScrollBar()->setValue(target);
+}
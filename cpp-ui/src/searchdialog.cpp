@@ -1,4 +1,5 @@
 #include "searchdialog.h"
+#include "codeeditor.h"
 #include <QVBoxLayout>
 #include <QHBoxLayout>
 #include <QLabel>
@@ -98,6 +99,8 @@ bool SearchDialog::find(bool forward) {
         return false;
     }
 
+    updateSearchHighlights();
+
     QTextDocument::FindFlags flags;
     if (!forward) {
         flags |= QTextDocument::FindBackward;
@@ -144,6 +147,45 @@ bool SearchDialog::find(bool forward) {
     return found;
 }
 
+// Highlight every hit in the editor; recomputed only when the pattern or
+// options change, not on each Find Next. The editor rematches the blocks
+// an edit touches, so the hits stay current in between.
+void SearchDialog::updateSearchHighlights() {
+    CodeEditor *codeEditor = qobject_cast<CodeEditor *>(editor_);
+    if (!codeEditor) {
+        return;
+    }
+
+    QString searchText = findLineEdit_->text();
+    QString source = regexCheck_->isChecked()
+                         ? searchText
+                         : QRegularExpression::escape(searchText);
+    if (wholeWordsCheck_->isChecked()) {
+        source = QString("\\b(?:%1)\\b").arg(source);
+    }
+
+    QRegularExpression pattern(source);
+    if (!caseSensitiveCheck_->isChecked()) {
+        pattern.setPatternOptions(QRegularExpression::CaseInsensitiveOption);
+    }
+
+    if (pattern == highlightedPattern_) {
+        return;
+    }
+    highlightedPattern_ = pattern;
+    codeEditor->highlightSearchMatches(pattern);
+}
+
+void SearchDialog::hideEvent(QHideEvent *event) {
+    QDialog::hideEvent(event);
+
+    CodeEditor *codeEditor = qobject_cast<CodeEditor *>(editor_);
+    if (codeEditor) {
+        codeEditor->clearSearchHighlights();
+    }
+    highlightedPattern_ = QRegularExpression();
+}
+
 void SearchDialog::findNext() {
     if (!find(true)) {
         QMessageBox::information(this, "Find", "No matches found.");
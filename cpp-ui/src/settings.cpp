@@ -1,4 +1,6 @@
 #include "settings.h"
+#include <QVariantList>
+#include <QVariantMap>
 
 Settings::Settings()
     : settings_("CyberMD", "CyberMD")
@@ -43,6 +45,30 @@ void Settings::setTabSize(int size) {
     settings_.setValue("editor/tabSize", size);
 }
 
+int Settings::largeFileThresholdMB() const {
+    return settings_.value("editor/largeFileThresholdMB", 50).toInt();
+}
+
+void Settings::setLargeFileThresholdMB(int megabytes) {
+    settings_.setValue("editor/largeFileThresholdMB", megabytes);
+}
+
+int Settings::tabReclaimMinutes() const {
+    return settings_.value("editor/tabReclaimMinutes", 10).toInt();
+}
+
+void Settings::setTabReclaimMinutes(int minutes) {
+    settings_.setValue("editor/tabReclaimMinutes", minutes);
+}
+
+int Settings::tailMaxLines() const {
+    return settings_.value("editor/tailMaxLines", 10000).toInt();
+}
+
+void Settings::setTailMaxLines(int lines) {
+    settings_.setValue("editor/tailMaxLines", lines);
+}
+
 // Recent files
 QStringList Settings::recentFiles() const {
     return settings_.value("recentFiles").toStringList();
@@ -85,3 +111,46 @@ QByteArray Settings::windowState() const {
 void Settings::setWindowState(const QByteArray& state) {
     settings_.setValue("window/state", state);
 }
+
+// Session
+QVector<SessionTab> Settings::sessionTabs() const {
+    QVector<SessionTab> tabs;
+    const QVariantList entries = settings_.value("session/tabs").toList();
+    for (const QVariant& entry : entries) {
+        QVariantMap map = entry.toMap();
+        SessionTab tab;
+        tab.filePath = map.value("path").toString();
+        tab.cursorPosition = map.value("cursor").toInt();
+        tab.firstVisibleLine = map.value("firstLine").toInt();
+        const QVariantList folds = map.value("folds").toList();
+        for (const QVariant& line : folds) {
+            tab.foldedLines.append(line.toInt());
+        }
+        if (!tab.filePath.isEmpty()) {
+            tabs.append(tab);
+        }
+    }
+    return tabs;
+}
+
+int Settings::sessionActiveTab() const {
+    return settings_.value("session/activeTab", 0).toInt();
+}
+
+void Settings::setSession(const QVector<SessionTab>& tabs, int activeTab) {
+    QVariantList entries;
+    for (const SessionTab& tab : tabs) {
+        QVariantList folds;
+        for (int line : tab.foldedLines) {
+            folds.append(line);
+        }
+        QVariantMap map;
+        map.insert("path", tab.filePath);
+        map.insert("cursor", tab.cursorPosition);
+        map.insert("firstLine", tab.firstVisibleLine);
+        map.insert("folds", folds);
+        entries.append(map);
+    }
+    settings_.setValue("session/tabs", entries);
+    settings_.setValue("session/activeTab", activeTab);
+}
@@ -502,10 +502,18 @@ void RustHighlighter::highlightMacros(const QString &text) { Q_UNUSED(text); }
 // ============================================================================
 
 MarkdownHighlighter::MarkdownHighlighter(QTextDocument *parent)
-    : BaseSyntaxHighlighter(parent) {
+    : BaseSyntaxHighlighter(parent), parsedRevision_(-1) {
   setupRules();
 }
 
+void MarkdownHighlighter::setParsedFormats(
+    const QVector<QVector<QTextLayout::FormatRange>> &blocks, int revision) {
+  parsedFormats_ = blocks;
+  parsedRevision_ = revision;
+  // Layout formats only: the document text and its revision are untouched
+  rehighlight();
+}
+
 void MarkdownHighlighter::setupRules() {
   highlightingRules_.clear();
 
@@ -617,6 +625,32 @@ void MarkdownHighlighter::highlightBlock(const QString &text) {
       setFormat(match.capturedStart(), match.capturedLength(), rule.format);
     }
   }
+
+  applyParsedFormats(text);
+}
+
+void MarkdownHighlighter::applyParsedFormats(const QString &text) {
+  int blockNumber = currentBlock().blockNumber();
+  if (parsedRevision_ != document()->revision() ||
+      blockNumber >= parsedFormats_.size()) {
+    return;
+  }
+
+  // Later ranges merge over earlier ones, and the rule formats over both
+  QVector<QTextCharFormat> parsed(text.length());
+  for (const QTextLayout::FormatRange &range : parsedFormats_[blockNumber]) {
+    int end = qMin(range.start + range.length, int(text.length()));
+    for (int i = qMax(range.start, 0); i < end; ++i) {
+      parsed[i].merge(range.format);
+    }
+  }
+  for (int i = 0; i < parsed.size(); ++i) {
+    if (!parsed[i].isEmpty()) {
+      QTextCharFormat merged = parsed[i];
+      merged.merge(format(i));
+      setFormat(i, 1, merged);
+    }
+  }
 }
 
 void MarkdownHighlighter::highlightHeadings(const QString &text) {
@@ -1084,6 +1118,64 @@ void TomlHighlighter::highlightBlock(const QString &text) {
   }
 }
 
+// ============================================================================
+// LogHighlighter
+// ============================================================================
+
+LogHighlighter::LogHighlighter(QTextDocument *parent)
+    : BaseSyntaxHighlighter(parent) {
+  // The base constructor only ran the base setupFormats()
+  setupFormats();
+  setupRules();
+}
+
+void LogHighlighter::setupFormats() {
+  BaseSyntaxHighlighter::setupFormats();
+
+  errorFormat_.setForeground(theme_ ? theme_->errorColor() : QColor("#f44747"));
+  errorFormat_.setFontWeight(QFont::Bold);
+  warningFormat_.setForeground(theme_ ? theme_->warningColor()
+                                      : QColor("#cca700"));
+  infoFormat_.setForeground(theme_ ? theme_->codeFunction()
+                                   : QColor("#dcdcaa"));
+  debugFormat_.setForeground(theme_ ? theme_->syntaxComment()
+                                    : QColor("#6a9955"));
+}
+
+void LogHighlighter::setupRules() {
+  // syslog, IDS and tool output spell severities in several ways
+  errorPattern_ = QRegularExpression(
+      "\\b(EMERG|ALERT|CRIT(ICAL)?|FATAL|ERR(OR)?|FAIL(ED|URE)?|DENIED)\\b",
+      QRegularExpression::CaseInsensitiveOption);
+  warningPattern_ = QRegularExpression("\\b(WARN(ING)?|NOTICE)\\b",
+                                       QRegularExpression::CaseInsensitiveOption);
+  infoPattern_ = QRegularExpression("\\bINFO\\b");
+  debugPattern_ = QRegularExpression("\\b(DEBUG|TRACE)\\b");
+  timestampPattern_ = QRegularExpression(
+      "^(\\d{4}-\\d{2}-\\d{2}[T ]\\d{2}:\\d{2}:\\d{2}\\S*|"
+      "[A-Z][a-z]{2} [ \\d]\\d \\d{2}:\\d{2}:\\d{2})");
+}
+
+void LogHighlighter::highlightBlock(const QString &text) {
+  if (!enabled_)
+    return;
+
+  if (errorPattern_.match(text).hasMatch()) {
+    setFormat(0, text.length(), errorFormat_);
+  } else if (warningPattern_.match(text).hasMatch()) {
+    setFormat(0, text.length(), warningFormat_);
+  } else if (infoPattern_.match(text).hasMatch()) {
+    setFormat(0, text.length(), infoFormat_);
+  } else if (debugPattern_.match(text).hasMatch()) {
+    setFormat(0, text.length(), debugFormat_);
+  }
+
+  QRegularExpressionMatch timestamp = timestampPattern_.match(text);
+  if (timestamp.hasMatch()) {
+    setFormat(0, timestamp.capturedLength(), numberFormat_);
+  }
+}
+
 // ============================================================================
 // HighlighterFactory
 // ============================================================================
@@ -1116,6 +1208,8 @@ HighlighterFactory::createHighlighter(Language lang, QTextDocument *doc) {
     return new CssHighlighter(doc);
   case Toml:
     return new TomlHighlighter(doc);
+  case Log:
+    return new LogHighlighter(doc);
   default:
     return nullptr;
   }
@@ -1162,6 +1256,8 @@ HighlighterFactory::detectLanguage(const QString &filePath) {
     return Css;
   if (suffix == "toml")
     return Toml;
+  if (suffix == "log")
+    return Log;
 
   return None;
 }
@@ -1194,6 +1290,8 @@ QString HighlighterFactory::languageName(Language lang) {
     return "CSS";
   case Toml:
     return "TOML";
+  case Log:
+    return "Log";
   default:
     return "Plain Text";
   }
@@ -1,6 +1,15 @@
 #include "tabwidget.h"
 #include "codeeditor.h"
+#include "blockdata.h"
+#include "codefolding.h"
+#include "editjournal.h"
+#include "fileloader.h"
+#include "filesaver.h"
+#include "hexview.h"
+#include "largefile.h"
+#include "settings.h"
 #include "syntaxhighlighter.h"
+#include "tailfollower.h"
 #include "theme.h"
 
 #include <QDebug>
@@ -10,9 +19,10 @@
 #include <QMessageBox>
 #include <QMouseEvent>
 #include <QPainter>
-#include <QStringConverter>
+#include <QScrollBar>
 #include <QStyleOption>
-#include <QTextStream>
+#include <QTextLayout>
+#include <QTimer>
 // =================== EditorTabBar ====================
 
 EditorTabBar::EditorTabBar(QWidget *parent) : QTabBar(parent), theme_(nullptr) {
@@ -123,7 +133,10 @@ void EditorTabBar::mousePressEvent(QMouseEvent *event) {
 
                      EditorTabWidget::EditorTabWidget(QWidget *parent)
                          : QTabWidget(parent), tabBar_(new EditorTabBar(this)),
-                           theme_(nullptr), untitledCounter_(0) {
+                           loader_(new FileLoader(this)), saver_(new FileSaver(this)),
+                       watcher_(new FileWatcher(this)),
+                           reclaimTimer_(new QTimer(this)), theme_(nullptr),
+                           untitledCounter_(0) {
                        setupUI();
                      }
 
@@ -147,9 +160,49 @@ void EditorTabBar::mousePressEvent(QMouseEvent *event) {
                                &EditorTabWidget::onCurrentChanged);
                        connect(tabBar_, &QTabBar::tabMoved, this,
                                &EditorTabWidget::onTabMoved);
+                       connect(loader_, &FileLoader::fileLoaded, this,
+                               &EditorTabWidget::onFileLoaded);
+                       connect(loader_, &FileLoader::chunkLoaded, this,
+                               &EditorTabWidget::onFileChunkLoaded);
+                       connect(loader_, &FileLoader::loadFailed, this,
+                               &EditorTabWidget::onLoadFailed);
+                       connect(saver_, &FileSaver::saved, this,
+                               &EditorTabWidget::onFileSaved);
+                       connect(saver_, &FileSaver::saveFailed, this,
+                               &EditorTabWidget::onSaveFailed);
+                       connect(watcher_, &FileWatcher::fileChanged, this,
+                               &EditorTabWidget::onFileChangedOnDisk);
+                       connect(watcher_, &FileWatcher::fileRemoved, this,
+                               &EditorTabWidget::onFileRemovedOnDisk);
+                       connect(watcher_, &FileWatcher::reloadReady, this,
+                               &EditorTabWidget::onReloadReady);
+                       connect(watcher_, &FileWatcher::reloadFailed, this,
+                               [](const QString &filePath, const QString &error) {
+                                 qWarning() << "Cannot reload" << filePath << error;
+                               });
+
+                       // Inactive tabs are checked for reclamation once a minute
+                       activityClock_.start();
+                       reclaimTimer_->setInterval(60 * 1000);
+                       connect(reclaimTimer_, &QTimer::timeout, this,
+                               &EditorTabWidget::reclaimInactiveTabs);
+                       reclaimTimer_->start();
                      }
 
                      int EditorTabWidget::newTab(const QString &filePath) {
+                       int index = insertEditorTab(count(), filePath);
+                       if (index < 0)
+                         return -1;
+
+                       setCurrentIndex(index);
+                       emit tabCountChanged(count());
+
+                       return index;
+                     }
+
+                     int EditorTabWidget::insertEditorTab(int position,
+                                                          const QString &filePath,
+                                                          const QString *preloaded) {
                        CodeEditor *editor = new CodeEditor(this);
 
                        if (theme_) {
@@ -163,16 +216,36 @@ void EditorTabBar::mousePressEvent(QMouseEvent *event) {
                          info.isUntitled = true;
                          info.fileName =
                              QString("Untitled-%1").arg(++untitledCounter_);
-                       } else {
-                         // Existing file
-                         QFile file(filePath);
-                         if (file.open(QIODevice::ReadOnly | QIODevice::Text)) {
-                           QTextStream stream(&file);
-                           stream.setEncoding(QStringConverter::Utf8);
-                           editor->setPlainText(stream.readAll());
-                           file.close();
+                       } else if (preloaded) {
+                         // Text already in memory (reclaimed tab being reactivated)
+                         editor->setPlainText(*preloaded);
+                         info.isUntitled = false;
+                         info.filePath = filePath;
+                         info.fileName = QFileInfo(filePath).fileName();
+                         editor->setFilePath(filePath);
+                       } else if (LargeFileBuffer::isLargeFile(filePath)) {
+                         // Large file: piece table over a mapping, only a window of lines
+                         // is materialized in the editor
+                         LargeFileBuffer *buffer = new LargeFileBuffer;
+                         if (!buffer->open(filePath)) {
+                           // An editor without its buffer would show empty text, and a
+                           // save would write that over the file
+                           delete buffer;
+                           delete editor;
+                           QMessageBox::warning(this, "Error",
+                                                QString("Cannot map file: %1").arg(filePath));
+                           return -1;
                          }
-
+                         new LargeFileController(editor, buffer);
+                         info.isUntitled = false;
+                         info.isLargeFile = true;
+                         info.filePath = filePath;
+                         info.fileName = QFileInfo(filePath).fileName();
+                         editor->setFilePath(filePath);
+                       } else {
+                         // Existing file: the tab appears right away and is filled in
+                         // when the background load finishes
+                         info.isLoading = true;
                          info.isUntitled = false;
                          info.filePath = filePath;
                          info.fileName = QFileInfo(filePath).fileName();
@@ -180,8 +253,16 @@ void EditorTabBar::mousePressEvent(QMouseEvent *event) {
                        }
 
                        info.isModified = false;
+                       info.lastActive = activityClock_.elapsed();
 
-                       int index = addTab(editor, info.fileName);
+                       // Crash recovery journal; large files only hold a window, so their
+                       // document positions are not file positions
+                       if (!info.isLargeFile) {
+                         info.journal = new EditJournal(editor->document());
+                         info.journal->rebase(info.filePath);
+                       }
+
+                       int index = insertTab(position, editor, info.fileName);
                        tabInfoMap_[index] = info;
 
                        // Connect text changed signal
@@ -199,9 +280,34 @@ void EditorTabBar::mousePressEvent(QMouseEvent *event) {
                        // Apply highlighter
                        applyHighlighter(index, filePath);
 
+                       if (info.isLoading) {
+                         beginLoad(index, filePath);
+                       }
+
+                       return index;
+                     }
+
+                     int EditorTabWidget::insertHexTab(const QString &filePath) {
+                       HexView *hexView = new HexView(this);
+                       if (!hexView->open(filePath)) {
+                         delete hexView;
+                         QMessageBox::warning(this, "Error",
+                                              QString("Cannot map file: %1").arg(filePath));
+                         return -1;
+                       }
+                       hexView->setTheme(theme_);
+
+                       TabInfo info;
+                       info.isUntitled = false;
+                       info.isBinary = true;
+                       info.filePath = filePath;
+                       info.fileName = QFileInfo(filePath).fileName();
+                       info.lastActive = activityClock_.elapsed();
+
+                       int index = addTab(hexView, info.fileName);
+                       tabInfoMap_[index] = info;
                        setCurrentIndex(index);
                        emit tabCountChanged(count());
-
                        return index;
                      }
 
@@ -221,42 +327,37 @@ void EditorTabBar::mousePressEvent(QMouseEvent *event) {
                          return false;
                        }
 
-                       // If current tab is untitled and unmodified, use it
-                       if (count() > 0) {
+                       // Binary files would come out as garbage text; they get a hex view
+                       if (HexView::isBinaryFile(filePath)) {
+                         return insertHexTab(filePath) >= 0;
+                       }
+
+                       // If current tab is untitled and unmodified, use it (large files
+                       // always get a fresh tab so the editor starts in reduced mode)
+                       if (count() > 0 && !LargeFileBuffer::isLargeFile(filePath)) {
                          int current = currentIndex();
                          if (tabInfoMap_.contains(current) &&
                              tabInfoMap_[current].isUntitled &&
                              !tabInfoMap_[current].isModified) {
                            // Load into current tab
                            CodeEditor *editor = currentEditor();
-                           QFile file(filePath);
-                           if (file.open(QIODevice::ReadOnly |
-                                         QIODevice::Text)) {
-                             QTextStream stream(&file);
-                             stream.setEncoding(QStringConverter::Utf8);
-                             editor->setPlainText(stream.readAll());
-                             file.close();
-
-                             TabInfo &info = tabInfoMap_[current];
-                             info.isUntitled = false;
-                             info.filePath = filePath;
-                             info.fileName = QFileInfo(filePath).fileName();
-                             info.isModified = false;
-                             editor->setFilePath(filePath);
-                             editor->document()->setModified(false);
-
-                             updateTabTitle(current);
-                             applyHighlighter(current, filePath);
-
-                             emit currentFileChanged(filePath);
-                             return true;
-                           }
+                           TabInfo &info = tabInfoMap_[current];
+                           info.isUntitled = false;
+                           info.filePath = filePath;
+                           info.fileName = QFileInfo(filePath).fileName();
+                           info.isModified = false;
+                           editor->setFilePath(filePath);
+
+                           applyHighlighter(current, filePath);
+                           beginLoad(current, filePath);
+
+                           emit currentFileChanged(filePath);
+                           return true;
                          }
                        }
 
                        // Create new tab
-                       newTab(filePath);
-                       return true;
+                       return newTab(filePath) >= 0;
                      }
 
                      bool EditorTabWidget::saveTab(int index) {
@@ -271,27 +372,64 @@ void EditorTabBar::mousePressEvent(QMouseEvent *event) {
                          return saveTabAs(index);
                        }
 
+                       if (info.isCompressed) {
+                         QMessageBox::information(this, "Save",
+                                                  QString("%1 is compressed and was opened read-only.\n"
+                                                          "Use Save As to write the uncompressed text.")
+                                                      .arg(info.fileName));
+                         return false;
+                       }
+
                        CodeEditor *editor = editorAt(index);
                        if (!editor)
                          return false;
 
-                       QFile file(info.filePath);
-                       if (!file.open(QIODevice::WriteOnly | QIODevice::Text)) {
-                         QMessageBox::critical(this, "Error",
-                                               QString("Cannot save file: %1")
-                                                   .arg(info.filePath));
-                         return false;
+                       if (LargeFileController *large = editor->largeFileController()) {
+                         QString error;
+                         if (!large->save(info.filePath, &error)) {
+                           QMessageBox::critical(this, "Error",
+                                                 QString("Cannot save file: %1\n%2")
+                                                     .arg(info.filePath, error));
+                           return false;
+                         }
+                         info.isModified = false;
+                         updateTabTitle(index);
+                         return true;
                        }
 
-                       QTextStream stream(&file);
-                       stream.setEncoding(QStringConverter::Utf8);
-                       stream << editor->toPlainText();
-                       file.close();
+                       if (!FileSaver::resolveLineEnding(this, info.filePath, &info.lineEnding))
+                         return false;
 
-                       editor->document()->setModified(false);
-                       info.isModified = false;
-                       updateTabTitle(index);
+                       // Hand a snapshot to the saver and keep editing; the modified flag is
+                       // cleared in onFileSaved() if nothing changed in the meantime
+                       saver_->save(info.filePath, editor->toPlainText(), info.lineEnding,
+                                    info.hasBom, editor->document()->revision());
+                       return true;
+                     }
+
+                     // For closing: the buffer is about to go, so the write must have landed
+                     bool EditorTabWidget::saveTabNow(int index) {
+                       TabInfo &info = tabInfoMap_[index];
+                       CodeEditor *editor = editorAt(index);
+
+                       // Save As, the read-only refusal and large-file saves all finish
+                       // before saveTab() returns
+                       if (info.isUntitled || info.isCompressed || !editor ||
+                           editor->largeFileController())
+                         return saveTab(index);
 
+                       if (!FileSaver::resolveLineEnding(this, info.filePath, &info.lineEnding))
+                         return false;
+
+                       QString error;
+                       if (!saver_->saveNow(info.filePath, editor->toPlainText(), info.lineEnding,
+                                            info.hasBom, &error)) {
+                         QMessageBox::critical(this, "Error",
+                                               QString("Cannot save file: %1\n%2")
+                                                   .arg(info.filePath, error));
+                         return false;
+                       }
+                       editor->document()->setModified(false);
                        return true;
                      }
 
@@ -312,26 +450,52 @@ void EditorTabBar::mousePressEvent(QMouseEvent *event) {
                        if (filePath.isEmpty())
                          return false;
 
-                       QFile file(filePath);
-                       if (!file.open(QIODevice::WriteOnly | QIODevice::Text)) {
-                         QMessageBox::critical(
-                             this, "Error",
-                             QString("Cannot save file: %1").arg(filePath));
-                         return false;
+                       if (LargeFileController *large = editor->largeFileController()) {
+                         QString error;
+                         if (!large->save(filePath, &error)) {
+                           QMessageBox::critical(this, "Error",
+                                                 QString("Cannot save file: %1\n%2")
+                                                     .arg(filePath, error));
+                           return false;
+                         }
+                       } else {
+                         // Written before returning: the tab only moves to the new path,
+                         // and lets go of the old one, once the file is there
+                         TabInfo &info = tabInfoMap_[index];
+                         if (!FileSaver::resolveLineEnding(this, filePath, &info.lineEnding))
+                           return false;
+                         QString error;
+                         if (!saver_->saveNow(filePath, editor->toPlainText(), info.lineEnding,
+                                              info.hasBom, &error)) {
+                           QMessageBox::critical(this, "Error",
+                                                 QString("Cannot save file: %1\n%2")
+                                                     .arg(filePath, error));
+                           return false;
+                         }
+                         editor->document()->setModified(false);
                        }
 
-                       QTextStream stream(&file);
-                       stream.setEncoding(QStringConverter::Utf8);
-                       stream << editor->toPlainText();
-                       file.close();
-
                        TabInfo &info = tabInfoMap_[index];
+                       if (info.filePath != filePath) {
+                         watcher_->unwatch(info.filePath);
+                       }
+                       if (info.isCompressed) {
+                         // The saved copy is plain text and can be edited from here on
+                         info.isCompressed = false;
+                         editor->setReadOnly(false);
+                         editor->document()->setUndoRedoEnabled(true);
+                         info.journal = new EditJournal(editor->document());
+                       }
                        info.filePath = filePath;
                        info.fileName = QFileInfo(filePath).fileName();
                        info.isUntitled = false;
-                       info.isModified = false;
                        editor->setFilePath(filePath);
-                       editor->document()->setModified(false);
+                       if (!editor->largeFileController()) {
+                         watcher_->watch(filePath, DiskState::read(filePath));
+                         if (info.journal) {
+                           info.journal->rebase(filePath);
+                         }
+                       }
 
                        updateTabTitle(index);
                        applyHighlighter(index, filePath);
@@ -342,6 +506,8 @@ void EditorTabBar::mousePressEvent(QMouseEvent *event) {
                      }
 
                      bool EditorTabWidget::saveAllTabs() {
+                       // Each saveTab() only queues a snapshot, so the writes run in
+                       // parallel on the thread pool
                        for (int i = 0; i < count(); ++i) {
                          if (tabInfoMap_.contains(i) &&
                              tabInfoMap_[i].isModified) {
@@ -367,22 +533,39 @@ void EditorTabBar::mousePressEvent(QMouseEvent *event) {
                                      QMessageBox::Cancel);
 
                          if (reply == QMessageBox::Save) {
-                           if (!saveTab(index))
+                           if (!saveTabNow(index))
                              return false;
                          } else if (reply == QMessageBox::Cancel) {
                            return false;
                          }
                        }
 
+                       // The buffer was saved or its changes discarded
+                       if (tabInfoMap_.contains(index) && tabInfoMap_[index].journal) {
+                         tabInfoMap_[index].journal->discard();
+                       }
+
+                       watcher_->unwatch(filePathAt(index));
+
                        // Clean up highlighter
                        if (tabInfoMap_.contains(index) &&
                            tabInfoMap_[index].highlighter) {
                          delete tabInfoMap_[index].highlighter;
                        }
-                       tabInfoMap_.remove(index);
+                       removeTabInfo(index);
 
-                       // Remove tab
+                       // Remove tab (QTabWidget does not delete the page)
+                       QWidget *page = widget(index);
                        removeTab(index);
+                       page->deleteLater();
+
+                       emit tabCountChanged(count());
+
+                       return true;
+                     }
+
+                     void EditorTabWidget::removeTabInfo(int index) {
+                       tabInfoMap_.remove(index);
 
                        // Renumber remaining tabs in map
                        QMap<int, TabInfo> newMap;
@@ -394,10 +577,6 @@ void EditorTabBar::mousePressEvent(QMouseEvent *event) {
                          newMap[newIndex] = it.value();
                        }
                        tabInfoMap_ = newMap;
-
-                       emit tabCountChanged(count());
-
-                       return true;
                      }
 
                      bool EditorTabWidget::closeAllTabs() {
@@ -468,6 +647,8 @@ void EditorTabBar::mousePressEvent(QMouseEvent *event) {
                          CodeEditor *editor = editorAt(i);
                          if (editor) {
                            editor->setTheme(theme);
+                         } else if (HexView *hexView = qobject_cast<HexView *>(widget(i))) {
+                           hexView->setTheme(theme);
                          }
 
                          // Apply theme to highlighters
@@ -490,6 +671,11 @@ void EditorTabBar::mousePressEvent(QMouseEvent *event) {
                        if (!editor)
                          return;
 
+                       // Large files stay unhighlighted: only a window is loaded and
+                       // rehighlighting it on every window move is not worth the cost
+                       if (editor->isLargeFileMode())
+                         return;
+
                        // Remove old highlighter
                        if (tabInfoMap_.contains(index) &&
                            tabInfoMap_[index].highlighter) {
@@ -524,7 +710,11 @@ void EditorTabBar::mousePressEvent(QMouseEvent *event) {
 
                        const TabInfo &info = tabInfoMap_[index];
                        QString title = info.fileName;
-                       if (info.isModified) {
+                       if (info.isLoading) {
+                         title = "⏳ " + title;
+                       } else if (info.follower) {
+                         title = "⇣ " + title;
+                       } else if (info.isModified) {
                          title = "● " + title;
                        }
 
@@ -543,6 +733,14 @@ void EditorTabBar::mousePressEvent(QMouseEvent *event) {
 
                      void EditorTabWidget::onCurrentChanged(int index) {
                        if (index >= 0 && tabInfoMap_.contains(index)) {
+                         if (tabInfoMap_[index].isPlaceholder) {
+                           materializeTab(index);
+                         } else if (tabInfoMap_[index].isReclaimed) {
+                           // Layouts rebuild lazily on paint; only the highlighter is redone
+                           tabInfoMap_[index].isReclaimed = false;
+                           applyHighlighter(index, tabInfoMap_[index].filePath);
+                         }
+                         tabInfoMap_[index].lastActive = activityClock_.elapsed();
                          emit currentFileChanged(tabInfoMap_[index].filePath);
                          emit editorChanged(editorAt(index));
                        }
@@ -605,3 +803,553 @@ void EditorTabBar::mousePressEvent(QMouseEvent *event) {
                        return HighlighterFactory::createHighlighterForFile(
                            filePath, doc);
                      }
+
+                     void EditorTabWidget::beginLoad(int index, const QString &filePath) {
+                       CodeEditor *editor = editorAt(index);
+                       if (!editor || !tabInfoMap_.contains(index))
+                         return;
+
+                       tabInfoMap_[index].isLoading = true;
+                       editor->setReadOnly(true);
+                       updateTabTitle(index);
+                       loader_->load(filePath);
+                     }
+
+                     void EditorTabWidget::onFileLoaded(const QString &filePath,
+                                                        const LoadedText &text) {
+                       // The tab may have been closed while the file was loading
+                       int index = findTabByPath(filePath);
+                       if (index < 0 || !tabInfoMap_[index].isLoading)
+                         return;
+
+                       CodeEditor *editor = editorAt(index);
+                       if (!editor)
+                         return;
+
+                       // Compressed text already arrived through onFileChunkLoaded()
+                       if (!text.compressed) {
+                         editor->setPlainText(text.text);
+                         editor->setReadOnly(false);
+                       }
+                       editor->document()->setModified(false);
+
+                       TabInfo &info = tabInfoMap_[index];
+                       info.isLoading = false;
+                       info.isModified = false;
+                       info.lineEnding = text.lineEnding;
+                       info.hasBom = text.hasBom;
+                       if (info.journal) {
+                         info.journal->rebase(filePath);
+                       }
+                       if (!text.compressed) {
+                         watcher_->watch(filePath, text.disk);
+                       }
+                       if (info.restorePending) {
+                         applySessionState(index);
+                       }
+                       updateTabTitle(index);
+
+                       if (!text.validUtf8) {
+                         qWarning() << "Invalid UTF-8 replaced while loading" << filePath;
+                       }
+                     }
+
+                     void EditorTabWidget::onFileChunkLoaded(const QString &filePath,
+                                                             const QString &text, bool first) {
+                       int index = findTabByPath(filePath);
+                       if (index < 0 || !tabInfoMap_[index].isLoading)
+                         return;
+
+                       CodeEditor *editor = editorAt(index);
+                       if (!editor)
+                         return;
+
+                       TabInfo &info = tabInfoMap_[index];
+                       if (first) {
+                         // A read-only view without undo history or crash journal, which
+                         // would otherwise record every appended chunk
+                         info.isCompressed = true;
+                         if (info.journal) {
+                           info.journal->discard();
+                           delete info.journal;
+                           info.journal = nullptr;
+                         }
+                         editor->document()->setUndoRedoEnabled(false);
+                         editor->clear();
+                       }
+
+                       // The text so far is readable while the rest is still inflating
+                       QTextCursor cursor(editor->document());
+                       cursor.movePosition(QTextCursor::End);
+                       cursor.insertText(text);
+                       editor->document()->setModified(false);
+                     }
+
+                     void EditorTabWidget::onLoadFailed(const QString &filePath,
+                                                        const QString &error) {
+                       int index = findTabByPath(filePath);
+                       if (index < 0 || !tabInfoMap_[index].isLoading)
+                         return;
+
+                       tabInfoMap_[index].isLoading = false;
+                       closeTab(index);
+                       QMessageBox::warning(
+                           this, "Error",
+                           QString("Cannot open file: %1\n%2").arg(filePath, error));
+                     }
+
+                     void EditorTabWidget::onFileSaved(const QString &filePath,
+                                                       int revision) {
+                       int index = findTabByPath(filePath);
+                       CodeEditor *editor = editorAt(index);
+                       if (!editor)
+                         return;
+
+                       // The disk now holds our snapshot; its change events are not external
+                       watcher_->watch(filePath, DiskState::read(filePath));
+
+                       // Edits made while the snapshot was being written keep the tab dirty;
+                       // the journal then records the full text since its base is gone
+                       EditJournal *journal = tabInfoMap_[index].journal;
+                       if (editor->document()->revision() == revision) {
+                         editor->document()->setModified(false);
+                         if (journal) {
+                           journal->rebase(filePath);
+                         }
+                       } else if (journal) {
+                         journal->writeSnapshot();
+                       }
+                     }
+
+                     void EditorTabWidget::onSaveFailed(const QString &filePath, int revision,
+                                                        const QString &error) {
+                       Q_UNUSED(revision)
+                       QMessageBox::critical(
+                           this, "Error",
+                           QString("Cannot save file: %1\n%2").arg(filePath, error));
+                     }
+
+                     void EditorTabWidget::onFileChangedOnDisk(const QString &filePath) {
+                       int index = findTabByPath(filePath);
+                       if (index < 0 || saver_->isSaving(filePath))
+                         return; // Our own save reports the new disk state when it finishes
+
+                       TabInfo &info = tabInfoMap_[index];
+                       if (info.isPlaceholder) {
+                         // Reclaimed text is stale; the tab reads the disk when activated
+                         info.compressedText.clear();
+                         watcher_->unwatch(filePath);
+                         return;
+                       }
+
+                       CodeEditor *editor = editorAt(index);
+                       if (!editor || info.isLoading || info.isLargeFile)
+                         return;
+
+                       // Unsaved edits are only replaced on request. The dialog spins an event
+                       // loop, so further change events must not open another one.
+                       static bool asking = false;
+                       bool incremental = true;
+                       if (info.isModified) {
+                         if (asking)
+                           return;
+                         asking = true;
+                         QMessageBox::StandardButton reply = QMessageBox::question(
+                             this, "File Changed",
+                             QString("%1 was changed on disk. Reload it and discard your changes?")
+                                 .arg(info.fileName),
+                             QMessageBox::Yes | QMessageBox::No);
+                         asking = false;
+                         if (reply != QMessageBox::Yes) {
+                           watcher_->acknowledge(filePath);
+                           return;
+                         }
+                         incremental = false;
+                       }
+
+                       watcher_->reload(filePath, editor->toPlainText(),
+                                        editor->document()->revision(), incremental);
+                     }
+
+                     bool EditorTabWidget::setFollowing(int index, bool follow) {
+                       CodeEditor *editor = editorAt(index);
+                       if (!editor || !tabInfoMap_.contains(index))
+                         return false;
+
+                       TabInfo &info = tabInfoMap_[index];
+                       if (follow == (info.follower != nullptr))
+                         return true;
+
+                       if (follow) {
+                         if (info.isUntitled || info.isModified || info.isLoading || info.isLargeFile ||
+                             info.isCompressed)
+                           return false;
+
+                         // The follower reads appends itself, from the size the text was
+                         // loaded at, and a log view needs neither reload diffs nor a crash
+                         // journal
+                         qint64 loadedSize = watcher_->state(info.filePath).size;
+                         watcher_->unwatch(info.filePath);
+                         if (info.journal) {
+                           info.journal->discard();
+                           delete info.journal;
+                           info.journal = nullptr;
+                         }
+                         delete info.highlighter;
+                         info.highlighter = HighlighterFactory::createHighlighter(
+                             HighlighterFactory::Log, editor->document());
+                         if (theme_) {
+                           info.highlighter->setTheme(theme_);
+                         }
+
+                         Settings settings;
+                         info.follower =
+                             new TailFollower(editor, info.filePath, settings.tailMaxLines(),
+                                              loadedSize);
+                       } else {
+                         delete info.follower;
+                         info.follower = nullptr;
+
+                         // The buffer only holds the newest lines; saving it would drop the
+                         // rest of the file, so the whole file is read again. The load
+                         // rebases the journal and watches the file once it is in.
+                         info.journal = new EditJournal(editor->document());
+                         applyHighlighter(index, info.filePath);
+                         beginLoad(index, info.filePath);
+                       }
+
+                       updateTabTitle(index);
+                       return true;
+                     }
+
+                     TailFollower *EditorTabWidget::followerAt(int index) const {
+                       return tabInfoMap_.contains(index) ? tabInfoMap_[index].follower : nullptr;
+                     }
+
+                     void EditorTabWidget::onFileRemovedOnDisk(const QString &filePath) {
+                       // Keep the text, but closing the tab now offers to write it back
+                       CodeEditor *editor = editorAt(findTabByPath(filePath));
+                       if (editor) {
+                         editor->document()->setModified(true);
+                       }
+                     }
+
+                     void EditorTabWidget::onReloadReady(const QString &filePath,
+                                                         const ReloadResult &result) {
+                       int index = findTabByPath(filePath);
+                       CodeEditor *editor = editorAt(index);
+                       if (!editor)
+                         return;
+
+                       // The buffer changed while the file was diffed: the hunks no longer fit
+                       QTextDocument *document = editor->document();
+                       TabInfo &info = tabInfoMap_[index];
+                       if (document->revision() != result.revision) {
+                         watcher_->reload(filePath, editor->toPlainText(), document->revision(),
+                                          !info.isModified);
+                         return;
+                       }
+
+                       FileWatcher::apply(document, result);
+                       if (!result.appended) {
+                         info.lineEnding = result.lineEnding;
+                         info.hasBom = result.hasBom;
+                       }
+                       document->setModified(false);
+                       if (info.journal) {
+                         info.journal->rebase(filePath);
+                       }
+                       watcher_->watch(filePath, result.disk);
+                     }
+
+                     int EditorTabWidget::openRecovered(const QString &filePath,
+                                                        const QString &text) {
+                       int index = newTab();
+                       CodeEditor *editor = editorAt(index);
+                       TabInfo &info = tabInfoMap_[index];
+
+                       if (!filePath.isEmpty()) {
+                         info.isUntitled = false;
+                         info.filePath = filePath;
+                         info.fileName = QFileInfo(filePath).fileName();
+                         editor->setFilePath(filePath);
+                         applyHighlighter(index, filePath);
+                       }
+
+                       editor->setPlainText(text);
+                       info.journal->rebase(filePath);
+                       info.journal->writeSnapshot();
+                       editor->document()->setModified(true);
+                       updateTabTitle(index);
+                       emit currentFileChanged(filePath);
+
+                       return index;
+                     }
+
+                     // ==================== Session restore ====================
+
+                     void EditorTabWidget::restoreSession(const QVector<SessionTab> &tabs,
+                                                          int activeTab) {
+                       // Placeholders are bare widgets: no editor, document, highlighter or
+                       // file I/O until the tab is first activated. Signals stay blocked so
+                       // adding them does not materialize each one in turn.
+                       int active = -1;
+                       blockSignals(true);
+                       for (int i = 0; i < tabs.size(); ++i) {
+                         const SessionTab &tab = tabs[i];
+                         if (!QFileInfo::exists(tab.filePath) ||
+                             findTabByPath(tab.filePath) >= 0)
+                           continue;
+
+                         TabInfo info;
+                         info.isUntitled = false;
+                         info.isPlaceholder = true;
+                         info.filePath = tab.filePath;
+                         info.fileName = QFileInfo(tab.filePath).fileName();
+                         info.session = tab;
+
+                         int index = addTab(new QWidget(this), info.fileName);
+                         tabInfoMap_[index] = info;
+                         if (i == activeTab || active < 0) {
+                           active = index;
+                         }
+                       }
+                       if (active >= 0) {
+                         setCurrentIndex(active);
+                       }
+                       blockSignals(false);
+
+                       if (active >= 0) {
+                         onCurrentChanged(currentIndex());
+                       }
+                       emit tabCountChanged(count());
+                     }
+
+                     QVector<SessionTab> EditorTabWidget::sessionState(int *activeTab) const {
+                       QVector<SessionTab> tabs;
+                       *activeTab = 0;
+
+                       for (int i = 0; i < count(); ++i) {
+                         if (!tabInfoMap_.contains(i))
+                           continue;
+                         const TabInfo &info = tabInfoMap_[i];
+                         if (info.isUntitled || info.filePath.isEmpty() || info.isBinary)
+                           continue;
+
+                         if (i == currentIndex()) {
+                           *activeTab = tabs.size();
+                         }
+
+                         tabs.append(captureSessionTab(i));
+                       }
+                       return tabs;
+                     }
+
+                     QVector<BufferSnapshot> EditorTabWidget::bufferSnapshots() const {
+                       QVector<BufferSnapshot> buffers;
+                       for (int i = 0; i < count(); ++i) {
+                         if (!tabInfoMap_.contains(i))
+                           continue;
+                         const TabInfo &info = tabInfoMap_[i];
+                         // Results are reopened by path; large files and hex views do not hold
+                         // their whole text
+                         if (info.isUntitled || info.filePath.isEmpty() || info.isBinary ||
+                             info.isLargeFile || info.isLoading)
+                           continue;
+                     
+                         BufferSnapshot buffer;
+                         buffer.filePath = info.filePath;
+                         if (info.isPlaceholder) {
+                           // Reclaimed clean text stays compressed until a worker needs it;
+                           // restored tabs never shown have nothing beyond the file on disk
+                           if (info.compressedText.isEmpty())
+                             continue;
+                           buffer.compressedUtf8 = info.compressedText;
+                         } else {
+                           CodeEditor *editor = editorAt(i);
+                           if (!editor || editor->isLargeFileMode())
+                             continue;
+                           buffer.text = editor->toPlainText();
+                         }
+                         buffers.append(buffer);
+                       }
+                       return buffers;
+                     }
+
+                     SessionTab EditorTabWidget::captureSessionTab(int index) const {
+                       const TabInfo &info = tabInfoMap_[index];
+
+                       // Untouched placeholders keep the state they were restored with
+                       CodeEditor *editor = editorAt(index);
+                       if (info.isPlaceholder || info.restorePending || !editor) {
+                         return info.session;
+                       }
+
+                       SessionTab tab;
+                       tab.filePath = info.filePath;
+                       if (!editor->isLargeFileMode()) {
+                         tab.cursorPosition = editor->textCursor().position();
+                         tab.firstVisibleLine = editor->getFirstVisibleBlock().blockNumber();
+                         if (editor->codeFolding()) {
+                           const QMap<int, FoldRegion> &regions =
+                               editor->codeFolding()->regions();
+                           for (auto it = regions.begin(); it != regions.end(); ++it) {
+                             if (it->isFolded)
+                               tab.foldedLines.append(it.key());
+                           }
+                         }
+                       }
+                       return tab;
+                     }
+
+                     void EditorTabWidget::materializeTab(int index) {
+                       TabInfo placeholder = tabInfoMap_.value(index);
+                       QWidget *page = widget(index);
+
+                       // Swap the placeholder page for a real editor at the same position
+                       // without re-entering onCurrentChanged. Reclaimed tabs come back from
+                       // their compressed text instead of the disk.
+                       bool hasText = !placeholder.compressedText.isEmpty();
+                       QString text;
+                       if (hasText) {
+                         text = QString::fromUtf8(qUncompress(placeholder.compressedText));
+                       }
+
+                       blockSignals(true);
+                       removeTab(index);
+                       if (insertEditorTab(index, placeholder.filePath,
+                                           hasText ? &text : nullptr) < 0) {
+                         // A large file that can no longer be mapped: the tab goes
+                         removeTabInfo(index);
+                         blockSignals(false);
+                         page->deleteLater();
+                         emit tabCountChanged(count());
+                         emit currentChanged(currentIndex());
+                         return;
+                       }
+                       setCurrentIndex(index);
+                       blockSignals(false);
+                       page->deleteLater();
+
+                       TabInfo &info = tabInfoMap_[index];
+                       if (hasText) {
+                         info.lineEnding = placeholder.lineEnding;
+                         info.hasBom = placeholder.hasBom;
+                       }
+                       info.session = placeholder.session;
+                       info.restorePending = true;
+                       if (!info.isLoading) {
+                         applySessionState(index);
+                       }
+                     }
+
+                     void EditorTabWidget::applySessionState(int index) {
+                       CodeEditor *editor = editorAt(index);
+                       TabInfo &info = tabInfoMap_[index];
+                       info.restorePending = false;
+                       if (!editor || editor->isLargeFileMode())
+                         return;
+
+                       const SessionTab &session = info.session;
+                       if (editor->codeFolding() && !session.foldedLines.isEmpty()) {
+                         CodeFolding *folding = editor->codeFolding();
+                         folding->analyzeFoldRegions();
+                         for (int line : session.foldedLines) {
+                           if (folding->isFoldable(line) && !folding->isFolded(line))
+                             folding->toggleFoldAtLine(line);
+                         }
+                       }
+
+                       QTextCursor cursor(editor->document());
+                       cursor.setPosition(qBound(0, session.cursorPosition,
+                                                 editor->document()->characterCount() - 1));
+                       editor->setTextCursor(cursor);
+                       editor->verticalScrollBar()->setValue(session.firstVisibleLine);
+                     }
+
+                     // ==================== Memory reclamation ====================
+
+                     void EditorTabWidget::reclaimInactiveTabs() {
+                       Settings settings;
+                       qint64 idleLimit = qint64(settings.tabReclaimMinutes()) * 60 * 1000;
+                       if (idleLimit <= 0)
+                         return;
+
+                       qint64 now = activityClock_.elapsed();
+                       int current = currentIndex();
+                       if (tabInfoMap_.contains(current)) {
+                         tabInfoMap_[current].lastActive = now;
+                       }
+
+                       for (int i = 0; i < count(); ++i) {
+                         if (i == current || !tabInfoMap_.contains(i))
+                           continue;
+                         const TabInfo &info = tabInfoMap_[i];
+                         if (info.isPlaceholder || info.isReclaimed || info.isLoading || info.follower ||
+                             info.isLargeFile || info.isUntitled || info.isCompressed || info.isBinary)
+                           continue;
+                         if (now - info.lastActive >= idleLimit) {
+                           reclaimTab(i);
+                         }
+                       }
+                     }
+
+                     void EditorTabWidget::reclaimTab(int index) {
+                       CodeEditor *editor = editorAt(index);
+                       if (!editor)
+                         return;
+
+                       TabInfo &info = tabInfoMap_[index];
+                       delete info.highlighter; // Also clears its formats from the layouts
+                       info.highlighter = nullptr;
+
+                       if (!info.isModified && !editor->document()->isModified()) {
+                         // Clean buffer: keep compressed UTF-8 plus the view state and turn
+                         // the tab back into a placeholder without a document. The journal
+                         // has nothing to recover; it is dropped here, while its document
+                         // still exists, rather than left to the document's destruction.
+                         // materializeTab() starts a new one over the same text.
+                         if (info.journal) {
+                           info.journal->discard();
+                           delete info.journal;
+                           info.journal = nullptr;
+                         }
+
+                         TabInfo placeholder;
+                         placeholder.isUntitled = false;
+                         placeholder.isPlaceholder = true;
+                         placeholder.filePath = info.filePath;
+                         placeholder.fileName = info.fileName;
+                         placeholder.lineEnding = info.lineEnding;
+                         placeholder.hasBom = info.hasBom;
+                         placeholder.session = captureSessionTab(index);
+                         placeholder.compressedText = qCompress(editor->toPlainText().toUtf8());
+
+                         QWidget *current = currentWidget();
+                         blockSignals(true);
+                         removeTab(index);
+                         insertTab(index, new QWidget(this), placeholder.fileName);
+                         setCurrentWidget(current);
+                         blockSignals(false);
+                         editor->deleteLater();
+
+                         tabInfoMap_[index] = placeholder;
+                         updateTabTitle(index);
+                         return;
+                       }
+
+                       // Modified buffer: the document stays, and with it the journal of the
+                       // unsaved edits; everything derived from it goes.
+                       // QPlainTextDocumentLayout lays blocks out again on demand.
+                       for (QTextBlock block = editor->document()->begin(); block.isValid();
+                            block = block.next()) {
+                         if (QTextLayout *layout = block.layout()) {
+                           layout->clearLayout();
+                         }
+                         if (BlockData *data = BlockData::peek(block)) {
+                           data->minimapRuns = QVector<MinimapRun>();
+                           data->minimapValid = false;
+                         }
+                       }
+                       info.isReclaimed = true;
+                     }
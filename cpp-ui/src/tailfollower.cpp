@@ -0,0 +1,273 @@
+#include "tailfollower.h"
+#include "codeeditor.h"
+#include "fileloader.h"
+#include <QDateTime>
+#include <QFile>
+#include <QFileInfo>
+#include <QFileSystemWatcher>
+#include <QScrollBar>
+#include <QTextBlock>
+#include <QTextCursor>
+#include <QTextDocument>
+#include <QThreadPool>
+#include <QTimer>
+
+#ifdef Q_OS_UNIX
+#include <sys/stat.h>
+#endif
+
+namespace {
+
+// New lines are appended at most this often
+const int kBatchMs = 100;
+
+// After a long pause only the newest data matters; the ring drops the
+// rest anyway
+const qint64 kMaxReadBytes = 16 * 1024 * 1024;
+
+} // namespace
+
+// ==================== TailFollower ====================
+
+TailFollower::TailFollower(CodeEditor *editor, const QString &filePath,
+                           int maxLines, qint64 loadedSize)
+    : QObject(editor), editor_(editor), filePath_(filePath),
+      maxLines_(qMax(1, maxLines)), watcher_(new QFileSystemWatcher(this)),
+      batchTimer_(new QTimer(this)), offset_(0), fileId_(0), reading_(false),
+      readAgain_(false), wasReadOnly_(editor->isReadOnly()) {
+  qRegisterMetaType<TailChunk>("TailChunk");
+
+  QFile file(filePath_);
+  if (file.open(QIODevice::ReadOnly)) {
+    // Past the current end means the file was truncated since the load;
+    // the first read then starts over from 0
+    offset_ = loadedSize >= 0 ? loadedSize : file.size();
+    fileId_ = TailReadJob::fileIdentity(file);
+  }
+
+  // A log view: no typing, and no undo stack growing with every batch
+  editor_->setReadOnly(true);
+  editor_->document()->setUndoRedoEnabled(false);
+
+  batchTimer_->setSingleShot(true);
+  batchTimer_->setInterval(kBatchMs);
+  connect(batchTimer_, &QTimer::timeout, this, &TailFollower::flush);
+
+  // The directory reports the file being rotated away and recreated
+  watcher_->addPath(filePath_);
+  watcher_->addPath(QFileInfo(filePath_).absolutePath());
+  connect(watcher_, &QFileSystemWatcher::fileChanged, this,
+          &TailFollower::onChanged);
+  connect(watcher_, &QFileSystemWatcher::directoryChanged, this,
+          &TailFollower::onChanged);
+
+  trimToLimit();
+  editor_->document()->setModified(false);
+
+  // Catch up with anything written since the text was loaded
+  startRead();
+}
+
+TailFollower::~TailFollower() {
+  // Also destroyed as a child of the editor, after it is gone
+  if (editor_) {
+    // Lines hidden by the filter would otherwise stay hidden for editing
+    if (!filter_.pattern().isEmpty()) {
+      filter_ = QRegularExpression();
+      applyFilter(editor_->document()->firstBlock());
+    }
+    editor_->setReadOnly(wasReadOnly_);
+    editor_->document()->setUndoRedoEnabled(true);
+  }
+}
+
+bool TailFollower::setFilter(const QString &pattern) {
+  QRegularExpression filter(pattern);
+  if (!filter.isValid()) {
+    return false;
+  }
+  filter_ = filter;
+  applyFilter(editor_->document()->firstBlock());
+  return true;
+}
+
+void TailFollower::onChanged() {
+  if (!watcher_->files().contains(filePath_) && QFileInfo::exists(filePath_)) {
+    watcher_->addPath(filePath_);
+  }
+  startRead();
+}
+
+void TailFollower::startRead() {
+  // One read at a time; a change during a read triggers one more
+  if (reading_) {
+    readAgain_ = true;
+    return;
+  }
+  reading_ = true;
+
+  TailReadJob *job = new TailReadJob(filePath_, offset_, fileId_);
+  connect(job, &TailReadJob::finished, this, &TailFollower::onReadFinished,
+          Qt::QueuedConnection);
+  QThreadPool::globalInstance()->start(job);
+}
+
+void TailFollower::onReadFinished(const TailChunk &chunk) {
+  reading_ = false;
+
+  // A missing file is normal mid-rotation; the directory watch brings
+  // us back once it is recreated
+  if (chunk.error.isEmpty()) {
+    if (chunk.restarted) {
+      emit restarted();
+    }
+    offset_ = chunk.offset;
+    fileId_ = chunk.fileId;
+    if (!chunk.text.isEmpty()) {
+      pending_ += chunk.text;
+      if (!batchTimer_->isActive()) {
+        batchTimer_->start();
+      }
+    }
+  }
+
+  if (readAgain_) {
+    readAgain_ = false;
+    startRead();
+  }
+}
+
+void TailFollower::flush() {
+  if (pending_.isEmpty()) {
+    return;
+  }
+
+  // Stay pinned to the bottom only if the user was already there
+  QScrollBar *scrollBar = editor_->verticalScrollBar();
+  bool atBottom = scrollBar->value() >= scrollBar->maximum();
+
+  QTextDocument *document = editor_->document();
+  int firstNew = document->blockCount() - 1;
+
+  QTextCursor cursor(document);
+  cursor.beginEditBlock();
+  cursor.movePosition(QTextCursor::End);
+  cursor.insertText(pending_);
+  pending_.clear();
+  int dropped = trimToLimit();
+  cursor.endEditBlock();
+
+  applyFilter(document->findBlockByNumber(qMax(0, firstNew - dropped)));
+
+  // Following is viewing, not editing
+  document->setModified(false);
+
+  if (atBottom) {
+    scrollBar->setValue(scrollBar->maximum());
+  }
+  emit appended();
+}
+
+// Drops the oldest lines beyond the limit. The last block is the empty
+// one after the final newline and does not count.
+int TailFollower::trimToLimit() {
+  QTextDocument *document = editor_->document();
+  int excess = document->blockCount() - 1 - maxLines_;
+  if (excess <= 0) {
+    return 0;
+  }
+
+  QTextCursor cursor(document);
+  cursor.setPosition(0);
+  cursor.setPosition(document->findBlockByNumber(excess).position(),
+                     QTextCursor::KeepAnchor);
+  cursor.removeSelectedText();
+  return excess;
+}
+
+void TailFollower::applyFilter(const QTextBlock &from) {
+  if (!from.isValid()) {
+    return;
+  }
+
+  bool showAll = filter_.pattern().isEmpty();
+  bool changed = false;
+  for (QTextBlock block = from; block.isValid(); block = block.next()) {
+    bool visible = showAll || filter_.match(block.text()).hasMatch() ||
+                   !block.next().isValid();
+    if (block.isVisible() != visible) {
+      block.setVisible(visible);
+      changed = true;
+    }
+  }
+
+  if (changed) {
+    QTextDocument *document = editor_->document();
+    document->markContentsDirty(from.position(),
+                                document->characterCount() - from.position());
+    editor_->viewport()->update();
+  }
+}
+
+// ==================== TailReadJob ====================
+
+TailReadJob::TailReadJob(const QString &filePath, qint64 offset,
+                         quint64 fileId)
+    : filePath_(filePath), offset_(offset), fileId_(fileId) {}
+
+quint64 TailReadJob::fileIdentity(const QFile &file) {
+#ifdef Q_OS_UNIX
+  struct stat info;
+  if (fstat(file.handle(), &info) == 0) {
+    return (quint64(info.st_dev) << 32) ^ quint64(info.st_ino);
+  }
+  return 0;
+#else
+  return quint64(file.fileTime(QFileDevice::FileBirthTime).toMSecsSinceEpoch());
+#endif
+}
+
+void TailReadJob::run() {
+  TailChunk chunk;
+  QFile file(filePath_);
+  if (!file.open(QIODevice::ReadOnly)) {
+    chunk.error = file.errorString();
+    emit finished(chunk);
+    deleteLater();
+    return;
+  }
+
+  // A different file behind the path was rotated in; a shorter one was
+  // truncated. Either way, start over.
+  chunk.fileId = fileIdentity(file);
+  qint64 size = file.size();
+  qint64 offset = offset_;
+  if ((fileId_ != 0 && chunk.fileId != fileId_) || size < offset) {
+    offset = 0;
+    chunk.restarted = true;
+  }
+
+  bool skipPartialLine = false;
+  if (size - offset > kMaxReadBytes) {
+    offset = size - kMaxReadBytes;
+    skipPartialLine = true;
+  }
+
+  QByteArray bytes;
+  if (size > offset && file.seek(offset)) {
+    bytes = file.read(size - offset);
+  }
+  if (skipPartialLine) {
+    int cut = bytes.indexOf('\n') + 1;
+    bytes.remove(0, cut);
+    offset += cut;
+  }
+
+  // Only whole lines; a partial one is read again once it is finished
+  int end = bytes.lastIndexOf('\n') + 1;
+  chunk.text = FileLoader::decodeUtf8(bytes.constData(), end).text;
+  chunk.offset = offset + end;
+
+  emit finished(chunk);
+  deleteLater();
+}
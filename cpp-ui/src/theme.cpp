@@ -616,22 +616,22 @@ QString Theme::getFuzzyFinderStyleSheet() const {
         QWidget#FuzzyFinder QLineEdit:focus {
             border-bottom-color: %5;
         }
-        QWidget#FuzzyFinder QListWidget {
+        QWidget#FuzzyFinder QListView {
             background-color: transparent;
             color: %4;
             border: none;
             outline: none;
             padding: 8px;
         }
-        QWidget#FuzzyFinder QListWidget::item {
+        QWidget#FuzzyFinder QListView::item {
             padding: 10px 16px;
             border-radius: 6px;
             margin: 2px 4px;
         }
-        QWidget#FuzzyFinder QListWidget::item:hover {
+        QWidget#FuzzyFinder QListView::item:hover {
             background-color: %6;
         }
-        QWidget#FuzzyFinder QListWidget::item:selected {
+        QWidget#FuzzyFinder QListView::item:selected {
             background-color: %7;
             color: %8;
         }
@@ -0,0 +1,841 @@
+#include "trigramindex.h"
+#include "gzipdevice.h"
+#include "workspaceindex.h"
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QHash>
+#include <QMutex>
+#include <QReadLocker>
+#include <QReadWriteLock>
+#include <QSaveFile>
+#include <QSet>
+#include <QStandardPaths>
+#include <QThread>
+#include <QThreadPool>
+#include <QTimer>
+#include <QVector>
+#include <QWriteLocker>
+#include <QtEndian>
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <vector>
+
+namespace {
+
+// Workspace changes come in bursts; the index follows once they settle
+const int kUpdateDelayMs = 1000;
+
+const quint32 kCacheMagic = 0x43595447; // "CYTG"
+const quint32 kCacheVersion = 2;
+
+// Mapped cache file: header, posting lists, documents, trigram table and
+// trailer, all little-endian. Table entries are sorted by trigram.
+const int kHeaderBytes = 8;      // magic, version
+const int kTableEntryBytes = 16; // trigram, count, offset of the list
+const int kTrailerBytes = 36;    // offsets, counts, generation, magic
+
+// Ids in the in-memory delta before it is merged into a new cache file
+const qint64 kMaxDeltaIds = 4 * 1024 * 1024;
+
+// Larger files are not indexed, and so always searched
+const qint64 kMaxIndexedBytes = 64 * 1024 * 1024;
+
+// Files with a NUL byte this close to the start are never searched
+const qint64 kBinaryProbeBytes = 8192;
+
+// Dead documents tolerated before the posting lists are rewritten
+const int kMinDeadForCompaction = 1024;
+
+// Files checked against the disk between updates of the unverified set
+const int kVerifyBatch = 512;
+
+inline char foldAscii(char c) {
+  return (c >= 'A' && c <= 'Z') ? char(c + ('a' - 'A')) : c;
+}
+
+// Ids of the documents holding one trigram: the mapped list, then the
+// delta's, whose ids are all higher, so the whole is ascending
+struct PostingList {
+  const uchar *base = nullptr;
+  int baseCount = 0;
+  const QVector<quint32> *delta = nullptr;
+
+  int size() const { return baseCount + (delta ? delta->size() : 0); }
+
+  quint32 at(int i) const {
+    return i < baseCount ? qFromLittleEndian<quint32>(base + 4 * qint64(i))
+                         : delta->at(i - baseCount);
+  }
+
+  bool contains(quint32 id) const {
+    int low = 0;
+    int high = size();
+    while (low < high) {
+      int middle = low + (high - low) / 2;
+      quint32 value = at(middle);
+      if (value == id) {
+        return true;
+      }
+      if (value < id) {
+        low = middle + 1;
+      } else {
+        high = middle;
+      }
+    }
+    return false;
+  }
+};
+
+} // namespace
+
+struct TrigramDoc {
+  enum State : quint8 {
+    Dead,      // Replaced or removed; ids in posting lists are skipped
+    Indexed,   // Trigrams are in the posting lists
+    Binary,    // Never searched, so never a candidate
+    Unindexed  // Too large or compressed; always a candidate
+  };
+
+  QString path;
+  qint64 modified = 0;
+  qint64 size = 0;
+  quint8 state = Dead;
+};
+
+// Shared by a TrigramIndex and its update job, which may outlive it
+struct TrigramData {
+  QReadWriteLock lock;
+  QVector<TrigramDoc> docs;                  // Indexed by document id
+  QHash<QString, quint32> ids;               // Live documents by path
+  QSet<QString> unindexed;                   // Live, state Unindexed
+  QSet<QString> pending;                     // Listed, not indexed yet
+  QSet<QString> unverified; // Not compared with the disk yet in the
+                            // running pass, so postings may be stale
+  int deadDocs = 0;
+  bool listed = false; // pending is complete, so queries can narrow
+
+  // Posting lists of documents [0, baseDocs), mapped from the cache file
+  // rather than loaded
+  QFile baseFile;
+  const uchar *base = nullptr;
+  const uchar *table = nullptr;
+  quint32 tableCount = 0;
+  quint32 baseDocs = 0;
+  quint64 generation = 0; // Matches the delta written against the file
+
+  // Lists of the documents indexed since: trigram -> ascending ids
+  QHash<quint32, QVector<quint32>> delta;
+  qint64 deltaIds = 0;
+
+  std::atomic<bool> cancelled{false};
+};
+
+// Found by the container stream operators through argument-dependent
+// lookup, so these cannot live in the anonymous namespace
+static QDataStream &operator<<(QDataStream &out, const TrigramDoc &doc) {
+  return out << doc.path << doc.modified << doc.size << doc.state;
+}
+
+static QDataStream &operator>>(QDataStream &in, TrigramDoc &doc) {
+  return in >> doc.path >> doc.modified >> doc.size >> doc.state;
+}
+
+static PostingList postingList(const TrigramData &data, quint32 trigram) {
+  PostingList list;
+  quint32 low = 0;
+  quint32 high = data.tableCount;
+  while (low < high) {
+    quint32 middle = low + (high - low) / 2;
+    const uchar *entry = data.table + qint64(middle) * kTableEntryBytes;
+    quint32 key = qFromLittleEndian<quint32>(entry);
+    if (key == trigram) {
+      list.baseCount = int(qFromLittleEndian<quint32>(entry + 4));
+      list.base = data.base + qFromLittleEndian<quint64>(entry + 8);
+      break;
+    }
+    if (key < trigram) {
+      low = middle + 1;
+    } else {
+      high = middle;
+    }
+  }
+
+  auto it = data.delta.constFind(trigram);
+  if (it != data.delta.constEnd()) {
+    list.delta = &it.value();
+  }
+  return list;
+}
+
+static void unmapBase(TrigramData &data) {
+  if (data.base) {
+    data.baseFile.unmap(const_cast<uchar *>(data.base));
+  }
+  data.baseFile.close();
+  data.base = nullptr;
+  data.table = nullptr;
+  data.tableCount = 0;
+}
+
+// Maps the posting lists of a cache file; its documents are read into
+// docs if given
+static bool mapBase(TrigramData &data, const QString &path,
+                    const QString &rootPath, QVector<TrigramDoc> *docs) {
+  unmapBase(data);
+  data.baseFile.setFileName(path);
+  if (!data.baseFile.open(QIODevice::ReadOnly)) {
+    return false;
+  }
+  const qint64 size = data.baseFile.size();
+  uchar *map = size >= kHeaderBytes + kTrailerBytes
+                   ? data.baseFile.map(0, size)
+                   : nullptr;
+  if (!map) {
+    data.baseFile.close();
+    return false;
+  }
+  data.base = map;
+
+  const uchar *trailer = map + size - kTrailerBytes;
+  quint64 docsOffset = qFromLittleEndian<quint64>(trailer);
+  quint64 tableOffset = qFromLittleEndian<quint64>(trailer + 8);
+  quint32 tableCount = qFromLittleEndian<quint32>(trailer + 16);
+  quint32 docCount = qFromLittleEndian<quint32>(trailer + 20);
+  quint64 generation = qFromLittleEndian<quint64>(trailer + 24);
+  bool valid =
+      qFromLittleEndian<quint32>(map) == kCacheMagic &&
+      qFromLittleEndian<quint32>(map + 4) == kCacheVersion &&
+      qFromLittleEndian<quint32>(trailer + 32) == kCacheMagic &&
+      docsOffset >= quint64(kHeaderBytes) && docsOffset <= tableOffset &&
+      tableOffset + quint64(tableCount) * kTableEntryBytes ==
+          quint64(size - kTrailerBytes);
+
+  // Every list must lie before the documents, in trigram order
+  quint32 previous = 0;
+  for (quint32 i = 0; valid && i < tableCount; ++i) {
+    const uchar *entry = map + tableOffset + qint64(i) * kTableEntryBytes;
+    quint32 trigram = qFromLittleEndian<quint32>(entry);
+    quint64 count = qFromLittleEndian<quint32>(entry + 4);
+    quint64 offset = qFromLittleEndian<quint64>(entry + 8);
+    valid = (i == 0 || trigram > previous) && offset >= quint64(kHeaderBytes) &&
+            offset <= docsOffset && count * 4 <= docsOffset - offset;
+    previous = trigram;
+  }
+
+  if (valid && docs) {
+    QDataStream in(QByteArray::fromRawData(
+        reinterpret_cast<const char *>(map + docsOffset),
+        int(tableOffset - docsOffset)));
+    in.setByteOrder(QDataStream::LittleEndian);
+    QString root;
+    in >> root >> *docs;
+    valid = in.status() == QDataStream::Ok && root == rootPath &&
+            docs->size() == int(docCount);
+  }
+  if (!valid) {
+    unmapBase(data);
+    return false;
+  }
+
+  data.table = map + tableOffset;
+  data.tableCount = tableCount;
+  data.baseDocs = docCount;
+  data.generation = generation;
+  return true;
+}
+
+// Nothing indexed; queries search everything until the next pass
+static void clearIndex(TrigramData &data) {
+  unmapBase(data);
+  data.docs.clear();
+  data.ids.clear();
+  data.unindexed.clear();
+  data.delta.clear();
+  data.deltaIds = 0;
+  data.baseDocs = 0;
+  data.deadDocs = 0;
+  data.listed = false;
+}
+
+// ==================== TrigramIndex ====================
+
+TrigramIndex *TrigramIndex::forIndex(WorkspaceIndex *index) {
+  // Lives as long as the workspace index it follows
+  TrigramIndex *trigrams =
+      index->findChild<TrigramIndex *>(QString(), Qt::FindDirectChildrenOnly);
+  if (!trigrams) {
+    trigrams = new TrigramIndex(index);
+  }
+  return trigrams;
+}
+
+TrigramIndex::TrigramIndex(WorkspaceIndex *index)
+    : QObject(index), index_(index), data_(std::make_shared<TrigramData>()),
+      updateTimer_(new QTimer(this)), updating_(false), cacheRead_(false) {
+  updateTimer_->setSingleShot(true);
+  updateTimer_->setInterval(kUpdateDelayMs);
+  connect(updateTimer_, &QTimer::timeout, this, &TrigramIndex::startUpdate);
+
+  connect(index_, &WorkspaceIndex::updated, this,
+          &TrigramIndex::onIndexUpdated);
+  onIndexUpdated();
+}
+
+TrigramIndex::~TrigramIndex() {
+  // A running job finishes early and drops its reference
+  data_->cancelled = true;
+}
+
+bool TrigramIndex::candidates(const QString &needle,
+                              QStringList &files) const {
+  QByteArray lower = needle.toUtf8();
+  for (int i = 0; i < lower.size(); ++i) {
+    lower[i] = foldAscii(lower[i]);
+  }
+
+  // Only ASCII case is folded in the lists; other letters may match in
+  // another case, so trigrams with non-ASCII bytes cannot narrow
+  QVector<quint32> trigrams;
+  for (int i = 2; i < lower.size(); ++i) {
+    if ((lower[i - 2] | lower[i - 1] | lower[i]) & 0x80) {
+      continue;
+    }
+    quint32 trigram = (quint32(uchar(lower[i - 2])) << 16) |
+                      (quint32(uchar(lower[i - 1])) << 8) |
+                      quint32(uchar(lower[i]));
+    if (!trigrams.contains(trigram)) {
+      trigrams.append(trigram);
+    }
+  }
+  if (trigrams.isEmpty()) {
+    return false;
+  }
+
+  QReadLocker locker(&data_->lock);
+  if (!data_->listed) {
+    return false;
+  }
+
+  // The shortest list is copied, and only shrinks as the others are
+  // probed by binary search; the rest of the mapped lists is never read
+  QVector<PostingList> lists;
+  for (quint32 trigram : trigrams) {
+    PostingList list = postingList(*data_, trigram);
+    if (list.size() == 0) {
+      lists.clear();
+      break;
+    }
+    lists.append(list);
+  }
+  std::sort(lists.begin(), lists.end(),
+            [](const PostingList &a, const PostingList &b) {
+              return a.size() < b.size();
+            });
+
+  files.clear();
+  if (!lists.isEmpty()) {
+    QVector<quint32> ids;
+    ids.reserve(lists.first().size());
+    for (int i = 0; i < lists.first().size(); ++i) {
+      ids.append(lists.first().at(i));
+    }
+    for (int i = 1; i < lists.size() && !ids.isEmpty(); ++i) {
+      QVector<quint32> narrowed;
+      for (quint32 id : ids) {
+        if (lists[i].contains(id)) {
+          narrowed.append(id);
+        }
+      }
+      ids.swap(narrowed);
+    }
+    // Stale postings are not trusted; those files are listed below
+    for (quint32 id : ids) {
+      const TrigramDoc &doc = data_->docs.at(int(id));
+      if (doc.state == TrigramDoc::Indexed &&
+          !data_->pending.contains(doc.path) &&
+          !data_->unverified.contains(doc.path)) {
+        files.append(doc.path);
+      }
+    }
+  }
+  for (const QString &path : data_->unindexed) {
+    files.append(path);
+  }
+  for (const QString &path : data_->pending) {
+    files.append(path);
+  }
+  for (const QString &path : data_->unverified) {
+    if (!data_->pending.contains(path) && !data_->unindexed.contains(path)) {
+      files.append(path);
+    }
+  }
+  return true;
+}
+
+void TrigramIndex::refresh() {
+  if (index_->isReady()) {
+    updateTimer_->stop();
+    startUpdate();
+  }
+}
+
+void TrigramIndex::onIndexUpdated() {
+  // The cached file list is not worth indexing against; wait for the
+  // one that was checked against the disk
+  if (index_->isReady()) {
+    updateTimer_->start();
+  }
+}
+
+void TrigramIndex::startUpdate() {
+  // One job at a time; a change during it starts another afterwards
+  if (updating_) {
+    updateTimer_->start();
+    return;
+  }
+  updating_ = true;
+
+  TrigramUpdateJob *job =
+      new TrigramUpdateJob(data_, index_->rootPath(), index_->files(),
+                           cachePath(), !cacheRead_);
+  cacheRead_ = true;
+  connect(job, &TrigramUpdateJob::finished, this,
+          &TrigramIndex::onUpdateFinished, Qt::QueuedConnection);
+  QThreadPool::globalInstance()->start(job);
+}
+
+void TrigramIndex::onUpdateFinished() {
+  updating_ = false;
+  emit updated();
+}
+
+QString TrigramIndex::cachePath() const {
+  QByteArray key = QCryptographicHash::hash(index_->rootPath().toUtf8(),
+                                            QCryptographicHash::Sha1);
+  return QStandardPaths::writableLocation(QStandardPaths::CacheLocation) +
+         "/workspace-index/" + QString::fromLatin1(key.toHex()) + ".tri";
+}
+
+// ==================== TrigramUpdateJob ====================
+
+TrigramUpdateJob::TrigramUpdateJob(std::shared_ptr<TrigramData> data,
+                                   const QString &rootPath,
+                                   const QStringList &files,
+                                   const QString &cachePath, bool readCache)
+    : data_(std::move(data)), rootPath_(rootPath), files_(files),
+      cachePath_(cachePath), readCache_(readCache) {}
+
+void TrigramUpdateJob::run() {
+  bool changed = false;
+  if (readCache_ && !readCache()) {
+    changed = true; // Nothing usable on disk; the result is worth saving
+  }
+
+  // Files that left the workspace
+  QSet<QString> listed;
+  listed.reserve(files_.size());
+  for (const QString &path : files_) {
+    listed.insert(path);
+  }
+  {
+    QWriteLocker locker(&data_->lock);
+    for (auto it = data_->ids.begin(); it != data_->ids.end();) {
+      if (listed.contains(it.key())) {
+        ++it;
+        continue;
+      }
+      data_->docs[int(it.value())].state = TrigramDoc::Dead;
+      data_->unindexed.remove(it.key());
+      ++data_->deadDocs;
+      it = data_->ids.erase(it);
+      changed = true;
+    }
+  }
+
+  // Files that are new or changed since they were indexed. Edits do not
+  // touch directory mtimes, so until a file is checked in this pass its
+  // postings may be stale and queries search it regardless
+  {
+    QWriteLocker locker(&data_->lock);
+    data_->unverified = listed;
+  }
+  QStringList stale;
+  QStringList verified;
+  for (int i = 0; i < files_.size(); ++i) {
+    if (data_->cancelled) {
+      deleteLater();
+      return;
+    }
+    const QString &path = files_.at(i);
+    QFileInfo info(path);
+    qint64 modified = info.lastModified().toMSecsSinceEpoch();
+    bool current = false;
+    {
+      QReadLocker locker(&data_->lock);
+      auto it = data_->ids.constFind(path);
+      if (it != data_->ids.constEnd()) {
+        const TrigramDoc &doc = data_->docs.at(int(it.value()));
+        current = doc.modified == modified && doc.size == info.size();
+      }
+    }
+    if (current) {
+      verified.append(path);
+    } else {
+      stale.append(path);
+    }
+
+    // Stale files stay unverified until they are pending
+    if (verified.size() >= kVerifyBatch) {
+      QWriteLocker locker(&data_->lock);
+      for (const QString &done : verified) {
+        data_->unverified.remove(done);
+      }
+      verified.clear();
+    }
+  }
+  {
+    QWriteLocker locker(&data_->lock);
+    data_->pending.clear();
+    for (const QString &path : stale) {
+      data_->pending.insert(path);
+    }
+    data_->unverified.clear();
+    data_->listed = true;
+  }
+
+  if (!stale.isEmpty()) {
+    indexFiles(stale);
+    changed = true;
+  }
+  if (data_->cancelled) {
+    deleteLater();
+    return;
+  }
+
+  // A small delta is saved on its own; the mapped file is only rewritten
+  // once the delta or the dead documents have grown
+  bool merge = false;
+  bool hasBase = false;
+  {
+    QReadLocker locker(&data_->lock);
+    hasBase = data_->base != nullptr;
+    merge = (!hasBase && !data_->docs.isEmpty()) ||
+            data_->deltaIds > kMaxDeltaIds ||
+            (data_->deadDocs >= kMinDeadForCompaction &&
+             data_->deadDocs >= data_->docs.size() / 2);
+  }
+  if (merge) {
+    mergeBase();
+  } else if (changed && hasBase) {
+    writeDelta();
+  }
+
+  emit finished();
+  deleteLater();
+}
+
+void TrigramUpdateJob::indexFiles(const QStringList &files) {
+  std::atomic<int> next(0);
+  const int threads =
+      qBound(1, QThread::idealThreadCount(), qMax(1, files.size()));
+
+  runParallel(threads, [this, &files, &next](int) {
+    // One bit per possible trigram, to list each once per file
+    std::vector<quint64> seen(size_t(1) << 18, 0);
+    QVector<quint32> trigrams;
+
+    for (int index = next++; index < files.size() && !data_->cancelled;
+         index = next++) {
+      const QString &path = files.at(index);
+      QFile file(path);
+      QFileInfo info(path);
+
+      TrigramDoc doc;
+      doc.path = path;
+      doc.modified = info.lastModified().toMSecsSinceEpoch();
+      doc.size = info.size();
+      doc.state = TrigramDoc::Unindexed;
+      trigrams.clear();
+
+      if (file.open(QIODevice::ReadOnly) && doc.size <= kMaxIndexedBytes &&
+          !GzipDevice::isGzip(&file)) {
+        QByteArray buffer;
+        const char *data = nullptr;
+        if (doc.size > 0) {
+          data = reinterpret_cast<const char *>(file.map(0, doc.size));
+          if (!data) {
+            buffer = file.readAll();
+            data = buffer.constData();
+          }
+        }
+        const qint64 size = data ? doc.size : 0;
+
+        if (size > 0 &&
+            std::memchr(data, 0, size_t(qMin(size, kBinaryProbeBytes)))) {
+          doc.state = TrigramDoc::Binary;
+        } else {
+          doc.state = TrigramDoc::Indexed;
+          quint32 trigram = 0;
+          for (qint64 i = 0; i < size; ++i) {
+            trigram = ((trigram << 8) | uchar(foldAscii(data[i]))) & 0xFFFFFF;
+            if (i < 2) {
+              continue;
+            }
+            quint64 &word = seen[trigram >> 6];
+            quint64 bit = quint64(1) << (trigram & 63);
+            if (!(word & bit)) {
+              word |= bit;
+              trigrams.append(trigram);
+            }
+          }
+          for (quint32 t : trigrams) {
+            seen[t >> 6] = 0;
+          }
+        }
+      }
+
+      // Ids are handed out under the lock, so every list stays sorted
+      QWriteLocker locker(&data_->lock);
+      auto old = data_->ids.constFind(path);
+      if (old != data_->ids.constEnd()) {
+        data_->docs[int(old.value())].state = TrigramDoc::Dead;
+        ++data_->deadDocs;
+      }
+      quint32 id = quint32(data_->docs.size());
+      data_->docs.append(doc);
+      data_->ids.insert(path, id);
+      for (quint32 t : trigrams) {
+        data_->delta[t].append(id);
+      }
+      data_->deltaIds += trigrams.size();
+      if (doc.state == TrigramDoc::Unindexed) {
+        data_->unindexed.insert(path);
+      } else {
+        data_->unindexed.remove(path);
+      }
+      data_->pending.remove(path);
+    }
+  });
+}
+
+QString TrigramUpdateJob::deltaPath() const { return cachePath_ + ".delta"; }
+
+bool TrigramUpdateJob::mergeBase() {
+  QDir().mkpath(QFileInfo(cachePath_).absolutePath());
+  QSaveFile file(cachePath_);
+  if (!file.open(QIODevice::WriteOnly)) {
+    return false;
+  }
+  QDataStream out(&file);
+  out.setByteOrder(QDataStream::LittleEndian);
+  out << kCacheMagic << kCacheVersion;
+
+  // This job is the only writer, so the lists are read without the lock
+  // and queries go on meanwhile
+  const TrigramData &data = *data_;
+
+  // Live documents are renumbered in order, so lists stay ascending
+  QVector<qint64> renumbered(data.docs.size(), -1);
+  QVector<TrigramDoc> live;
+  for (int id = 0; id < data.docs.size(); ++id) {
+    if (data.docs.at(id).state != TrigramDoc::Dead) {
+      renumbered[id] = live.size();
+      live.append(data.docs.at(id));
+    }
+  }
+
+  QVector<quint32> deltaKeys;
+  deltaKeys.reserve(data.delta.size());
+  for (auto it = data.delta.cbegin(); it != data.delta.cend(); ++it) {
+    deltaKeys.append(it.key());
+  }
+  std::sort(deltaKeys.begin(), deltaKeys.end());
+
+  // Both trigram sequences are ascending; each list is written once with
+  // its mapped and delta parts joined
+  struct TableEntry {
+    quint32 trigram;
+    quint32 count;
+    quint64 offset;
+  };
+  QVector<TableEntry> table;
+  QVector<quint32> ids;
+  const quint32 kEnd = 0xFFFFFFFF; // Above every 24-bit trigram
+  quint32 nextBase = 0;
+  int nextDelta = 0;
+  while (nextBase < data.tableCount || nextDelta < deltaKeys.size()) {
+    if (data_->cancelled) {
+      return false;
+    }
+    quint32 baseKey =
+        nextBase < data.tableCount
+            ? qFromLittleEndian<quint32>(data.table +
+                                         qint64(nextBase) * kTableEntryBytes)
+            : kEnd;
+    quint32 deltaKey =
+        nextDelta < deltaKeys.size() ? deltaKeys.at(nextDelta) : kEnd;
+    quint32 trigram = qMin(baseKey, deltaKey);
+    if (baseKey == trigram) {
+      ++nextBase;
+    }
+    if (deltaKey == trigram) {
+      ++nextDelta;
+    }
+
+    PostingList list = postingList(data, trigram);
+    ids.clear();
+    for (int i = 0; i < list.size(); ++i) {
+      qint64 id = renumbered.at(int(list.at(i)));
+      if (id >= 0) {
+        ids.append(quint32(id));
+      }
+    }
+    if (ids.isEmpty()) {
+      continue;
+    }
+    table.append({trigram, quint32(ids.size()), quint64(file.pos())});
+    for (quint32 id : ids) {
+      out << id;
+    }
+  }
+
+  quint64 docsOffset = quint64(file.pos());
+  out << rootPath_ << live;
+  quint64 tableOffset = quint64(file.pos());
+  for (const TableEntry &entry : table) {
+    out << entry.trigram << entry.count << entry.offset;
+  }
+  quint64 generation = quint64(QDateTime::currentMSecsSinceEpoch());
+  if (generation <= data.generation) {
+    generation = data.generation + 1;
+  }
+  out << docsOffset << tableOffset << quint32(table.size())
+      << quint32(live.size()) << generation << kCacheMagic;
+  if (out.status() != QDataStream::Ok) {
+    return false;
+  }
+
+  // The old mapping goes before the file is replaced, which some
+  // platforms refuse while it is open
+  QWriteLocker locker(&data_->lock);
+  bool hadBase = data_->base != nullptr;
+  unmapBase(*data_);
+  if (!file.commit()) {
+    // Still the old file, or none and the whole index in the delta
+    if (hadBase && !mapBase(*data_, cachePath_, rootPath_, nullptr)) {
+      clearIndex(*data_);
+    }
+    return false;
+  }
+  if (!mapBase(*data_, cachePath_, rootPath_, nullptr)) {
+    clearIndex(*data_);
+    return false;
+  }
+
+  data_->docs = live;
+  data_->ids.clear();
+  for (int id = 0; id < live.size(); ++id) {
+    data_->ids.insert(live.at(id).path, quint32(id));
+  }
+  data_->delta.clear();
+  data_->deltaIds = 0;
+  data_->deadDocs = 0;
+  QFile::remove(deltaPath());
+  return true;
+}
+
+bool TrigramUpdateJob::readCache() {
+  QWriteLocker locker(&data_->lock);
+  QVector<TrigramDoc> docs;
+  if (!mapBase(*data_, cachePath_, rootPath_, &docs)) {
+    return false;
+  }
+
+  // Files indexed since the mapped file was written, if the delta was
+  // written against this very file
+  QHash<quint32, QVector<quint32>> delta;
+  QFile file(deltaPath());
+  if (file.open(QIODevice::ReadOnly)) {
+    QDataStream in(&file);
+    in.setByteOrder(QDataStream::LittleEndian);
+    quint32 magic = 0;
+    quint32 version = 0;
+    QString root;
+    quint64 generation = 0;
+    QVector<quint32> deadBase;
+    QVector<TrigramDoc> added;
+    in >> magic >> version;
+    if (magic == kCacheMagic && version == kCacheVersion) {
+      in >> root >> generation >> deadBase >> added >> delta;
+    }
+
+    bool valid = in.status() == QDataStream::Ok && root == rootPath_ &&
+                 generation == data_->generation;
+    const quint32 first = quint32(docs.size());
+    const quint32 end = first + quint32(added.size());
+    for (auto it = delta.cbegin(); valid && it != delta.cend(); ++it) {
+      for (quint32 id : it.value()) {
+        valid = valid && id >= first && id < end;
+      }
+    }
+    for (quint32 id : deadBase) {
+      valid = valid && id < first;
+    }
+    if (valid) {
+      for (quint32 id : deadBase) {
+        docs[int(id)].state = TrigramDoc::Dead;
+      }
+      docs += added;
+    } else {
+      delta.clear();
+    }
+  }
+
+  data_->docs = docs;
+  data_->delta = delta;
+  data_->deltaIds = 0;
+  for (auto it = delta.cbegin(); it != delta.cend(); ++it) {
+    data_->deltaIds += it.value().size();
+  }
+  data_->ids.clear();
+  data_->unindexed.clear();
+  data_->deadDocs = 0;
+  for (int id = 0; id < docs.size(); ++id) {
+    const TrigramDoc &doc = docs.at(id);
+    if (doc.state == TrigramDoc::Dead) {
+      ++data_->deadDocs;
+      continue;
+    }
+    data_->ids.insert(doc.path, quint32(id));
+    if (doc.state == TrigramDoc::Unindexed) {
+      data_->unindexed.insert(doc.path);
+    }
+  }
+  return true;
+}
+
+bool TrigramUpdateJob::writeDelta() {
+  QSaveFile file(deltaPath());
+  if (!file.open(QIODevice::WriteOnly)) {
+    return false;
+  }
+
+  // Mapped documents only ever die; later ones are written in full
+  QReadLocker locker(&data_->lock);
+  QVector<quint32> deadBase;
+  for (quint32 id = 0; id < data_->baseDocs; ++id) {
+    if (data_->docs.at(int(id)).state == TrigramDoc::Dead) {
+      deadBase.append(id);
+    }
+  }
+  QDataStream out(&file);
+  out.setByteOrder(QDataStream::LittleEndian);
+  out << kCacheMagic << kCacheVersion << rootPath_ << data_->generation
+      << deadBase << data_->docs.mid(int(data_->baseDocs)) << data_->delta;
+  return out.status() == QDataStream::Ok && file.commit();
+}
@@ -0,0 +1,338 @@
+#include "workspaceindex.h"
+#include "dircrawler.h"
+#include "fuzzymatcher.h"
+#include <QCoreApplication>
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDir>
+#include <QFileInfo>
+#include <QFileSystemWatcher>
+#include <QPointer>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <QThreadPool>
+#include <QTimer>
+
+namespace {
+
+// Directory events come in bursts (checkouts, builds)
+const int kRescanDelayMs = 200;
+
+// The cache is rewritten at most this often
+const int kSaveDelayMs = 2000;
+
+const quint32 kCacheMagic = 0x43594958; // "CYIX"
+// 2: every file not ignored by .gitignore/.ignore, at any depth
+const quint32 kCacheVersion = 2;
+
+QString childPath(const QString &relativeDir, const QString &name) {
+  return relativeDir.isEmpty() ? name : relativeDir + '/' + name;
+}
+
+} // namespace
+
+// Found by the QHash stream operators through argument-dependent lookup,
+// so these cannot live in the anonymous namespace
+static QDataStream &operator<<(QDataStream &out, const IndexedDir &dir) {
+  return out << dir.modified << dir.files << dir.subdirs;
+}
+
+static QDataStream &operator>>(QDataStream &in, IndexedDir &dir) {
+  return in >> dir.modified >> dir.files >> dir.subdirs;
+}
+
+// ==================== WorkspaceIndex ====================
+
+WorkspaceIndex *WorkspaceIndex::forRoot(const QString &rootPath) {
+  // One index per root for the whole application, so every window shares
+  // the same list and the same watches
+  static QHash<QString, QPointer<WorkspaceIndex>> indexes;
+
+  QString root = QDir(rootPath).absolutePath();
+  QPointer<WorkspaceIndex> &index = indexes[root];
+  if (!index) {
+    index = new WorkspaceIndex(root, QCoreApplication::instance());
+  }
+  return index;
+}
+
+WorkspaceIndex::WorkspaceIndex(const QString &rootPath, QObject *parent)
+    : QObject(parent), rootPath_(rootPath),
+      watcher_(new QFileSystemWatcher(this)), rescanTimer_(new QTimer(this)),
+      saveTimer_(new QTimer(this)), scanning_(false), ready_(false),
+      unsaved_(false), revision_(0), fileCount_(0), filesRevision_(0) {
+  qRegisterMetaType<WorkspaceScan>("WorkspaceScan");
+
+  rescanTimer_->setSingleShot(true);
+  rescanTimer_->setInterval(kRescanDelayMs);
+  connect(rescanTimer_, &QTimer::timeout, this, &WorkspaceIndex::rescanDirty);
+
+  saveTimer_->setSingleShot(true);
+  saveTimer_->setInterval(kSaveDelayMs);
+  connect(saveTimer_, &QTimer::timeout, this, &WorkspaceIndex::save);
+
+  connect(watcher_, &QFileSystemWatcher::directoryChanged, this,
+          &WorkspaceIndex::onDirectoryChanged);
+
+  // The cached index is reported first, then checked against the disk
+  startScan(QStringList(), false, true);
+}
+
+WorkspaceIndex::~WorkspaceIndex() {
+  if (unsaved_) {
+    WorkspaceScanJob::writeCache(cachePath(), rootPath_, dirs_);
+  }
+}
+
+QStringList WorkspaceIndex::files() const {
+  rebuildLists();
+  return files_;
+}
+
+QVector<FileKey> WorkspaceIndex::keys() const {
+  rebuildLists();
+  return keys_;
+}
+
+void WorkspaceIndex::rebuildLists() const {
+  if (filesRevision_ == revision_) {
+    return;
+  }
+  files_.clear();
+  files_.reserve(fileCount_);
+  keys_.clear();
+  keys_.reserve(fileCount_);
+
+  // Keys are lowered and masked here, once, rather than per keystroke
+  for (auto it = dirs_.cbegin(); it != dirs_.cend(); ++it) {
+    QString prefix = absolutePath(it.key()) + '/';
+    QByteArray relativePrefix =
+        it.key().isEmpty() ? QByteArray() : it.key().toUtf8() + '/';
+    for (const QString &name : it->files) {
+      files_.append(prefix + name);
+
+      FileKey key;
+      key.path = relativePrefix + name.toUtf8();
+      key.lower = FuzzyMatcher::toLowerAscii(key.path);
+      key.mask =
+          FuzzyMatcher::charMask(key.lower.constData(), key.lower.size());
+      key.nameOffset = relativePrefix.size();
+      keys_.append(key);
+    }
+  }
+  filesRevision_ = revision_;
+}
+
+void WorkspaceIndex::onDirectoryChanged(const QString &path) {
+  QString relative = QDir(rootPath_).relativeFilePath(path);
+  if (relative == ".") {
+    relative.clear();
+  }
+  dirty_.insert(relative);
+  rescanTimer_->start();
+}
+
+void WorkspaceIndex::rescanDirty() {
+  // One scan at a time; the rest waits for onScanned()
+  if (scanning_ || dirty_.isEmpty()) {
+    return;
+  }
+  QStringList dirs = dirty_.values();
+  dirty_.clear();
+  startScan(dirs, true, false);
+}
+
+void WorkspaceIndex::startScan(const QStringList &dirs, bool force,
+                               bool loadCache) {
+  QHash<QString, qint64> known;
+  for (auto it = dirs_.cbegin(); it != dirs_.cend(); ++it) {
+    known.insert(it.key(), it->modified);
+  }
+
+  scanning_ = true;
+  WorkspaceScanJob *job = new WorkspaceScanJob(
+      rootPath_, dirs, known, force, loadCache ? cachePath() : QString());
+  connect(job, &WorkspaceScanJob::finished, this, &WorkspaceIndex::onScanned,
+          Qt::QueuedConnection);
+  QThreadPool::globalInstance()->start(job);
+}
+
+void WorkspaceIndex::onScanned(const WorkspaceScan &scan, bool final) {
+  QStringList added;
+  QStringList dropped;
+
+  if (scan.replaceAll) {
+    dropped = watcher_->directories();
+    dirs_ = scan.listed;
+    for (auto it = dirs_.cbegin(); it != dirs_.cend(); ++it) {
+      added.append(absolutePath(it.key()));
+    }
+  } else {
+    for (const QString &dir : scan.removed) {
+      dropped.append(absolutePath(dir));
+      removeSubtree(dir);
+    }
+    for (auto it = scan.listed.cbegin(); it != scan.listed.cend(); ++it) {
+      // Subdirectories that disappeared take their whole subtree along
+      if (dirs_.contains(it.key())) {
+        for (const QString &name : dirs_[it.key()].subdirs) {
+          if (!it->subdirs.contains(name)) {
+            QString child = childPath(it.key(), name);
+            dropped.append(absolutePath(child));
+            removeSubtree(child);
+          }
+        }
+      } else {
+        added.append(absolutePath(it.key()));
+      }
+      dirs_.insert(it.key(), *it);
+    }
+  }
+
+  fileCount_ = 0;
+  for (const IndexedDir &dir : dirs_) {
+    fileCount_ += dir.files.size();
+  }
+
+  if (!dropped.isEmpty()) {
+    watcher_->removePaths(dropped);
+  }
+
+  if (final) {
+    scanning_ = false;
+    if (!ready_) {
+      // The cached list was reported without watches; watch everything
+      // that survived validation
+      ready_ = true;
+      added.clear();
+      for (auto it = dirs_.cbegin(); it != dirs_.cend(); ++it) {
+        added.append(absolutePath(it.key()));
+      }
+    }
+    if (!added.isEmpty()) {
+      watcher_->addPaths(added);
+    }
+    if (!scan.listed.isEmpty() || !scan.removed.isEmpty()) {
+      unsaved_ = true;
+      saveTimer_->start();
+    }
+    if (!dirty_.isEmpty()) {
+      rescanTimer_->start();
+    }
+  }
+
+  ++revision_;
+  emit updated();
+}
+
+void WorkspaceIndex::save() {
+  if (!unsaved_) {
+    return;
+  }
+  unsaved_ = false;
+
+  // The map is implicitly shared; the job writes a snapshot
+  QString path = cachePath();
+  QString root = rootPath_;
+  IndexedDirMap dirs = dirs_;
+  QThreadPool::globalInstance()->start([path, root, dirs]() {
+    WorkspaceScanJob::writeCache(path, root, dirs);
+  });
+}
+
+void WorkspaceIndex::removeSubtree(const QString &relativeDir) {
+  QString prefix = relativeDir + '/';
+  for (auto it = dirs_.begin(); it != dirs_.end();) {
+    if (it.key() == relativeDir ||
+        (!relativeDir.isEmpty() && it.key().startsWith(prefix))) {
+      it = dirs_.erase(it);
+    } else {
+      ++it;
+    }
+  }
+}
+
+QString WorkspaceIndex::absolutePath(const QString &relativeDir) const {
+  return relativeDir.isEmpty() ? rootPath_ : rootPath_ + '/' + relativeDir;
+}
+
+QString WorkspaceIndex::cachePath() const {
+  QByteArray key =
+      QCryptographicHash::hash(rootPath_.toUtf8(), QCryptographicHash::Sha1);
+  return QStandardPaths::writableLocation(QStandardPaths::CacheLocation) +
+         "/workspace-index/" + QString::fromLatin1(key.toHex()) + ".idx";
+}
+
+// ==================== WorkspaceScanJob ====================
+
+WorkspaceScanJob::WorkspaceScanJob(const QString &rootPath,
+                                   const QStringList &dirs,
+                                   const QHash<QString, qint64> &known,
+                                   bool force, const QString &cachePath)
+    : rootPath_(rootPath), dirs_(dirs), known_(known), force_(force),
+      cachePath_(cachePath) {}
+
+void WorkspaceScanJob::run() {
+  bool replaceAll = false;
+
+  if (!cachePath_.isEmpty()) {
+    IndexedDirMap cached;
+    if (readCache(cachePath_, rootPath_, cached)) {
+      WorkspaceScan loaded;
+      loaded.listed = cached;
+      loaded.replaceAll = true;
+      emit finished(loaded, false);
+
+      // Validate every cached directory against its mtime
+      known_.clear();
+      for (auto it = cached.cbegin(); it != cached.cend(); ++it) {
+        known_.insert(it.key(), it->modified);
+      }
+      dirs_ = cached.keys();
+    } else {
+      // No usable cache: walk the whole tree
+      replaceAll = true;
+      dirs_ = QStringList{QString()};
+    }
+  }
+
+  WorkspaceScan scan = DirCrawler(rootPath_).crawl(dirs_, known_, force_);
+  scan.replaceAll = replaceAll;
+
+  emit finished(scan, true);
+  deleteLater();
+}
+
+bool WorkspaceScanJob::readCache(const QString &cachePath,
+                                 const QString &rootPath,
+                                 IndexedDirMap &dirs) {
+  QFile file(cachePath);
+  if (!file.open(QIODevice::ReadOnly)) {
+    return false;
+  }
+
+  QDataStream in(&file);
+  quint32 magic = 0;
+  quint32 version = 0;
+  QString root;
+  in >> magic >> version;
+  if (magic != kCacheMagic || version != kCacheVersion) {
+    return false;
+  }
+  in >> root >> dirs;
+  return in.status() == QDataStream::Ok && root == rootPath;
+}
+
+bool WorkspaceScanJob::writeCache(const QString &cachePath,
+                                  const QString &rootPath,
+                                  const IndexedDirMap &dirs) {
+  QDir().mkpath(QFileInfo(cachePath).absolutePath());
+  QSaveFile file(cachePath);
+  if (!file.open(QIODevice::WriteOnly)) {
+    return false;
+  }
+
+  QDataStream out(&file);
+  out << kCacheMagic << kCacheVersion << rootPath << dirs;
+  return out.status() == QDataStream::Ok && file.commit();
+}